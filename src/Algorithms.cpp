@@ -21,16 +21,32 @@
 #include "Algorithms.h"
 #include "PhysicalConstants.h"
 
-Polynomial Algorithms::platoFromSG_20C20C(
-   Polynomial() << -616.868 << 1111.14 << -630.272 << 135.997
-);
-Polynomial Algorithms::waterDensityPoly_C(
-   Polynomial() << 0.9999776532 << 6.557692037e-5 << -1.007534371e-5
-      << 1.372076106e-7 << -1.414581892e-9 << 5.6890971e-12
-);
-Polynomial Algorithms::hydroCorrection15CPoly(
-   Polynomial() << -0.911045 << -16.2853e-3 << 5.84346e-3 << -15.3243e-6
-);
+namespace {
+   /*!
+    * \brief The \c x where \b poly is y0, y0 + yStep, ... for M values of y
+    *
+    * \b poly must only ever go up, and \b x0 be somewhere near the first one.
+    */
+   template<size_t N, size_t M>
+   constexpr std::array<double,M> inverseTable( FixedPolynomial<N> const& poly, double x0, double y0, double yStep )
+   {
+      std::array<double,M> ret{};
+      double x = x0;
+
+      for( size_t i = 0; i < M; ++i ) {
+         // Starting from the last entry, this is far more steps than it takes
+         for( int j = 0; j < 8; ++j )
+            x = poly.newtonStep(y0 + i * yStep, x);
+         ret[i] = x;
+      }
+
+      return ret;
+   }
+}
+
+// Worked out by the compiler, so there is nothing to do at startup.
+std::array<double,Algorithms::platoToSGTableSize> const Algorithms::platoToSGTable =
+   inverseTable<3,Algorithms::platoToSGTableSize>( platoFromSG_20C20C, 0.98, platoToSGTableMin, platoToSGTableStep );
 
 double Algorithms::round(double d)
 {
@@ -47,15 +63,65 @@ double Algorithms::SG_20C20C_toPlato( double sg )
    return platoFromSG_20C20C.eval(sg);
 }
 
-double Algorithms::PlatoToSG_20C20C( double plato )
+void Algorithms::SG_20C20C_toPlato( double const* sg, double* plato, size_t n )
+{
+   for( size_t i = 0; i < n; ++i )
+      plato[i] = platoFromSG_20C20C.eval(sg[i]);
+}
+
+double Algorithms::platoToSGGuess( double plato )
 {
-   // Copy the polynomial, cuz we need to alter it.
-   Polynomial poly(platoFromSG_20C20C);
+   double pos = (plato - platoToSGTableMin) / platoToSGTableStep;
+   // Bound it before the cast, or a silly plato overflows the int
+   int i = static_cast<int>( qBound(0.0, pos, platoToSGTableSize - 2.0) );
 
-   // After this, finding the root of the polynomial will be finding the SG.
-   poly[0] -= plato;
+   return platoToSGTable[i] + (pos - i) * (platoToSGTable[i+1] - platoToSGTable[i]);
+}
+
+double Algorithms::PlatoToSG_20C20C( double plato )
+{
+   double sg = platoToSGGuess(plato);
+   double last;
+   int i;
+
+   // Between two table entries the guess is already within about 1e-7, and
+   // each Newton step squares the error.
+   sg = platoFromSG_20C20C.newtonStep(plato, sg);
+   sg = platoFromSG_20C20C.newtonStep(plato, sg);
+
+   // Off the end of the table the guess may be some way out, so carry on
+   // until it settles.
+   if( plato < platoToSGTableMin || plato > platoToSGTableMin + (platoToSGTableSize - 1) * platoToSGTableStep ) {
+      for( i = 0; i < 50; ++i ) {
+         last = sg;
+         sg = platoFromSG_20C20C.newtonStep(plato, sg);
+         if( qAbs(sg - last) <= ROOT_PRECISION )
+            break;
+      }
+   }
+
+   return sg;
+}
 
-   return poly.rootFind( 1.000, 1.050 );
+void Algorithms::PlatoToSG_20C20C( double const* plato, double* sg, size_t n )
+{
+   double const tableMax = platoToSGTableMin + (platoToSGTableSize - 1) * platoToSGTableStep;
+   size_t i;
+   double x;
+
+   // Nothing but arithmetic and a table read in here, so the compiler is
+   // free to do several at once.
+   for( i = 0; i < n; ++i ) {
+      x = platoToSGGuess(plato[i]);
+      x = platoFromSG_20C20C.newtonStep(plato[i], x);
+      sg[i] = platoFromSG_20C20C.newtonStep(plato[i], x);
+   }
+
+   // The rare value off the end of the table needs more than two steps
+   for( i = 0; i < n; ++i ) {
+      if( plato[i] < platoToSGTableMin || plato[i] > tableMax )
+         sg[i] = PlatoToSG_20C20C(plato[i]);
+   }
 }
 
 double Algorithms::getPlato( double sugar_kg, double wort_l )
@@ -108,11 +174,10 @@ double Algorithms::ogFgToPlato( double og, double fg )
 {
    double sp = SG_20C20C_toPlato( og );
 
-   Polynomial poly(
-      Polynomial()
-         << 1.001843 - 0.002318474*sp - 0.000007775*sp*sp - 0.000000034*sp*sp*sp - fg
-         << 0.00574 << 0.00003344 << 0.000000086
-   );
+   FixedPolynomial<3> poly( {{
+      1.001843 - 0.002318474*sp - 0.000007775*sp*sp - 0.000000034*sp*sp*sp - fg,
+      0.00574, 0.00003344, 0.000000086
+   }} );
 
    return poly.rootFind(3, 5);
 }
@@ -26,6 +26,8 @@
 
 #include <QList>
 #include <QColor>
+#include <array>
+#include <cstddef>
 #include <limits> // For std::numeric_limits
 #include <vector>
 #include <cassert>
@@ -141,6 +143,93 @@ private:
    }
 };
 
+/*!
+ * \brief A real polynomial of fixed \c N order in a single variable
+ *
+ * Unlike Polynomial, the coefficients live in the object itself, so it can be
+ * built at compile time and copied without going near the heap.
+ */
+template<size_t N> class FixedPolynomial
+{
+public:
+   //! \brief Constructor from the coefficients of x^0 to x^N
+   constexpr FixedPolynomial( std::array<double,N+1> const& coeffs ) :
+      _coeffs(coeffs)
+   {
+   }
+
+   //! \brief Get the polynomial's order (highest exponent)
+   static constexpr size_t order() { return N; }
+
+   //! \brief Get coefficient of x^n where \c n <= \c order()
+   constexpr double operator[] (size_t n) const
+   {
+      return _coeffs[n];
+   }
+
+   //! \brief Evaluate the polynomial at point \c x
+   constexpr double eval(double x) const
+   {
+      double ret = _coeffs[N];
+      for( size_t i = N; i > 0; --i )
+         ret = ret * x + _coeffs[i-1];
+
+      return ret;
+   }
+
+   //! \brief Evaluate the first derivative at point \c x
+   constexpr double derivative(double x) const
+   {
+      double ret = 0.0;
+      for( size_t i = N; i > 0; --i )
+         ret = ret * x + i * _coeffs[i];
+
+      return ret;
+   }
+
+   /*!
+    * \brief One Newton step towards the \c x where the polynomial is \c y
+    *
+    * \param y - the value we want
+    * \param x - the current guess
+    * \returns a better guess
+    */
+   constexpr double newtonStep( double y, double x ) const
+   {
+      return x - (eval(x) - y) / derivative(x);
+   }
+
+   /*!
+    * \brief Root-finding by the secant method, just as Polynomial::rootFind().
+    *
+    * \param x0 - one of two initial \b distinct guesses at the root
+    * \param x1 - one of two initial \b distinct guesses at the root
+    * \returns \c HUGE_VAL on failure, otherwise a root of the polynomial
+    */
+   double rootFind( double x0, double x1 ) const
+   {
+      double guesses[] = { x0, x1 };
+      double newGuess = x0;
+      double maxAllowableSeparation = qAbs( x0 - x1 ) * 1e3;
+
+      while( qAbs( guesses[0] - guesses[1] ) > ROOT_PRECISION )
+      {
+         newGuess = guesses[1] - (guesses[1] - guesses[0]) * eval(guesses[1]) / ( eval(guesses[1]) - eval(guesses[0]) );
+
+         guesses[0] = guesses[1];
+         guesses[1] = newGuess;
+
+         if( qAbs( guesses[0] - guesses[1] ) > maxAllowableSeparation )
+            return HUGE_VAL;
+      }
+
+      return newGuess;
+   }
+
+private:
+   std::array<double,N+1> _coeffs;
+};
+
 /*!
  * \class Algorithms
  * \author Philip G. Lee
@@ -183,6 +272,15 @@ public:
    static double SG_20C20C_toPlato( double sg );
    //! \returns sg of \b plato
    static double PlatoToSG_20C20C( double plato );
+   //! \brief Converts the \b n values in \b sg to plato, into \b plato
+   static void SG_20C20C_toPlato( double const* sg, double* plato, size_t n );
+   /*!
+    * \brief Converts the \b n values in \b plato to sg, into \b sg
+    *
+    * Much cheaper per value than calling PlatoToSG_20C20C(double) in a loop
+    * when there are many to do.
+    */
+   static void PlatoToSG_20C20C( double const* plato, double* sg, size_t n );
    //! \returns water density in kg/L at temperature \b celsius
    static double getWaterDensity_kgL( double celsius );
    //! \returns additive correction to the 15C hydrometer reading if read at \b celsius
@@ -243,16 +341,31 @@ private:
    // This is the cubic fit to get Plato from specific gravity, measured at 20C
    // relative to density of water at 20C.
    // P = -616.868 + 1111.14(SG) - 630.272(SG)^2 + 135.997(SG)^3
-   static Polynomial platoFromSG_20C20C;
+   // Its derivative has no real roots, so it only ever goes up and there is
+   // exactly one SG for any Plato.
+   static constexpr FixedPolynomial<3> platoFromSG_20C20C{ {{ -616.868, 1111.14, -630.272, 135.997 }} };
    
    // Water density polynomial, given in kg/L as a function of degrees C.
    // 1.80544064e-8*x^3 - 6.268385468e-6*x^2 + 3.113930471e-5*x + 0.999924134
-   static Polynomial waterDensityPoly_C;
+   static constexpr FixedPolynomial<5> waterDensityPoly_C{ {{
+      0.9999776532, 6.557692037e-5, -1.007534371e-5,
+      1.372076106e-7, -1.414581892e-9, 5.6890971e-12
+   }} };
    
    // Polynomial in degrees Celsius that gives the additive hydrometer
    // correction for a 15C hydrometer when read at a temperature other
    // than 15C.
-   static Polynomial hydroCorrection15CPoly;
+   static constexpr FixedPolynomial<3> hydroCorrection15CPoly{ {{ -0.911045, -16.2853e-3, 5.84346e-3, -15.3243e-6 }} };
+
+   // SG at every half degree Plato from -5 to 50, for PlatoToSG_20C20C() to
+   // start from.
+   static constexpr double platoToSGTableMin = -5.0;
+   static constexpr double platoToSGTableStep = 0.5;
+   static constexpr size_t platoToSGTableSize = 111;
+   static std::array<double,platoToSGTableSize> const platoToSGTable;
+
+   //! \brief Interpolates \b plato in \c platoToSGTable, carrying on along the end segments past either end
+   static double platoToSGGuess( double plato );
 
    // Hide constructors and assignment op.
    Algorithms(){}
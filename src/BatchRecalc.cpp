@@ -0,0 +1,190 @@
+/*
+ * BatchRecalc.cpp is part of Brewtarget, and is Copyright the following
+ * authors 2024
+ *
+ * Brewtarget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brewtarget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "BatchRecalc.h"
+
+#include <QAtomicInt>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QRunnable>
+#include <QScopedPointer>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QTextStream>
+#include <QThread>
+#include <QThreadPool>
+#include <QVector>
+
+#include "database.h"
+#include "recipe.h"
+#include "RecipeSnapshot.h"
+#include "TableSchemaConst.h"
+#include "RecipeSchema.h"
+
+namespace {
+
+   //! What the recipe row held before we recalculated it
+   struct StoredValues {
+      bool found = false;
+      double og = 0.0;
+      double fg = 0.0;
+   };
+
+   //! Takes recipes off a shared counter until there are none left.
+   class Worker : public QRunnable
+   {
+   public:
+      Worker(QVector<RecipeSnapshot> const& inputs, QVector<RecipeCalcResult>& results,
+             QVector<StoredValues>& stored, QVector<qint64>& nsecs, QAtomicInt& next)
+         : m_inputs(inputs), m_results(results), m_stored(stored), m_nsecs(nsecs), m_next(next)
+      {
+      }
+
+      void run() override
+      {
+         QElapsedTimer timer;
+         int i;
+
+         // In WAL mode this thread gets a read-only connection of its own,
+         // which never holds up the database's own thread.
+         QSqlDatabase db;
+         try {
+            db = Database::readOnlyDatabase();
+         }
+         catch (QString e) {
+            qWarning() << Q_FUNC_INFO << e;
+         }
+
+         QScopedPointer<QSqlQuery> stored;
+         if ( db.isValid() ) {
+            stored.reset(new QSqlQuery(db));
+            stored->setForwardOnly(true);
+            if ( ! stored->prepare( QString("SELECT %1, %2 FROM %3 WHERE %4 = :id")
+                                       .arg(kcolRecipeOG).arg(kcolRecipeFG).arg(ktableRecipe).arg(kcolKey) ) ) {
+               qWarning() << Q_FUNC_INFO << "Could not read the stored values:" << stored->lastError().text();
+               stored.reset();
+            }
+         }
+
+         while ( (i = m_next.fetchAndAddRelaxed(1)) < m_inputs.size() ) {
+            timer.start();
+            // Every worker writes to different elements, so no lock needed
+            m_results[i] = RecipeCalc::calculate(m_inputs.at(i));
+            m_nsecs[i] = timer.nsecsElapsed();
+
+            if ( stored ) {
+               stored->bindValue(":id", m_inputs.at(i).key);
+               if ( stored->exec() && stored->next() ) {
+                  m_stored[i].found = true;
+                  m_stored[i].og = stored->value(0).toDouble();
+                  m_stored[i].fg = stored->value(1).toDouble();
+               }
+               stored->finish();
+            }
+         }
+      }
+
+   private:
+      QVector<RecipeSnapshot> const& m_inputs;
+      QVector<RecipeCalcResult>& m_results;
+      QVector<StoredValues>& m_stored;
+      QVector<qint64>& m_nsecs;
+      QAtomicInt& m_next;
+   };
+
+   QString storedField(StoredValues const& stored, double value)
+   {
+      return stored.found ? QString::number(value, 'f', 4) : QString();
+   }
+
+   QString csvField(QString const& text)
+   {
+      QString ret = text;
+      ret.replace("\"", "\"\"");
+      return QString("\"%1\"").arg(ret);
+   }
+}
+
+int BatchRecalc::run(QString const& reportFile, int jobs)
+{
+   QElapsedTimer wallClock;
+   wallClock.start();
+
+   if ( jobs <= 0 )
+      jobs = QThread::idealThreadCount();
+
+   QFile file(reportFile);
+   if ( ! file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text) ) {
+      qCritical() << Q_FUNC_INFO << "Could not open" << reportFile << "for writing:" << file.errorString();
+      return 1;
+   }
+
+   // Everything that reads a Recipe has to happen here, on the database's thread.
+   QVector<RecipeSnapshot> inputs;
+   foreach( Recipe* rec, Database::instance().recipes() ) {
+      if ( rec->deleted() )
+         continue;
+      inputs.append(RecipeSnapshot::fromRecipe(rec));
+   }
+   qint64 snapshotNsecs = wallClock.nsecsElapsed();
+
+   QVector<RecipeCalcResult> results(inputs.size());
+   QVector<StoredValues> stored(inputs.size());
+   QVector<qint64> nsecs(inputs.size());
+   QAtomicInt next(0);
+   QThreadPool pool;
+   pool.setMaxThreadCount(jobs);
+   for ( int i = 0; i < jobs; ++i ) {
+      pool.start(new Worker(inputs, results, stored, nsecs, next));
+   }
+   pool.waitForDone();
+   qint64 calcNsecs = wallClock.nsecsElapsed() - snapshotNsecs;
+
+   QTextStream out(&file);
+   out << "key,name,og,fg,abv_pct,ibu,color_srm,wort_from_mash_l,boil_volume_l,post_boil_volume_l,final_volume_l,"
+          "stored_og,stored_fg,calc_usecs\n";
+   for ( int i = 0; i < inputs.size(); ++i ) {
+      RecipeCalcResult const& r = results.at(i);
+      out << inputs.at(i).key << ","
+          << csvField(inputs.at(i).name) << ","
+          << QString::number(r.og, 'f', 4) << ","
+          << QString::number(r.fg, 'f', 4) << ","
+          << QString::number(r.ABV_pct, 'f', 2) << ","
+          << QString::number(r.IBU, 'f', 2) << ","
+          << QString::number(r.color_srm, 'f', 2) << ","
+          << QString::number(r.wortFromMash_l, 'f', 3) << ","
+          << QString::number(r.boilVolume_l, 'f', 3) << ","
+          << QString::number(r.postBoilVolume_l, 'f', 3) << ","
+          << QString::number(r.finalVolume_l, 'f', 3) << ","
+          << storedField(stored.at(i), stored.at(i).og) << ","
+          << storedField(stored.at(i), stored.at(i).fg) << ","
+          << QString::number(nsecs.at(i) / 1000.0, 'f', 1) << "\n";
+   }
+   out.flush();
+   file.close();
+
+   qInfo() << QString("Recalculated %1 recipes on %2 threads. Snapshot: %3 ms, calculation: %4 ms, total: %5 ms")
+              .arg(inputs.size())
+              .arg(jobs)
+              .arg(snapshotNsecs / 1e6, 0, 'f', 1)
+              .arg(calcNsecs / 1e6, 0, 'f', 1)
+              .arg(wallClock.nsecsElapsed() / 1e6, 0, 'f', 1);
+
+   return file.error() == QFileDevice::NoError ? 0 : 1;
+}
@@ -0,0 +1,50 @@
+/*
+ * BatchRecalc.h is part of Brewtarget, and is Copyright the following
+ * authors 2024
+ *
+ * Brewtarget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brewtarget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _BATCHRECALC_H
+#define _BATCHRECALC_H
+
+#include <QString>
+
+/*!
+ * \class BatchRecalc
+ *
+ * \brief Recalculates every recipe in the database without a GUI.
+ *
+ * Backs the --recalc-all command line option. The recipes are copied into
+ * plain structures on the calling thread, which has to be the one owning
+ * the database. The numbers are then worked out on a pool of threads that
+ * never touch the Recipe objects. Each of them also reads the OG and FG the
+ * recipe row holds, through Database::readOnlyDatabase(), so the report
+ * shows which stored values are out of date.
+ */
+class BatchRecalc
+{
+public:
+   /*!
+    * \brief Works out OG, FG, ABV, IBU, colour and volumes for every recipe
+    *        and writes them, with the stored OG and FG and how long each one
+    *        took, to \b reportFile as CSV.
+    *
+    * \param jobs how many threads to use. 0 or less means one per core.
+    * \returns 0 on success, or non-zero if the report could not be written.
+    */
+   static int run(QString const& reportFile, int jobs = 0);
+};
+
+#endif
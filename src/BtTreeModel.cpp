@@ -118,6 +118,7 @@ BtTreeModel::BtTreeModel(BtTreeView *parent, TypeMasks type)
       default:
          qWarning() << QString("Invalid treemask: %1").arg(type);
    }
+   connect( &(Database::instance()), &Database::elementsAdded, this, &BtTreeModel::elementsAdded );
 
    treeMask = type;
    parentTree = parent;
@@ -1343,6 +1344,73 @@ void BtTreeModel::elementAdded(Ingredient* victim)
    observeElement(victim);
 }
 
+bool BtTreeModel::handles(Ingredient* thing) const
+{
+   switch ( treeMask ) {
+      case RECIPEMASK:  return qobject_cast<Recipe*>(thing) != nullptr;
+      case EQUIPMASK:   return qobject_cast<Equipment*>(thing) != nullptr;
+      case FERMENTMASK: return qobject_cast<Fermentable*>(thing) != nullptr;
+      case HOPMASK:     return qobject_cast<Hop*>(thing) != nullptr;
+      case MISCMASK:    return qobject_cast<Misc*>(thing) != nullptr;
+      case STYLEMASK:   return qobject_cast<Style*>(thing) != nullptr;
+      case YEASTMASK:   return qobject_cast<Yeast*>(thing) != nullptr;
+      case WATERMASK:   return qobject_cast<Water*>(thing) != nullptr;
+      default:          return false;
+   }
+}
+
+// An import hands us everything at once, so add our share of it in one go
+// rather than a row at a time.
+void BtTreeModel::elementsAdded(QList<Ingredient*> const& added)
+{
+   QList<Ingredient*> things;
+   QList<BrewNote*> notes;
+
+   foreach( Ingredient* thing, added ) {
+      if ( ! thing->display() )
+         continue;
+
+      BrewNote* note = qobject_cast<BrewNote*>(thing);
+      if ( note ) {
+         if ( treeMask == RECIPEMASK )
+            notes.append(note);
+      }
+      else if ( handles(thing) )
+         things.append(thing);
+   }
+
+   if ( ! things.isEmpty() ) {
+      QModelIndex pIdx = createIndex(0,0,rootItem->child(0));
+      BtTreeItem* pItem = item(pIdx);
+      int first = pItem->childCount();
+
+      beginInsertRows(pIdx, first, first + things.size() - 1);
+      if ( pItem->insertChildren(first, things.size(), pItem->type()) ) {
+         for ( int i = 0; i < things.size(); ++i )
+            pItem->child(first + i)->setData(_type, things.at(i));
+      }
+      endInsertRows();
+
+      foreach( Ingredient* thing, things ) {
+         // New recipes bring their brewnotes with them
+         Recipe* rec = qobject_cast<Recipe*>(thing);
+         if ( rec ) {
+            QModelIndex rIdx = findElement(rec);
+            int row = 0;
+            foreach( BrewNote* note, rec->brewNotes() )
+               insertRow(row++, rIdx, note, BtTreeItem::BREWNOTE);
+         }
+         observeElement(thing);
+      }
+   }
+
+   // Which leaves brewnotes on recipes we already had
+   foreach( BrewNote* note, notes ) {
+      if ( ! things.contains(Database::instance().getParentRecipe(note)) )
+         elementAdded(note);
+   }
+}
+
 void BtTreeModel::elementRemoved(Recipe* victim)      { elementRemoved(qobject_cast<Ingredient*>(victim)); }
 void BtTreeModel::elementRemoved(Equipment* victim)   { elementRemoved(qobject_cast<Ingredient*>(victim)); }
 void BtTreeModel::elementRemoved(Fermentable* victim) { elementRemoved(qobject_cast<Ingredient*>(victim)); }
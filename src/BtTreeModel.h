@@ -209,6 +209,8 @@ private slots:
    void elementAdded(Yeast* victim);
    void elementAdded(BrewNote* victim);
    void elementAdded(Water* victim);
+   //! \brief Everything an import session created, in one go.
+   void elementsAdded(QList<Ingredient*> const& added);
 
    void elementChanged();
 
@@ -233,6 +235,8 @@ private:
    //slots actually call these two methods
    void elementAdded(Ingredient* victim);
    void elementRemoved(Ingredient* victim);
+   //! \brief True if \b thing belongs at the top level of this tree.
+   bool handles(Ingredient* thing) const;
 
    //! \brief connects the changedName() signal and changedFolder() signals to
    //! the proper methods for most things, and the same for changedBrewDate
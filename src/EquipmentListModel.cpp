@@ -28,6 +28,11 @@ EquipmentListModel::EquipmentListModel(QWidget* parent)
    : QAbstractListModel(parent), recipe(0)
 {
    connect( &(Database::instance()), &Database::newEquipmentSignal, this, &EquipmentListModel::addEquipment );
+   connect( &(Database::instance()), &Database::elementsAdded, this, [this](QList<Ingredient*> const& added) {
+      QList<Equipment*> equips = Database::elementsOfType<Equipment>(added);
+      if ( ! equips.isEmpty() )
+         addEquipments(equips);
+   });
    connect( &(Database::instance()), SIGNAL(deletedSignal(Equipment*)), this, SLOT(removeEquipment(Equipment*)) );
    repopulateList();
 }
@@ -97,6 +97,11 @@ void FermentableTableModel::observeDatabase(bool val)
 
       removeAll();
       connect( &(Database::instance()), &Database::newFermentableSignal, this, &FermentableTableModel::addFermentable );
+      connect( &(Database::instance()), &Database::elementsAdded, this, [this](QList<Ingredient*> const& added) {
+         QList<Fermentable*> ferms = Database::elementsOfType<Fermentable>(added);
+         if ( ! ferms.isEmpty() )
+            addFermentables(ferms);
+      });
       connect( &(Database::instance()), SIGNAL(deletedSignal(Fermentable*)), this, SLOT(removeFermentable(Fermentable*)) );
       addFermentables( Database::instance().fermentables() );
    }
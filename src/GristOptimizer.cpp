@@ -0,0 +1,385 @@
+/*
+ * GristOptimizer.cpp is part of Brewtarget, and is Copyright the following
+ * authors 2024
+ *
+ * Brewtarget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brewtarget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "GristOptimizer.h"
+
+#include "recipe.h"
+#include "matrix.h"
+#include "Algorithms.h"
+#include "ColorMethods.h"
+#include "PhysicalConstants.h"
+
+namespace {
+   //! Near enough to the targets
+   double const ogTolerance = 0.0001;
+   double const srmTolerance = 0.05;
+   //! Near enough to meeting a limit, in the scaled amounts solve() works in
+   double const constraintTolerance = 1e-6;
+
+   //! How much more hitting the targets matters than staying near the current amounts
+   double const targetWeight = 1e4;
+
+   //! g.x >= h, or g.x == h if \c equality
+   struct Constraint {
+      QVector<double> g;
+      double h;
+      bool equality;
+   };
+
+   /*!
+    * Solves \b a z = \b b by Gaussian elimination with scaled partial
+    * pivoting, leaving z in \b b. Each row is measured against its own
+    * largest element, so it does not matter that the rows for the targets
+    * are in much bigger numbers than the rows for the limits.
+    *
+    * \returns false if \b a is singular, or as near as makes no difference
+    */
+   bool solveLinear(QVector< QVector<double> >& a, QVector<double>& b)
+   {
+      int const n = b.size();
+      QVector<double> rowScale(n, 0.0);
+      int i, j, k;
+
+      for( i = 0; i < n; ++i ) {
+         for( j = 0; j < n; ++j )
+            rowScale[i] = qMax(rowScale[i], qAbs(a[i][j]));
+         if ( rowScale[i] <= 0.0 )
+            return false;
+      }
+
+      for( k = 0; k < n; ++k ) {
+         int pivot = k;
+         for( i = k + 1; i < n; ++i ) {
+            if ( qAbs(a[i][k]) / rowScale[i] > qAbs(a[pivot][k]) / rowScale[pivot] )
+               pivot = i;
+         }
+         if ( qAbs(a[pivot][k]) <= 1e-12 * rowScale[pivot] )
+            return false;
+         if ( pivot != k ) {
+            a[k].swap(a[pivot]);
+            qSwap(b[k], b[pivot]);
+            qSwap(rowScale[k], rowScale[pivot]);
+         }
+
+         for( i = k + 1; i < n; ++i ) {
+            double factor = a[i][k] / a[k][k];
+            if ( factor == 0.0 )
+               continue;
+            for( j = k; j < n; ++j )
+               a[i][j] -= factor * a[k][j];
+            b[i] -= factor * b[k];
+         }
+      }
+
+      for( i = n - 1; i >= 0; --i ) {
+         double sum = b[i];
+         for( j = i + 1; j < n; ++j )
+            sum -= a[i][j] * b[j];
+         b[i] = sum / a[i][i];
+      }
+      return true;
+   }
+
+   //! How far \b x is from meeting \b c, or 0 if it does
+   double violation(Constraint const& c, QVector<double> const& x)
+   {
+      double gx = 0.0;
+
+      for( int j = 0; j < x.size(); ++j )
+         gx += c.g[j] * x[j];
+      return c.equality ? qAbs(c.h - gx) : qMax(c.h - gx, 0.0);
+   }
+
+   /*!
+    * Minimises 1/2 x'Hx - q'x subject to \b constraints, by adding the most
+    * broken constraint and dropping any that pull the wrong way until
+    * neither happens. Each step solves the KKT system with solveLinear().
+    * \b H has to be positive definite.
+    *
+    * \returns false if the constraints we ended up with could not all hold
+    *          at once, or we ran out of steps before settling, leaving \b x
+    *          at the best we had
+    */
+   bool activeSetQp(Matrix const& H, QVector<double> const& q, QVector<Constraint> const& constraints,
+                    QVector<double>& x, int& iterations)
+   {
+      int const n = q.size();
+      QVector<int> active;
+      int i, j, k;
+
+      for( k = 0; k < constraints.size(); ++k ) {
+         if ( constraints[k].equality )
+            active.append(k);
+      }
+
+      for( int step = 0; step < 4 * (constraints.size() + 1); ++step ) {
+         int const m = active.size();
+         QVector< QVector<double> > kkt(n + m, QVector<double>(n + m, 0.0));
+         QVector<double> rhs(n + m, 0.0);
+
+         ++iterations;
+         //  [ H  -G'] [x]   [q]
+         //  [ G   0 ] [v] = [h]
+         for( i = 0; i < n; ++i ) {
+            for( j = 0; j < n; ++j )
+               kkt[i][j] = H.getVal(i, j);
+            rhs[i] = q[i];
+         }
+         for( k = 0; k < m; ++k ) {
+            Constraint const& c = constraints[active[k]];
+            for( j = 0; j < n; ++j ) {
+               kkt[n + k][j] = c.g[j];
+               kkt[j][n + k] = -c.g[j];
+            }
+            rhs[n + k] = c.h;
+         }
+
+         if ( ! solveLinear(kkt, rhs) )
+            return false;
+
+         for( i = 0; i < n; ++i )
+            x[i] = rhs[i];
+
+         // A multiplier below zero means the constraint is holding us back
+         // from a better place it would let us reach anyway
+         int worst = -1;
+         double worstMultiplier = -1e-9;
+         for( k = 0; k < m; ++k ) {
+            double multiplier = rhs[n + k];
+            if ( ! constraints[active[k]].equality && multiplier < worstMultiplier ) {
+               worst = k;
+               worstMultiplier = multiplier;
+            }
+         }
+         if ( worst >= 0 ) {
+            active.remove(worst);
+            continue;
+         }
+
+         int broken = -1;
+         double worstViolation = 1e-9;
+         for( k = 0; k < constraints.size(); ++k ) {
+            if ( active.contains(k) )
+               continue;
+            double v = violation(constraints[k], x);
+            if ( v > worstViolation ) {
+               broken = k;
+               worstViolation = v;
+            }
+         }
+         if ( broken < 0 )
+            return true;
+         active.append(broken);
+      }
+
+      return false;
+   }
+
+   //! The MCUs that make \b srm with the colour formula in the options
+   double srmToMcu(double srm)
+   {
+      double lo = 0.0;
+      double hi = 1.0;
+
+      while ( ColorMethods::mcuToSrm(hi) < srm && hi < 1e6 )
+         hi *= 2.0;
+      for( int i = 0; i < 60; ++i ) {
+         double mid = (lo + hi) / 2.0;
+         if ( ColorMethods::mcuToSrm(mid) < srm )
+            lo = mid;
+         else
+            hi = mid;
+      }
+
+      return (lo + hi) / 2.0;
+   }
+
+   //! The kg of sucrose in \b wort_l litres of wort at \b og. Undoes Algorithms::getPlato().
+   double ogToSugar_kg(double og, double wort_l)
+   {
+      double plato = Algorithms::SG_20C20C_toPlato(og) / 100.0;
+      return plato * wort_l / (1.0 - plato * (1.0 - 1.0/PhysicalConstants::sucroseDensity_kgL));
+   }
+}
+
+GristOptimizer::GristOptimizer(RecipeSnapshot const& snap)
+   : m_snap(snap),
+     m_limits(snap.fermentables.size())
+{
+}
+
+GristOptimizer GristOptimizer::fromRecipe(Recipe* rec, bool limitToInventory)
+{
+   GristOptimizer ret(RecipeSnapshot::fromRecipe(rec));
+
+   if ( limitToInventory ) {
+      QList<Fermentable*> ferms = rec->fermentables();
+      for( int i = 0; i < ferms.size() && i < ret.size(); ++i )
+         ret.m_limits[i].max_kg = ferms[i]->inventory();
+   }
+
+   return ret;
+}
+
+GristOptimizer::Result GristOptimizer::solve(double targetOg, double targetSrm) const
+{
+   int const n = size();
+   RecipeSnapshot snap = m_snap;
+   RecipeCalcResult calc = RecipeCalc::calculate(snap);
+   QVector<double> sugarPerKg(n);
+   QVector<double> mcuPerKg(n);
+   QVector<double> scale(n);
+   QVector<Constraint> constraints;
+   Result ret;
+   int i, j;
+
+   bool const wantOg = targetOg > 1.0;
+   bool const wantSrm = targetSrm > 0.0;
+   double const sugarWanted_kg = wantOg ? ogToSugar_kg(targetOg, calc.finalVolumeNoLosses_l) : 0.0;
+   double const mcuWanted = wantSrm ? srmToMcu(targetSrm) : 0.0;
+   double sugarTarget_kg = sugarWanted_kg;
+   double mcuTarget = mcuWanted;
+
+   // What a kg of each brings, as RecipeCalc::calcOgFg() and calcColor() have it
+   for( i = 0; i < n; ++i ) {
+      RecipeSnapshot::FermentableData f = snap.fermentables[i];
+      f.amount_kg = 1.0;
+      sugarPerKg[i] = RecipeCalc::equivSucrose_kg(f);
+      if ( f.type != Fermentable::Sugar && f.type != Fermentable::Extract && f.type != Fermentable::Dry_Extract )
+         sugarPerKg[i] *= snap.efficiency_pct / 100.0;
+      mcuPerKg[i] = f.color_srm * 8.34538 / calc.finalVolumeNoLosses_l;
+      // Solve for amounts relative to what is there now, which keeps the
+      // numbers Matrix sees within a few orders of magnitude of each other
+      scale[i] = qMax(m_snap.fermentables[i].amount_kg, 0.1);
+   }
+
+   for( i = 0; i < n; ++i ) {
+      Limits const& limit = m_limits[i];
+      double now = m_snap.fermentables[i].amount_kg / scale[i];
+      Constraint c;
+
+      c.g.fill(0.0, n);
+      c.equality = limit.fixed;
+      if ( limit.fixed ) {
+         c.g[i] = 1.0;
+         c.h = now;
+         constraints.append(c);
+         continue;
+      }
+
+      double max_kg = qMax(limit.max_kg, 0.0);
+      c.g[i] = 1.0;
+      c.h = qBound(0.0, limit.min_kg, max_kg) / scale[i];
+      constraints.append(c);
+      if ( max_kg < std::numeric_limits<double>::infinity() ) {
+         c.g[i] = -1.0;
+         c.h = -max_kg / scale[i];
+         constraints.append(c);
+      }
+
+      // amount_i >= min_pct/100 * sum(amounts), and likewise for max_pct
+      c.h = 0.0;
+      if ( limit.min_pct > 0.0 ) {
+         for( j = 0; j < n; ++j )
+            c.g[j] = (j == i ? 1.0 - limit.min_pct/100.0 : -limit.min_pct/100.0) * scale[j];
+         constraints.append(c);
+      }
+      if ( limit.max_pct < 100.0 ) {
+         for( j = 0; j < n; ++j )
+            c.g[j] = (j == i ? limit.max_pct/100.0 - 1.0 : limit.max_pct/100.0) * scale[j];
+         constraints.append(c);
+      }
+   }
+
+   QVector<double> x(n);
+   for( i = 0; i < n; ++i )
+      x[i] = m_snap.fermentables[i].amount_kg / scale[i];
+   for( int round = 0; round < 5; ++round ) {
+      Matrix H(n, n);
+      QVector<double> q(n);
+
+      // Staying where we are...
+      for( i = 0; i < n; ++i ) {
+         for( j = 0; j < n; ++j )
+            H.setVal(i, j, i == j ? 1.0 : 0.0);
+         q[i] = m_snap.fermentables[i].amount_kg / scale[i];
+      }
+      // ...matters much less than each target, as a fraction of itself
+      for( int t = 0; t < 2; ++t ) {
+         QVector<double> const& perKg = t == 0 ? sugarPerKg : mcuPerKg;
+         double target = t == 0 ? sugarTarget_kg : mcuTarget;
+
+         if ( ! (t == 0 ? wantOg : wantSrm) || target <= 0.0 )
+            continue;
+         for( i = 0; i < n; ++i ) {
+            double ri = perKg[i] * scale[i] / target;
+            for( j = 0; j < n; ++j )
+               H.setVal(i, j, H.getVal(i, j) + targetWeight * ri * perKg[j] * scale[j] / target);
+            q[i] += targetWeight * ri;
+         }
+      }
+
+      bool const solved = activeSetQp(H, q, constraints, x, ret.iterations);
+
+      QVector<double> amounts(n);
+      for( i = 0; i < n; ++i ) {
+         amounts[i] = qMax(x[i], 0.0);
+         snap.fermentables[i].amount_kg = amounts[i] * scale[i];
+      }
+      calc = RecipeCalc::calculate(snap);
+
+      // Another round would only fail the same way
+      if ( ! solved )
+         break;
+
+      ret.reached = (! wantOg || qAbs(calc.og - targetOg) <= ogTolerance) &&
+                    (! wantSrm || qAbs(calc.color_srm - targetSrm) <= srmTolerance);
+      // Near the targets is no use outside the limits
+      foreach( Constraint const& c, constraints ) {
+         if ( violation(c, amounts) > constraintTolerance )
+            ret.reached = false;
+      }
+      if ( ret.reached )
+         break;
+
+      // The linear model leaves out the sugar lost with the trub and the
+      // like, so aim off by however much the real sums missed by
+      if ( wantOg )
+         sugarTarget_kg += sugarWanted_kg - ogToSugar_kg(calc.og, calc.finalVolumeNoLosses_l);
+      if ( wantSrm )
+         mcuTarget += mcuWanted - srmToMcu(calc.color_srm);
+   }
+
+   ret.og = calc.og;
+   ret.color_srm = calc.color_srm;
+   ret.amounts_kg.resize(n);
+   for( i = 0; i < n; ++i )
+      ret.amounts_kg[i] = snap.fermentables[i].amount_kg;
+
+   return ret;
+}
+
+void GristOptimizer::apply(Recipe* rec, Result const& result)
+{
+   QList<Fermentable*> ferms = rec->fermentables();
+
+   for( int i = 0; i < ferms.size() && i < result.amounts_kg.size(); ++i ) {
+      if ( qAbs(ferms[i]->amount_kg() - result.amounts_kg[i]) > 1e-9 )
+         ferms[i]->setAmount_kg( result.amounts_kg[i] );
+   }
+}
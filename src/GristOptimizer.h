@@ -0,0 +1,103 @@
+/*
+ * GristOptimizer.h is part of Brewtarget, and is Copyright the following
+ * authors 2024
+ *
+ * Brewtarget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brewtarget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GRISTOPTIMIZER_H
+#define _GRISTOPTIMIZER_H
+
+#include <limits>
+#include <QVector>
+
+#include "RecipeSnapshot.h"
+
+class Recipe;
+
+/*!
+ * \class GristOptimizer
+ *
+ * \brief Works out fermentable amounts that give a recipe a target OG and colour.
+ *
+ * The sugar and the MCUs a recipe gets are both linear in the fermentable
+ * amounts, and a target OG or SRM can be turned back into a target sugar or
+ * MCU. So solve() is a small least squares problem: hit both targets,
+ * stay as close as possible to the amounts the recipe has now, and keep
+ * within each fermentable's limits. It is solved with an active set
+ * method, then checked against RecipeCalc and corrected for whatever the
+ * linear model missed, like the sugar lost with the trub. \c reached is
+ * only set if the amounts also keep to every limit.
+ */
+class GristOptimizer
+{
+public:
+   //! \brief What solve() may do with one fermentable
+   struct Limits {
+      double min_kg = 0.0;
+      //! Wins over min_kg if the two disagree
+      double max_kg = std::numeric_limits<double>::infinity();
+      //! Share of the grist by weight, from 0 to 100
+      double min_pct = 0.0;
+      double max_pct = 100.0;
+      //! Leave this fermentable's amount as it is
+      bool fixed = false;
+   };
+
+   struct Result {
+      //! False when the limits do not allow the targets, in which case \c amounts_kg gets as close as they do
+      bool reached = false;
+      //! What the recipe comes to with \c amounts_kg
+      double og = 1.0;
+      double color_srm = 0.0;
+      //! In the same order as the recipe's fermentables
+      QVector<double> amounts_kg;
+      int iterations = 0;
+   };
+
+   //! \brief Sets up for the fermentables in \b snap, with no limits beyond not going below zero.
+   explicit GristOptimizer(RecipeSnapshot const& snap);
+
+   /*!
+    * \brief Sets up for the fermentables in \b rec, with each one's maximum
+    *        set to what is in inventory if \b limitToInventory.
+    *
+    * Has to be called on the thread that owns the database.
+    */
+   static GristOptimizer fromRecipe(Recipe* rec, bool limitToInventory);
+
+   int size() const { return m_limits.size(); }
+   Limits& limits(int fermentable) { return m_limits[fermentable]; }
+   Limits const& limits(int fermentable) const { return m_limits[fermentable]; }
+
+   /*!
+    * \brief Fermentable amounts that bring the recipe to \b targetOg and
+    *        \b targetSrm, or as near as the limits allow.
+    *
+    * A target of 0 is left to fall where it may.
+    */
+   Result solve(double targetOg, double targetSrm) const;
+
+   /*!
+    * \brief Sets the amounts in \b result on \b rec's fermentables, which have
+    *        to be the ones this was set up from.
+    */
+   static void apply(Recipe* rec, Result const& result);
+
+private:
+   RecipeSnapshot m_snap;
+   QVector<Limits> m_limits;
+};
+
+#endif
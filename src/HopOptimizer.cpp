@@ -0,0 +1,197 @@
+/*
+ * HopOptimizer.cpp is part of Brewtarget, and is Copyright the following
+ * authors 2024
+ *
+ * Brewtarget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brewtarget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "HopOptimizer.h"
+
+#include <QVarLengthArray>
+
+#include "recipe.h"
+#include "IbuMethods.h"
+
+namespace {
+   //! Near enough to the target, in IBUs
+   double const ibuTolerance = 1e-4;
+
+   /*!
+    * The IBUs with every hop moved \b mu times its \b step, then pulled back
+    * inside its limits. Nothing but arithmetic, since solve() calls it for
+    * every guess.
+    */
+   double ibusAt(double mu, int n, double const* grams, double const* step,
+                 double const* lo, double const* hi, double const* ibusPerGram, double otherIbu)
+   {
+      double ret = otherIbu;
+
+      for( int i = 0; i < n; ++i )
+         ret += ibusPerGram[i] * qBound(lo[i], grams[i] + mu * step[i], hi[i]);
+
+      return ret;
+   }
+}
+
+HopOptimizer::HopOptimizer(RecipeSnapshot const& snap)
+   : m_otherIbu(0.0)
+{
+   RecipeCalcResult out = RecipeCalc::calculate(snap);
+   IbuMethods::HopBatch batch;
+   int i;
+
+   m_grams.reserve(snap.hops.size());
+   batch.reserve(snap.hops.size());
+   foreach( RecipeSnapshot::HopData const& h, snap.hops ) {
+      m_grams.append(h.amount_kg * 1000.0);
+      batch.append( h.alpha_pct/100.0, 1.0, h.time_min, h.use, h.form );
+   }
+   m_ibusPerGram.resize(batch.size());
+   IbuMethods::getIbus( batch, RecipeCalc::ibuWort(snap, out), m_ibusPerGram.data() );
+   m_limits.resize(batch.size());
+
+   m_otherIbu = out.IBU;
+   for( i = 0; i < out.ibus.size(); ++i )
+      m_otherIbu -= out.ibus[i];
+}
+
+HopOptimizer HopOptimizer::fromRecipe(Recipe* rec, bool limitToInventory)
+{
+   HopOptimizer ret(RecipeSnapshot::fromRecipe(rec));
+
+   if ( limitToInventory ) {
+      QList<Hop*> hops = rec->hops();
+      for( int i = 0; i < hops.size() && i < ret.size(); ++i )
+         ret.m_limits[i].max_g = hops[i]->inventory() * 1000.0;
+   }
+
+   return ret;
+}
+
+HopOptimizer::Result HopOptimizer::solve(double targetIbu) const
+{
+   int const n = size();
+   QVarLengthArray<double, 32> step(n);
+   QVarLengthArray<double, 32> lo(n);
+   QVarLengthArray<double, 32> hi(n);
+   double slope = 0.0;
+   Result ret;
+   int i;
+
+   // Moving every hop by mu times its step, the amounts closest to what we
+   // have now (weighted by 1/grams^2) that hit a given IBU are the ones for
+   // the right mu, pulled back inside the limits. The IBUs only ever go up
+   // with mu, so finding it is a search along one line.
+   for( i = 0; i < n; ++i ) {
+      Limits const& limit = m_limits[i];
+      double weight = qMax(m_grams[i], 1.0);
+
+      if ( limit.fixed || m_ibusPerGram[i] <= 0.0 ) {
+         step[i] = 0.0;
+         lo[i] = hi[i] = m_grams[i];
+         continue;
+      }
+
+      hi[i] = qMax(limit.max_g, 0.0);
+      lo[i] = qBound(0.0, limit.min_g, hi[i]);
+      step[i] = m_ibusPerGram[i] * weight * weight;
+      slope += m_ibusPerGram[i] * step[i];
+   }
+
+   auto ibus = [&](double mu) {
+      return ibusAt(mu, n, m_grams.constData(), step.constData(), lo.constData(), hi.constData(),
+                    m_ibusPerGram.constData(), m_otherIbu);
+   };
+   // True when going further than mu can't change anything, as every hop
+   // is already against the limit it is heading for
+   auto stuck = [&](double mu) {
+      for( int j = 0; j < n; ++j ) {
+         if ( step[j] > 0.0 && (mu > 0.0 ? m_grams[j] + mu * step[j] < hi[j] : m_grams[j] + mu * step[j] > lo[j]) )
+            return false;
+      }
+      return true;
+   };
+
+   double mu = 0.0;
+   double ibu = ibus(mu);
+
+   if ( qAbs(ibu - targetIbu) > ibuTolerance && slope > 0.0 ) {
+      // Where the line would get to the target if no limit got in the way.
+      // Limits can only slow it down, so keep going further until we are
+      // past the target, or no hop has anywhere left to go.
+      double muIn = 0.0;
+      double ibuIn = ibu;
+      double muOut = (targetIbu - ibu) / slope;
+      double ibuOut = ibus(muOut);
+      bool bracketed = true;
+
+      ++ret.iterations;
+      while ( (targetIbu - ibuOut) * (targetIbu - ibuIn) > 0.0 ) {
+         if ( stuck(muOut) || ret.iterations > 200 ) {
+            bracketed = false;
+            break;
+         }
+         muIn = muOut;
+         ibuIn = ibuOut;
+         muOut *= 2.0;
+         ibuOut = ibus(muOut);
+         ++ret.iterations;
+      }
+
+      if ( bracketed ) {
+         // Regula falsi, Illinois flavour. The IBUs are piecewise linear in
+         // mu, so this lands on the target in a handful of steps.
+         mu = muOut;
+         ibu = ibuOut;
+         while ( qAbs(ibu - targetIbu) > ibuTolerance && ret.iterations < 200 ) {
+            mu = muOut - (ibuOut - targetIbu) * (muOut - muIn) / (ibuOut - ibuIn);
+            ibu = ibus(mu);
+            ++ret.iterations;
+
+            if ( (ibu - targetIbu) * (ibuOut - targetIbu) > 0.0 ) {
+               // Same side again, so make the far end count for less
+               ibuIn = targetIbu + (ibuIn - targetIbu) / 2.0;
+            }
+            else {
+               muIn = muOut;
+               ibuIn = ibuOut;
+            }
+            muOut = mu;
+            ibuOut = ibu;
+         }
+      }
+      else {
+         mu = muOut;
+         ibu = ibuOut;
+      }
+   }
+
+   ret.grams.resize(n);
+   for( i = 0; i < n; ++i )
+      ret.grams[i] = qBound(lo[i], m_grams[i] + mu * step[i], hi[i]);
+   ret.ibu = ibu;
+   ret.reached = qAbs(ibu - targetIbu) <= ibuTolerance;
+
+   return ret;
+}
+
+void HopOptimizer::apply(Recipe* rec, Result const& result)
+{
+   QList<Hop*> hops = rec->hops();
+
+   for( int i = 0; i < hops.size() && i < result.grams.size(); ++i ) {
+      if ( qAbs(hops[i]->amount_kg() - result.grams[i] / 1000.0) > 1e-9 )
+         hops[i]->setAmount_kg( result.grams[i] / 1000.0 );
+   }
+}
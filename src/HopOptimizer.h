@@ -0,0 +1,102 @@
+/*
+ * HopOptimizer.h is part of Brewtarget, and is Copyright the following
+ * authors 2024
+ *
+ * Brewtarget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brewtarget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _HOPOPTIMIZER_H
+#define _HOPOPTIMIZER_H
+
+#include <limits>
+#include <QVector>
+
+#include "RecipeSnapshot.h"
+
+class Recipe;
+
+/*!
+ * \class HopOptimizer
+ *
+ * \brief Works out hop amounts that give a recipe a target IBU.
+ *
+ * With the wort and the hop times fixed, every IBU formula we have is
+ * linear in the grams of each hop. So the IBUs a gram of each hop brings are
+ * worked out once, up front, and solve() never needs to go back to the
+ * recipe or IbuMethods.
+ *
+ * Of all the amounts that hit the target within the limits, solve() picks
+ * the one closest to what the recipe has now, measured relative to how much
+ * of each hop there is. Doubling the bittering charge and leaving the
+ * aroma hops alone is preferred over zeroing the aroma hops, so the
+ * schedule keeps its shape.
+ */
+class HopOptimizer
+{
+public:
+   //! \brief What solve() may do with one hop
+   struct Limits {
+      double min_g = 0.0;
+      //! Wins over min_g if the two disagree
+      double max_g = std::numeric_limits<double>::infinity();
+      //! Leave this hop's amount as it is
+      bool fixed = false;
+   };
+
+   struct Result {
+      //! False when the limits do not allow the target, in which case \c grams gets as close as they do
+      bool reached = false;
+      //! What the recipe comes to with \c grams
+      double ibu = 0.0;
+      //! In the same order as the recipe's hops
+      QVector<double> grams;
+      int iterations = 0;
+   };
+
+   //! \brief Sets up for the hops in \b snap, with no limits beyond not going below zero.
+   explicit HopOptimizer(RecipeSnapshot const& snap);
+
+   /*!
+    * \brief Sets up for the hops in \b rec, with each one's maximum set to
+    *        what is in inventory if \b limitToInventory.
+    *
+    * Has to be called on the thread that owns the database.
+    */
+   static HopOptimizer fromRecipe(Recipe* rec, bool limitToInventory);
+
+   int size() const { return m_grams.size(); }
+   Limits& limits(int hop) { return m_limits[hop]; }
+   Limits const& limits(int hop) const { return m_limits[hop]; }
+   //! \brief IBUs from one gram of each hop
+   QVector<double> const& ibusPerGram() const { return m_ibusPerGram; }
+
+   //! \brief Hop amounts that bring the recipe to \b targetIbu, or as near as the limits allow.
+   Result solve(double targetIbu) const;
+
+   /*!
+    * \brief Sets the amounts in \b result on \b rec's hops, which have to be
+    *        the ones this was set up from.
+    */
+   static void apply(Recipe* rec, Result const& result);
+
+private:
+   //! What the recipe has now
+   QVector<double> m_grams;
+   QVector<double> m_ibusPerGram;
+   QVector<Limits> m_limits;
+   //! IBUs that don't come from hops, eg hopped extracts
+   double m_otherIbu;
+};
+
+#endif
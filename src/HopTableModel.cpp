@@ -104,6 +104,11 @@ void HopTableModel::observeDatabase(bool val)
       observeRecipe(nullptr);
       removeAll();
       connect( &(Database::instance()), &Database::newHopSignal, this, &HopTableModel::addHop );
+      connect( &(Database::instance()), &Database::elementsAdded, this, [this](QList<Ingredient*> const& added) {
+         QList<Hop*> hops = Database::elementsOfType<Hop>(added);
+         if ( ! hops.isEmpty() )
+            addHops(hops);
+      });
       connect( &(Database::instance()), SIGNAL(deletedSignal(Hop*)), this, SLOT(removeHop(Hop*)) );
       addHops( Database::instance().hops() );
    }
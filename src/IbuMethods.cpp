@@ -21,8 +21,121 @@
 #include <cmath>
 #include "Algorithms.h"
 #include "brewtarget.h"
+#include "hop.h"
 #include <QString>
 #include <QObject>
+#include <QVarLengthArray>
+
+namespace {
+   // Noonan's utilization against minutes in the boil
+   constexpr FixedPolynomial<7> noonanUtilization{ {{
+      0.7000029428, -0.08868853463, 0.02720809386, -0.002340415323,
+      0.00009925450081, -0.000002102006144, 0.00000002132644293, -0.00000000008229488217
+   }} };
+
+   //using 60 minutes as a general table
+   constexpr double noonanUtilizationFactorTable[4][2] =  {
+      {1.050, 1},
+      {1.065, 0.9286},
+      {1.085, 0.8571},
+      {1.100, 0.75}
+   };
+
+   /*!
+    * Each of these does the part of its formula that depends on the hop,
+    * having done the rest once in the constructor. Both are per-hop in the
+    * scalar versions.
+    */
+   struct TinsethKernel {
+      double scale;
+
+      TinsethKernel(IbuMethods::Wort const& wort) :
+         scale( 1000.0 / wort.finalVolume_l / 4.15 * 1.65 * pow(0.000125, (wort.gravity - 1)) )
+      {
+      }
+
+      double operator()(double AAgrams, double minutes) const
+      {
+         return scale * AAgrams * (1.0 - exp(-0.04 * minutes));
+      }
+   };
+
+   struct RagerKernel {
+      double scale;
+
+      RagerKernel(IbuMethods::Wort const& wort)
+      {
+         double gravityFactor = (wort.gravity > 1.050)? (wort.gravity - 1.050)/0.2 : 0.0;
+         scale = 1000.0 / (wort.finalVolume_l * (1 + gravityFactor)) / 100.0;
+      }
+
+      double operator()(double AAgrams, double minutes) const
+      {
+         return scale * AAgrams * (18.11 + 13.86*tanh((minutes-31.32)/18.17));
+      }
+   };
+
+   struct NoonanKernel {
+      double scale;
+
+      NoonanKernel(IbuMethods::Wort const& wort, double utilizationFactor)
+      {
+         double volumeFactor = (Units::us_gallons->toSI(5.0))/ wort.finalVolume_l;
+         scale = volumeFactor / (Units::ounces->toSI(1.0) * 1000.0) * 100 * utilizationFactor;
+      }
+
+      double operator()(double AAgrams, double minutes) const
+      {
+         return scale * AAgrams * noonanUtilization.eval(minutes);
+      }
+   };
+
+   /*!
+    * The loop behind IbuMethods::getIbus(HopBatch const&, ...). The use and
+    * form adjustments are selects rather than branches, and \b kernel
+    * inlines, so there is nothing stopping the compiler doing several hops
+    * at once.
+    */
+   template<class Kernel>
+   double batchIbus(Kernel const& kernel, IbuMethods::HopBatch const& hops, IbuMethods::Wort const& wort, double* ibus)
+   {
+      int const n = hops.size();
+      double const* AArating = hops.AArating.constData();
+      double const* grams = hops.grams.constData();
+      double const* minutes = hops.minutes.constData();
+      int const* use = hops.use.constData();
+      int const* form = hops.form.constData();
+      double const boilTime = wort.boilTime_min;
+      double const firstWort = wort.firstWortAdjustment;
+      double const mash = wort.mashHopAdjustment > 0.0 ? wort.mashHopAdjustment : 0.0;
+      double total = 0.0;
+      int i;
+
+      for( i = 0; i < n; ++i ) {
+         double useFactor = use[i] == Hop::Boil ? 1.0 :
+                            use[i] == Hop::First_Wort ? firstWort :
+                            use[i] == Hop::Mash ? mash : 0.0;
+         // Adjust for hop form. Tinseth's table was created from whole cone data,
+         // and it seems other formulae are optimized that way as well. So, the
+         // utilization is considered unadjusted for whole cones, and adjusted
+         // up for plugs and pellets.
+         //
+         // - http://www.realbeer.com/hops/FAQ.html
+         // - https://groups.google.com/forum/#!topic/brewtarget-help/mv2qvWBC4sU
+         double formFactor = form[i] == Hop::Pellet ? 1.10 :
+                             form[i] == Hop::Plug ? 1.02 : 1.0;
+         double ibu = kernel(AArating[i] * grams[i], use[i] == Hop::Boil ? minutes[i] : boilTime);
+
+         // Dry hops and the like get nothing, whatever the formula made of them
+         ibus[i] = useFactor == 0.0 ? 0.0 : useFactor * formFactor * wort.hopUtilization * ibu;
+      }
+
+      for( i = 0; i < n; ++i )
+         total += ibus[i];
+
+      return total;
+   }
+}
 
 IbuMethods::IbuMethods()
 {
@@ -72,34 +185,81 @@ double IbuMethods::noonan(double AArating, double hops_grams, double finalVolume
 {
     double volumeFactor = (Units::us_gallons->toSI(5.0))/ finalVolume_liters;
     double hopsFactor = hops_grams/ (Units::ounces->toSI(1.0) * 1000.0);
-    static Polynomial p(Polynomial() << 0.7000029428 << -0.08868853463 << 0.02720809386 << -0.002340415323 << 0.00009925450081 << -0.000002102006144 << 0.00000002132644293 << -0.00000000008229488217);
-
-    //using 60 minutes as a general table
-    double utilizationFactorTable[4][2] =  {
-                     {1.050, 1},
-                     {1.065, 0.9286},
-                     {1.085, 0.8571},
-                     {1.100, 0.75}
-                    };
 
-    double utilizationFactor;
+    return(volumeFactor * ( hopsFactor * (100 * AArating) * noonanUtilization.eval(minutes) ) * noonanUtilizationFactor(wort_grav));
+}
 
-    if(wort_grav <= utilizationFactorTable[0][0])
+double IbuMethods::noonanUtilizationFactor(double wort_grav)
+{
+    if(wort_grav <= noonanUtilizationFactorTable[0][0])
     {
-        utilizationFactor = utilizationFactorTable[0][1];
+        return noonanUtilizationFactorTable[0][1];
     }
-    else if(wort_grav <= utilizationFactorTable[1][0])
+    else if(wort_grav <= noonanUtilizationFactorTable[1][0])
     {
-        utilizationFactor = utilizationFactorTable[1][1];
+        return noonanUtilizationFactorTable[1][1];
     }
-    else if(wort_grav <= utilizationFactorTable[2][0])
+    else if(wort_grav <= noonanUtilizationFactorTable[2][0])
     {
-        utilizationFactor = utilizationFactorTable[2][1];
+        return noonanUtilizationFactorTable[2][1];
     }
     else
     {
-        utilizationFactor = utilizationFactorTable[3][1];
+        return noonanUtilizationFactorTable[3][1];
     }
+}
+
+void IbuMethods::HopBatch::reserve(int n)
+{
+   AArating.reserve(n);
+   grams.reserve(n);
+   minutes.reserve(n);
+   use.reserve(n);
+   form.reserve(n);
+}
+
+void IbuMethods::HopBatch::clear()
+{
+   AArating.clear();
+   grams.clear();
+   minutes.clear();
+   use.clear();
+   form.clear();
+}
+
+void IbuMethods::HopBatch::append(double AArating, double grams, double minutes, int use, int form)
+{
+   this->AArating.append(AArating);
+   this->grams.append(grams);
+   this->minutes.append(minutes);
+   this->use.append(use);
+   this->form.append(form);
+}
+
+double IbuMethods::getIbus(HopBatch const& hops, Wort const& wort, double* ibus)
+{
+   return getIbus(Brewtarget::ibuFormula, hops, wort, ibus);
+}
+
+double IbuMethods::getIbus(Brewtarget::IbuType formula, HopBatch const& hops, Wort const& wort, double* ibus)
+{
+   // Callers who only want the total still need somewhere to put the parts
+   QVarLengthArray<double, 64> scratch;
+   if ( ibus == nullptr ) {
+      scratch.resize(hops.size());
+      ibus = scratch.data();
+   }
 
-    return(volumeFactor * ( hopsFactor * (100 * AArating) * p.eval(minutes) ) * utilizationFactor);
+   switch( formula )
+   {
+      case Brewtarget::TINSETH:
+         return batchIbus(TinsethKernel(wort), hops, wort, ibus);
+      case Brewtarget::RAGER:
+         return batchIbus(RagerKernel(wort), hops, wort, ibus);
+      case Brewtarget::NOONAN:
+         return batchIbus(NoonanKernel(wort, noonanUtilizationFactor(wort.gravity)), hops, wort, ibus);
+      default:
+         qCritical() << QObject::tr("Unrecognized IBU formula type. %1").arg(formula);
+         return batchIbus(TinsethKernel(wort), hops, wort, ibus);
+   }
 }
@@ -20,6 +20,9 @@
 #ifndef _IBUMETHODS_H
 #define _IBUMETHODS_H
 
+#include <QVector>
+#include "brewtarget.h"
+
 /*!
  * \class IbuMethods
  * \author Philip G. Lee
@@ -41,6 +44,55 @@ public:
     * \param minutes - minutes that the hops are in the boil
     */
    static double getIbus(double AArating, double hops_grams, double finalVolume_liters, double wort_grav, double minutes);
+
+   /*!
+    * \brief Hops laid out one array per field, for getIbus(HopBatch const&, Wort const&, double*)
+    */
+   struct HopBatch {
+      //! In [0,1], as for getIbus()
+      QVector<double> AArating;
+      QVector<double> grams;
+      //! Only read for boil hops. First wort and mash hops get the whole boil.
+      QVector<double> minutes;
+      //! Hop::Use
+      QVector<int> use;
+      //! Hop::Form
+      QVector<int> form;
+
+      int size() const { return grams.size(); }
+      void reserve(int n);
+      void clear();
+      void append(double AArating, double grams, double minutes, int use, int form);
+   };
+
+   //! \brief What a HopBatch goes into. See Recipe::ibuFromHop().
+   struct Wort {
+      double finalVolume_l = 0.0;
+      double gravity = 1.0;
+      //! Whole minutes, which is what the first wort and mash hops get
+      int boilTime_min = 60;
+      //! In [0,1]
+      double hopUtilization = 1.0;
+      double firstWortAdjustment = 1.1;
+      double mashHopAdjustment = 0.0;
+   };
+
+   /*!
+    * \brief IBUs from every hop in \b hops, by \b formula
+    *
+    * Does what Recipe::ibuFromHop() does for each hop, including the
+    * adjustments for use and form, but works out everything that only
+    * depends on the wort once and runs the formula over all the hops in one
+    * loop.
+    *
+    * \param ibus - if not null, gets each hop's IBUs, so needs room for
+    *        \c hops.size() of them
+    * \returns the IBUs from all the hops
+    */
+   static double getIbus(Brewtarget::IbuType formula, HopBatch const& hops, Wort const& wort, double* ibus = nullptr);
+   //! \brief As above, by the formula in the options
+   static double getIbus(HopBatch const& hops, Wort const& wort, double* ibus = nullptr);
+
 private:
    static double tinseth(double AArating, double hops_grams, double finalVolume_liters, double wort_grav, double minutes);
    static double rager(double AArating, double hops_grams, double finalVolume_liters, double wort_grav, double minutes);
@@ -51,6 +103,8 @@ private:
     * \brief Calculates the IBU by Greg Noonans formula
     */
    static double noonan(double AARating, double hops_grams, double finalVolume_liters, double wort_grav, double minutes);
+   //! \brief The gravity part of noonan()
+   static double noonanUtilizationFactor(double wort_grav);
 };
 
 #endif
@@ -1011,6 +1011,7 @@ void MainWindow::setRecipe(Recipe* recipe)
    // causes this signal to be slotted, which then causes showChanges() to be
    // called.
    connect( recipeObs, SIGNAL(changed(QMetaProperty,QVariant)), this, SLOT(changed(QMetaProperty,QVariant)) );
+   connect( recipeObs, &Ingredient::changedProperties, this, &MainWindow::changedProperties );
    showChanges();
 }
 
@@ -1033,9 +1034,20 @@ void MainWindow::changed(QMetaProperty prop, QVariant value)
 
    }
 
+   // A recalculation reports all its changes at once through
+   // changedProperties(), so don't redraw for each of them here.
+   if( recipeObs && recipeObs->flushingChangeBatch() )
+      return;
+
    showChanges(&prop);
 }
 
+void MainWindow::changedProperties(QStringList propNames)
+{
+   Q_UNUSED(propNames);
+   showChanges();
+}
+
 void MainWindow::updateDensitySlider(QString attribute, RangedSlider* slider, double max)
 {
    Unit::unitDisplay dispUnit = static_cast<Unit::unitDisplay>(Brewtarget::option(attribute, Unit::noUnit, "tab_recipe", Brewtarget::UNIT).toInt());
@@ -2254,12 +2266,25 @@ void MainWindow::importFiles()
    if ( ! fileOpener->exec() )
       return;
 
+   // The import runs on this thread, so paint the status bar by hand
+   QMetaObject::Connection progress = connect( &Database::instance(), &Database::importProgress, this,
+      [this](qint64 bytesRead, qint64 bytesTotal) {
+         if ( ! statusBar() )
+            return;
+         statusBar()->showMessage(tr("Importing... %1%").arg(bytesTotal > 0 ? 100 * bytesRead / bytesTotal : 100));
+         statusBar()->repaint();
+      });
+
    foreach( QString filename, fileOpener->selectedFiles() )
    {
       if ( ! Database::instance().importFromXML(filename) )
          importMsg();
    }
 
+   disconnect(progress);
+   if ( statusBar() )
+      statusBar()->clearMessage();
+
    showChanges();
 }
 
@@ -2669,13 +2694,9 @@ void MainWindow::exportSelected()
 {
    BtTreeView* active = qobject_cast<BtTreeView*>(tabWidget_Trees->currentWidget()->focusWidget());
    QModelIndexList selected;
-   QList<QModelIndex>::const_iterator at,end;
-   QDomDocument doc;
+   QList<Ingredient*> things;
    QFile* outFile;
-   QDomElement root,dbase,recipe;
-   bool didRecipe = false;
-   BeerXML* bxml = Database::instance().getBeerXml();
-
+   QString fileName;
 
    if ( active == nullptr )
       return;
@@ -2688,64 +2709,52 @@ void MainWindow::exportSelected()
    if ( !outFile )
       return;
 
-   QTextStream out(outFile);
-
-   QString xmlHead = QString("version=\"1.0\" encoding=\"%1\"").arg(QTextCodec::codecForLocale()->name().data());
-
-   // Create the headers to make other BeerXML parsers happy
-   QDomProcessingInstruction inst = doc.createProcessingInstruction("xml", xmlHead);
-   QDomComment beerxml = doc.createComment("BeerXML generated by brewtarget");
-
-   doc.appendChild(inst);
-   doc.appendChild(beerxml);
-
-   // We need to handle the recipes separate from the normal database
-   // elements.  All recipes live under the RECIPES tag, whereas the
-   // equipment, hops, etc. go under DATABASE.
-   dbase = doc.createElement("DATABASE");
-   recipe = doc.createElement("RECIPES");
+   // The export opens it again on its own thread
+   fileName = outFile->fileName();
+   outFile->close();
+   delete outFile;
 
-   for(at = selected.begin(),end = selected.end(); at < end; ++at)
+   foreach( QModelIndex selection, selected )
    {
-      QModelIndex selection = *at;
-      int type = active->type(selection);
-
-      switch(type)
+      switch( active->type(selection) )
       {
          case BtTreeItem::RECIPE:
-            bxml->toXml( treeView_recipe->recipe(selection), doc, recipe);
-            didRecipe = true;
+            things.append( treeView_recipe->recipe(selection) );
             break;
          case BtTreeItem::EQUIPMENT:
-            bxml->toXml( treeView_equip->equipment(selection), doc, dbase);
+            things.append( treeView_equip->equipment(selection) );
             break;
          case BtTreeItem::FERMENTABLE:
-            bxml->toXml( treeView_ferm->fermentable(selection), doc, dbase);
+            things.append( treeView_ferm->fermentable(selection) );
             break;
          case BtTreeItem::HOP:
-            bxml->toXml( treeView_hops->hop(selection), doc, dbase);
+            things.append( treeView_hops->hop(selection) );
             break;
          case BtTreeItem::MISC:
-            bxml->toXml( treeView_misc->misc(selection), doc, dbase);
+            things.append( treeView_misc->misc(selection) );
             break;
          case BtTreeItem::STYLE:
-            bxml->toXml( treeView_style->style(selection), doc, dbase);
+            things.append( treeView_style->style(selection) );
             break;
          case BtTreeItem::YEAST:
-            bxml->toXml( treeView_yeast->yeast(selection), doc, dbase);
+            things.append( treeView_yeast->yeast(selection) );
             break;
       }
    }
 
-   if ( didRecipe )
-      doc.appendChild(recipe);
-   else
-      doc.appendChild(dbase);
+   BeerXmlExport* exporter = Database::instance().getBeerXml()->exporter(things, fileName);
 
-   out << doc.toString();
+   connect( exporter, &BeerXmlExport::progress, this, [this](int done, int total) {
+      statusBar()->showMessage(tr("Exporting... %1 of %2").arg(done).arg(total));
+   });
+   connect( exporter, &BeerXmlExport::finished, this, [this, fileName](bool ok) {
+      if ( ok )
+         statusBar()->showMessage(tr("Exported %1").arg(fileName), 3000);
+      else
+         QMessageBox::warning(this, tr("Export Failed"), tr("Could not write %1.").arg(fileName));
+   });
 
-   outFile->close();
-   delete outFile;
+   exporter->start();
 }
 
 void MainWindow::updateDatabase()
@@ -2771,8 +2780,13 @@ void MainWindow::updateDatabase()
                                            Brewtarget::getUserDataDir().canonicalPath(),
                                            tr("Brewtarget Database (*.sqlite)") );
 
+   if ( otherDb.isEmpty() )
+      return;
+
    // Merge.
-   Database::instance().updateDatabase( otherDb );
+   Database::MergeCounts counts = Database::instance().updateDatabase( otherDb );
+   statusBar()->showMessage( tr("Added %1, updated %2 and skipped %3 ingredients.")
+                                .arg(counts.merged).arg(counts.updated).arg(counts.skipped), 5000 );
 }
 
 void MainWindow::finishCheckingVersion()
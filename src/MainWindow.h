@@ -136,6 +136,8 @@ public slots:
 
    //! \brief Accepts Recipe changes, and takes appropriate action to show the changes.
    void changed(QMetaProperty,QVariant);
+   //! \brief Accepts a batch of Recipe changes, and shows them all in one go.
+   void changedProperties(QStringList propNames);
 
    void treeActivated(const QModelIndex &index);
    //! \brief View the given recipe.
@@ -29,6 +29,10 @@ MashComboBox::MashComboBox(QWidget* parent)
 {
    setCurrentIndex(-1);
    connect( &(Database::instance()), SIGNAL(newMashSignal(Mash*)), this, SLOT(addMash(Mash*)) );
+   connect( &(Database::instance()), &Database::elementsAdded, this, [this](QList<Ingredient*> const& added) {
+      foreach( Mash* mash, Database::elementsOfType<Mash>(added) )
+         addMash(mash);
+   });
    connect( &(Database::instance()), SIGNAL(deletedSignal(Mash*)), this, SLOT(removeMash(Mash*)) );
    repopulateList();
 }
@@ -29,6 +29,11 @@ MashListModel::MashListModel(QWidget* parent)
    : QAbstractListModel(parent), recipe(0)
 {
    connect( &(Database::instance()), &Database::newMashSignal, this, &MashListModel::addMash );
+   connect( &(Database::instance()), &Database::elementsAdded, this, [this](QList<Ingredient*> const& added) {
+      QList<Mash*> mashes = Database::elementsOfType<Mash>(added);
+      if ( ! mashes.isEmpty() )
+         addMashes(mashes);
+   });
    connect( &(Database::instance()), SIGNAL(deletedSignal(Mash*)), this, SLOT(removeMash(Mash*)) );
    repopulateList();
 }
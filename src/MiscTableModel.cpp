@@ -75,6 +75,11 @@ void MiscTableModel::observeDatabase(bool val)
       observeRecipe(nullptr);
       removeAll();
       connect( &(Database::instance()), &Database::newMiscSignal, this, &MiscTableModel::addMisc );
+      connect( &(Database::instance()), &Database::elementsAdded, this, [this](QList<Ingredient*> const& added) {
+         QList<Misc*> miscs = Database::elementsOfType<Misc>(added);
+         if ( ! miscs.isEmpty() )
+            addMiscs(miscs);
+      });
       connect( &(Database::instance()), SIGNAL(deletedSignal(Misc*)), this, SLOT(removeMisc(Misc*)) );
       addMiscs( Database::instance().miscs() );
    }
@@ -0,0 +1,226 @@
+/*
+ * OptionsCache.cpp is part of Brewtarget, and is Copyright the following
+ * authors 2024
+ *
+ * Brewtarget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brewtarget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "OptionsCache.h"
+
+#include <QAtomicPointer>
+#include <QCoreApplication>
+#include <QMutex>
+#include <QRunnable>
+#include <QSettings>
+#include <QStringList>
+#include <QThread>
+#include <QDebug>
+
+namespace {
+   QAtomicPointer<OptionsCache> s_instance;
+   QMutex s_createMutex;
+   QAtomicInt s_generation;
+
+   void writeSettings(QHash<QString,QVariant> const& set, QStringList const& removed)
+   {
+      QSettings settings;
+      foreach( QString const& name, removed ) {
+         settings.remove(name);
+      }
+      for( auto i = set.constBegin(); i != set.constEnd(); ++i ) {
+         settings.setValue(i.key(), i.value());
+      }
+
+      settings.sync();
+      if ( settings.status() != QSettings::NoError )
+         qWarning() << Q_FUNC_INFO << "Could not write the options:" << settings.status();
+   }
+
+   //! Writes one batch of changes off the GUI thread
+   class SettingsWriter : public QRunnable
+   {
+   public:
+      SettingsWriter(QHash<QString,QVariant> const& set, QStringList const& removed)
+         : m_set(set), m_removed(removed) {}
+
+      void run() override { writeSettings(m_set, m_removed); }
+
+   private:
+      QHash<QString,QVariant> m_set;
+      QStringList m_removed;
+   };
+}
+
+OptionsCache& OptionsCache::instance()
+{
+   OptionsCache* cache = s_instance.loadAcquire();
+   if ( ! cache ) {
+      create();
+      cache = s_instance.loadAcquire();
+   }
+   return *cache;
+}
+
+void OptionsCache::create()
+{
+   QMutexLocker locker(&s_createMutex);
+   if ( ! s_instance.loadAcquire() ) {
+      s_instance.storeRelease(new OptionsCache());
+      s_generation.ref();
+   }
+}
+
+void OptionsCache::destroy()
+{
+   QMutexLocker locker(&s_createMutex);
+   OptionsCache* cache = s_instance.fetchAndStoreOrdered(nullptr);
+   if ( ! cache )
+      return;
+
+   cache->sync();
+   delete cache;
+}
+
+int OptionsCache::generation()
+{
+   return s_generation.loadAcquire();
+}
+
+OptionsCache::OptionsCache()
+   : QObject(nullptr),
+     m_syncTimer(this)
+{
+   QSettings settings;
+   foreach( QString const& name, settings.allKeys() ) {
+      m_values.insert(name, settings.value(name));
+   }
+
+   // The timer has to live somewhere with an event loop
+   if ( QCoreApplication::instance() ) {
+      moveToThread(QCoreApplication::instance()->thread());
+      // Last chance to write anything out while the application is all there
+      connect( QCoreApplication::instance(), &QCoreApplication::aboutToQuit, this, &OptionsCache::sync );
+   }
+
+   m_syncTimer.setSingleShot(true);
+   m_syncTimer.setInterval(1000);
+   connect( &m_syncTimer, &QTimer::timeout, this, &OptionsCache::writeBehind );
+
+   m_writer.setMaxThreadCount(1);
+}
+
+OptionsCache::~OptionsCache()
+{
+   sync();
+}
+
+bool OptionsCache::contains(QString const& name) const
+{
+   QReadLocker locker(&m_lock);
+   return m_values.contains(name);
+}
+
+QVariant OptionsCache::value(QString const& name, QVariant const& defaultValue) const
+{
+   QReadLocker locker(&m_lock);
+   return m_values.value(name, defaultValue);
+}
+
+void OptionsCache::setValue(QString const& name, QVariant const& value)
+{
+   {
+      QWriteLocker locker(&m_lock);
+      m_values.insert(name, value);
+      m_dirty.insert(name);
+   }
+   scheduleSync();
+   emit optionChanged(name);
+}
+
+void OptionsCache::remove(QString const& name)
+{
+   {
+      QWriteLocker locker(&m_lock);
+      if ( m_values.remove(name) == 0 )
+         return;
+      m_dirty.insert(name);
+   }
+   scheduleSync();
+   emit optionChanged(name);
+}
+
+void OptionsCache::clear()
+{
+   QStringList names;
+   {
+      QWriteLocker locker(&m_lock);
+      // Nothing still on its way to QSettings may land after it is cleared
+      m_writer.waitForDone();
+      names = m_values.keys();
+      m_values.clear();
+      m_dirty.clear();
+      QSettings().clear();
+   }
+
+   foreach( QString const& name, names ) {
+      emit optionChanged(name);
+   }
+}
+
+void OptionsCache::sync()
+{
+   QHash<QString,QVariant> set;
+   QStringList removed;
+
+   // Holding the lock keeps writeBehind() from queuing anything newer than
+   // what we are about to write ourselves
+   QWriteLocker locker(&m_lock);
+   m_writer.waitForDone();
+   if ( m_dirty.isEmpty() )
+      return;
+
+   takeDirty(set, removed);
+   writeSettings(set, removed);
+}
+
+void OptionsCache::writeBehind()
+{
+   QWriteLocker locker(&m_lock);
+   if ( m_dirty.isEmpty() )
+      return;
+
+   QHash<QString,QVariant> set;
+   QStringList removed;
+   takeDirty(set, removed);
+   m_writer.start(new SettingsWriter(set, removed));
+}
+
+void OptionsCache::takeDirty(QHash<QString,QVariant>& set, QStringList& removed)
+{
+   foreach( QString const& name, m_dirty ) {
+      if ( m_values.contains(name) )
+         set.insert(name, m_values.value(name));
+      else
+         removed.append(name);
+   }
+   m_dirty.clear();
+}
+
+void OptionsCache::scheduleSync()
+{
+   if ( QThread::currentThread() == thread() )
+      m_syncTimer.start();
+   else
+      QMetaObject::invokeMethod(&m_syncTimer, "start", Qt::QueuedConnection);
+}
@@ -0,0 +1,102 @@
+/*
+ * OptionsCache.h is part of Brewtarget, and is Copyright the following
+ * authors 2024
+ *
+ * Brewtarget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brewtarget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _OPTIONSCACHE_H
+#define _OPTIONSCACHE_H
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QVariant>
+#include <QTimer>
+#include <QReadWriteLock>
+#include <QThreadPool>
+
+/*!
+ * \class OptionsCache
+ *
+ * \brief In-memory copy of the persistent options.
+ *
+ * Everything in QSettings is read once, when the cache is created. Reads
+ * after that never touch QSettings. Writes update the cache straight away
+ * and are written back to QSettings a little later on a thread of our own,
+ * or when sync() is called.
+ *
+ * main() calls create() once the application has its name, and
+ * Brewtarget::cleanup() calls destroy() while the QApplication is still
+ * there. Anything that asks for instance() before create() gets one made
+ * on the spot.
+ *
+ * Brewtarget::option() and friends go through here. Anything that wants to
+ * keep its own copy of something derived from an option should listen to
+ * optionChanged().
+ */
+class OptionsCache : public QObject
+{
+   Q_OBJECT
+
+public:
+   static OptionsCache& instance();
+   //! \brief Reads the options in. Wants the QCoreApplication and its names set up first.
+   static void create();
+   //! \brief Writes out anything still waiting and gets rid of the cache.
+   static void destroy();
+   /*!
+    * \brief Goes up each time create() makes a new cache, so that anything
+    *        connected to optionChanged() can tell it needs to connect again.
+    */
+   static int generation();
+
+   bool contains(QString const& name) const;
+   QVariant value(QString const& name, QVariant const& defaultValue = QVariant()) const;
+   void setValue(QString const& name, QVariant const& value);
+   void remove(QString const& name);
+   //! \brief Forgets every option, here and in QSettings.
+   void clear();
+
+   //! \brief Writes any changes still waiting to QSettings, and waits until they are written.
+   void sync();
+
+signals:
+   //! \brief Emitted after \b name is set or removed.
+   void optionChanged(QString const& name);
+
+private:
+   OptionsCache();
+   ~OptionsCache();
+   OptionsCache(OptionsCache const&) = delete;
+   OptionsCache& operator=(OptionsCache const&) = delete;
+
+   //! \brief Makes sure a write is coming, from whatever thread we are on.
+   void scheduleSync();
+   //! \brief Hands whatever has changed to m_writer, and does not wait for it.
+   void writeBehind();
+   //! \brief What has been set and removed since last time. Clears m_dirty, so wants m_lock held for writing.
+   void takeDirty(QHash<QString,QVariant>& set, QStringList& removed);
+
+   mutable QReadWriteLock m_lock;
+   QHash<QString,QVariant> m_values;
+   //! Names set or removed since the last write
+   QSet<QString> m_dirty;
+   QTimer m_syncTimer;
+   //! One thread, so the writes land in the order they were made
+   QThreadPool m_writer;
+};
+
+#endif
@@ -0,0 +1,323 @@
+/*
+ * RecipeSnapshot.cpp is part of Brewtarget, and is Copyright the following
+ * authors 2024
+ *
+ * Brewtarget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brewtarget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "RecipeSnapshot.h"
+
+#include "brewtarget.h"
+#include "recipe.h"
+#include "equipment.h"
+#include "mash.h"
+#include "yeast.h"
+#include "Algorithms.h"
+#include "ColorMethods.h"
+#include "IbuMethods.h"
+#include "PhysicalConstants.h"
+
+RecipeSnapshot RecipeSnapshot::fromRecipe(Recipe* rec)
+{
+   RecipeSnapshot snap;
+
+   snap.key = rec->key();
+   snap.name = rec->name();
+   snap.batchSize_l = rec->batchSize_l();
+   snap.boilSize_l = rec->boilSize_l();
+   snap.efficiency_pct = rec->efficiency_pct();
+
+   snap.grainAbsorption_LKg = PhysicalConstants::grainAbsorption_Lkg;
+   Equipment* equip = rec->equipment();
+   if ( equip ) {
+      snap.hasEquipment = true;
+      snap.boilTime_min = equip->boilTime_min();
+      snap.evapRate_lHr = equip->evapRate_lHr();
+      snap.lauterDeadspace_l = equip->lauterDeadspace_l();
+      snap.topUpKettle_l = equip->topUpKettle_l();
+      snap.topUpWater_l = equip->topUpWater_l();
+      snap.trubChillerLoss_l = equip->trubChillerLoss_l();
+      snap.grainAbsorption_LKg = equip->grainAbsorption_LKg();
+      snap.hopUtilization_pct = equip->hopUtilization_pct();
+   }
+
+   Mash* mash = rec->mash();
+   if ( mash ) {
+      snap.hasMash = true;
+      snap.totalMashWater_l = mash->totalMashWater_l();
+   }
+
+   snap.firstWortHopAdjustment = Brewtarget::toDouble(Brewtarget::option("firstWortHopAdjustment", 1.1).toString(), "RecipeSnapshot::fromRecipe()");
+   snap.mashHopAdjustment = Brewtarget::toDouble(Brewtarget::option("mashHopAdjustment", 0).toString(), "RecipeSnapshot::fromRecipe()");
+
+   QList<Fermentable*> ferms = rec->fermentables();
+   snap.fermentables.reserve(ferms.size());
+   foreach( Fermentable* f, ferms ) {
+      FermentableData data;
+      data.type = f->type();
+      data.amount_kg = f->amount_kg();
+      data.yield_pct = f->yield_pct();
+      data.moisture_pct = f->moisture_pct();
+      data.color_srm = f->color_srm();
+      data.ibuGalPerLb = f->ibuGalPerLb();
+      data.isMashed = f->isMashed();
+      data.addAfterBoil = f->addAfterBoil();
+      data.fermentable = Recipe::isFermentableSugar(f);
+      snap.fermentables.append(data);
+   }
+
+   QList<Hop*> hops = rec->hops();
+   snap.hops.reserve(hops.size());
+   foreach( Hop* h, hops ) {
+      HopData data;
+      data.use = h->use();
+      data.form = h->form();
+      data.alpha_pct = h->alpha_pct();
+      data.amount_kg = h->amount_kg();
+      data.time_min = h->time_min();
+      snap.hops.append(data);
+   }
+
+   QList<Yeast*> yeasts = rec->yeasts();
+   snap.yeastAttenuations_pct.reserve(yeasts.size());
+   foreach( Yeast* y, yeasts ) {
+      snap.yeastAttenuations_pct.append(y->attenuation_pct());
+   }
+
+   return snap;
+}
+
+double RecipeCalc::equivSucrose_kg(RecipeSnapshot::FermentableData const& ferm)
+{
+   double ret = ferm.amount_kg * ferm.yield_pct * (1.0-ferm.moisture_pct/100.0) / 100.0;
+
+   // If this is a steeped grain...
+   if( ferm.type == Fermentable::Grain && !ferm.isMashed )
+      return 0.60 * ret; // Reduce the yield by 60%.
+   else
+      return ret;
+}
+
+RecipeCalcResult RecipeCalc::calculate(RecipeSnapshot const& snap)
+{
+   RecipeCalcResult out;
+
+   foreach( RecipeSnapshot::FermentableData const& f, snap.fermentables ) {
+      out.grains_kg += f.amount_kg;
+      if ( f.type == Fermentable::Grain && f.isMashed )
+         out.grainsInMash_kg += f.amount_kg;
+   }
+
+   // Same order as Recipe::calcGraph
+   calcVolumes(snap, out);
+   calcColor(snap, out);
+   calcOgFg(snap, out);
+   calcBoilGrav(snap, out);
+   calcIBU(snap, out);
+   calcCalories(out);
+
+   return out;
+}
+
+void RecipeCalc::calcVolumes(RecipeSnapshot const& snap, RecipeCalcResult& out)
+{
+   double boil_l;
+
+   out.wortFromMash_l = 0.0;
+   if ( snap.hasMash )
+      out.wortFromMash_l = snap.totalMashWater_l - snap.grainAbsorption_LKg * out.grainsInMash_kg;
+
+   boil_l = out.wortFromMash_l;
+   if ( snap.hasEquipment )
+      boil_l += snap.topUpKettle_l - snap.lauterDeadspace_l;
+
+   // Need to account for extract/sugar volume also.
+   foreach( RecipeSnapshot::FermentableData const& f, snap.fermentables ) {
+      if ( f.type == Fermentable::Extract )
+         boil_l += f.amount_kg / PhysicalConstants::liquidExtractDensity_kgL;
+      else if ( f.type == Fermentable::Sugar )
+         boil_l += f.amount_kg / PhysicalConstants::sucroseDensity_kgL;
+      else if ( f.type == Fermentable::Dry_Extract )
+         boil_l += f.amount_kg / PhysicalConstants::dryExtractDensity_kgL;
+   }
+
+   if ( boil_l <= 0.0 )
+      boil_l = snap.boilSize_l; // Give up.
+   out.boilVolume_l = boil_l;
+
+   out.finalVolumeNoLosses_l = snap.batchSize_l + snap.trubChillerLoss_l;
+
+   if ( snap.hasEquipment ) {
+      out.postBoilVolume_l = boil_l - (snap.boilTime_min/60.0) * snap.evapRate_lHr;
+      out.finalVolume_l = out.postBoilVolume_l + snap.topUpWater_l - snap.trubChillerLoss_l;
+   }
+   else {
+      out.postBoilVolume_l = snap.batchSize_l; // Give up.
+      // Recipe ends up with 0 here when there is no equipment
+      out.finalVolume_l = 0.0;
+   }
+}
+
+void RecipeCalc::calcColor(RecipeSnapshot const& snap, RecipeCalcResult& out)
+{
+   double mcu = 0.0;
+
+   foreach( RecipeSnapshot::FermentableData const& f, snap.fermentables ) {
+      // Conversion factor for lb/gal to kg/l = 8.34538.
+      mcu += f.color_srm * 8.34538 * f.amount_kg / out.finalVolumeNoLosses_l;
+   }
+
+   out.color_srm = ColorMethods::mcuToSrm(mcu);
+}
+
+void RecipeCalc::calcOgFg(RecipeSnapshot const& snap, RecipeCalcResult& out)
+{
+   double sugar_kg = 0.0;
+   double sugar_kg_ignoreEfficiency = 0.0;
+   double nonFermentableSugars_kg = 0.0;
+   double attenuation_pct = 0.0;
+   double pnts, nonferm_pnts, ferm_pnts;
+
+   foreach( RecipeSnapshot::FermentableData const& f, snap.fermentables ) {
+      double sucrose_kg = equivSucrose_kg(f);
+
+      // If we have some sort of non-grain, we have to ignore efficiency.
+      if ( f.type == Fermentable::Sugar || f.type == Fermentable::Extract || f.type == Fermentable::Dry_Extract ) {
+         sugar_kg_ignoreEfficiency += sucrose_kg;
+         if ( ! f.fermentable )
+            nonFermentableSugars_kg += sucrose_kg;
+      }
+      else {
+         sugar_kg += sucrose_kg;
+      }
+   }
+
+   // We might lose some sugar in the form of Trub/Chiller loss and lauter deadspace.
+   if ( snap.hasEquipment ) {
+      double kettleWort_l = (out.wortFromMash_l - snap.lauterDeadspace_l) + snap.topUpKettle_l;
+      double postBoilWort_l = kettleWort_l - (snap.boilTime_min/60.0) * snap.evapRate_lHr;
+      double ratio = (postBoilWort_l - snap.trubChillerLoss_l) / postBoilWort_l;
+
+      if ( ratio > 1.0 ) // Usually happens when we don't have a mash yet.
+         ratio = 1.0;
+      else if ( ratio < 0.0 )
+         ratio = 0.0;
+      else if ( Algorithms::isNan(ratio) )
+         ratio = 1.0;
+
+      sugar_kg_ignoreEfficiency *= ratio;
+      nonFermentableSugars_kg *= ratio;
+   }
+
+   sugar_kg = sugar_kg * snap.efficiency_pct/100.0 + sugar_kg_ignoreEfficiency;
+   out.og = Algorithms::PlatoToSG_20C20C( Algorithms::getPlato(sugar_kg, out.finalVolumeNoLosses_l) );
+   pnts = (out.og - 1) * 1000.0;
+
+   if ( nonFermentableSugars_kg != 0.0 ) {
+      out.og_fermentable = Algorithms::PlatoToSG_20C20C( Algorithms::getPlato(sugar_kg - nonFermentableSugars_kg, out.finalVolumeNoLosses_l) );
+      nonferm_pnts = (Algorithms::PlatoToSG_20C20C( Algorithms::getPlato(nonFermentableSugars_kg, out.finalVolumeNoLosses_l) ) - 1) * 1000.0;
+   }
+   else {
+      out.og_fermentable = out.og;
+      nonferm_pnts = 0.0;
+   }
+
+   // Use the yeast with the greatest attenuation.
+   foreach( double a, snap.yeastAttenuations_pct ) {
+      if ( a > attenuation_pct )
+         attenuation_pct = a;
+   }
+   // This means we have yeast, but they neglected to provide attenuation percentages.
+   if ( ! snap.yeastAttenuations_pct.isEmpty() && attenuation_pct <= 0.0 )
+      attenuation_pct = 75.0;
+
+   ferm_pnts = (pnts - nonferm_pnts) * (1.0 - attenuation_pct/100.0);
+   out.fg = 1 + (ferm_pnts + nonferm_pnts)/1000.0;
+   out.fg_fermentable = 1 + ferm_pnts/1000.0;
+
+   // See Recipe::recalcABV_pct()
+   out.ABV_pct = (76.08 * (out.og_fermentable - out.fg_fermentable) / (1.775 - out.og_fermentable)) * (out.fg_fermentable / 0.794);
+}
+
+void RecipeCalc::calcBoilGrav(RecipeSnapshot const& snap, RecipeCalcResult& out)
+{
+   double sugar_kg = 0.0;
+   double sugar_kg_ignoreEfficiency = 0.0;
+   double lateAddition_kg = 0.0;
+   double lateAddition_kg_ignoreEff = 0.0;
+
+   foreach( RecipeSnapshot::FermentableData const& f, snap.fermentables ) {
+      double sucrose_kg = equivSucrose_kg(f);
+
+      if ( f.type == Fermentable::Sugar || f.type == Fermentable::Extract || f.type == Fermentable::Dry_Extract ) {
+         sugar_kg_ignoreEfficiency += sucrose_kg;
+         if ( f.addAfterBoil )
+            lateAddition_kg_ignoreEff += sucrose_kg;
+      }
+      else {
+         sugar_kg += sucrose_kg;
+         if ( f.addAfterBoil )
+            lateAddition_kg += sucrose_kg;
+      }
+   }
+
+   sugar_kg = snap.efficiency_pct/100.0 * (sugar_kg - lateAddition_kg) + sugar_kg_ignoreEfficiency - lateAddition_kg_ignoreEff;
+   out.boilGrav = Algorithms::PlatoToSG_20C20C( Algorithms::getPlato(sugar_kg, snap.boilSize_l) );
+}
+
+void RecipeCalc::calcIBU(RecipeSnapshot const& snap, RecipeCalcResult& out)
+{
+   IbuMethods::HopBatch batch;
+
+   // See Recipe::recalcIBU()
+   batch.reserve(snap.hops.size());
+   foreach( RecipeSnapshot::HopData const& h, snap.hops )
+      batch.append( h.alpha_pct/100.0, h.amount_kg*1000.0, h.time_min, h.use, h.form );
+
+   out.ibus.resize(batch.size());
+   out.IBU = IbuMethods::getIbus( batch, ibuWort(snap, out), out.ibus.data() );
+
+   // Bitterness due to hopped extracts...
+   foreach( RecipeSnapshot::FermentableData const& f, snap.fermentables ) {
+      // Conversion factor for lb/gal to kg/l = 8.34538.
+      out.IBU += f.ibuGalPerLb * (f.amount_kg / snap.batchSize_l) / 8.34538;
+   }
+}
+
+IbuMethods::Wort RecipeCalc::ibuWort(RecipeSnapshot const& snap, RecipeCalcResult const& out)
+{
+   IbuMethods::Wort wort;
+
+   wort.finalVolume_l = out.finalVolumeNoLosses_l;
+   wort.gravity = out.og;
+   wort.boilTime_min = static_cast<int>(snap.boilTime_min);
+   wort.hopUtilization = snap.hopUtilization_pct / 100.0;
+   wort.firstWortAdjustment = snap.firstWortHopAdjustment;
+   wort.mashHopAdjustment = snap.mashHopAdjustment;
+
+   return wort;
+}
+
+// See Recipe::recalcCalories()
+void RecipeCalc::calcCalories(RecipeCalcResult& out)
+{
+   double startPlato  = -463.37 + ( 668.72 * out.og ) - (205.35 * out.og * out.og);
+   double finishPlato = -463.37 + ( 668.72 * out.fg ) - (205.35 * out.fg * out.fg);
+   double RE = (0.1808 * startPlato) + (0.8192 * finishPlato);
+   double abw = (startPlato-RE)/(2.0665 - (0.010665 * startPlato));
+
+   out.calories = ((6.9*abw) + 4.0 * (RE-0.1)) * out.fg * 3.55;
+   if ( out.calories < 0 )
+      out.calories = 0;
+}
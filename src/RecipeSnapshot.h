@@ -0,0 +1,160 @@
+/*
+ * RecipeSnapshot.h is part of Brewtarget, and is Copyright the following
+ * authors 2024
+ *
+ * Brewtarget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brewtarget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _RECIPESNAPSHOT_H
+#define _RECIPESNAPSHOT_H
+
+#include <QString>
+#include <QVector>
+
+#include "fermentable.h"
+#include "hop.h"
+#include "IbuMethods.h"
+
+class Recipe;
+
+/*!
+ * \struct RecipeSnapshot
+ *
+ * \brief A plain copy of everything the recipe calculations read.
+ *
+ * fromRecipe() fills one in with a single pass over the recipe and its
+ * ingredients. After that the snapshot owns all its data. It can be copied,
+ * handed to another thread and given to RecipeCalc::calculate() without
+ * touching the database or any QObject.
+ */
+struct RecipeSnapshot
+{
+   struct FermentableData {
+      Fermentable::Type type;
+      double amount_kg;
+      double yield_pct;
+      double moisture_pct;
+      double color_srm;
+      double ibuGalPerLb;
+      bool isMashed;
+      bool addAfterBoil;
+      //! False for the sugars yeast won't eat. See Recipe::isFermentableSugar().
+      bool fermentable;
+   };
+
+   struct HopData {
+      Hop::Use use;
+      Hop::Form form;
+      double alpha_pct;
+      double amount_kg;
+      double time_min;
+   };
+
+   int key = 0;
+   QString name;
+
+   double batchSize_l = 0.0;
+   double boilSize_l = 0.0;
+   double efficiency_pct = 0.0;
+
+   //! When false the equipment fields hold the defaults Recipe assumes.
+   bool hasEquipment = false;
+   double boilTime_min = 60.0;
+   double evapRate_lHr = 0.0;
+   double lauterDeadspace_l = 0.0;
+   double topUpKettle_l = 0.0;
+   double topUpWater_l = 0.0;
+   double trubChillerLoss_l = 0.0;
+   double grainAbsorption_LKg = 0.0;
+   double hopUtilization_pct = 100.0;
+
+   bool hasMash = false;
+   double totalMashWater_l = 0.0;
+
+   //! The options ibuFromHop() uses, as they were when the snapshot was taken
+   double firstWortHopAdjustment = 1.1;
+   double mashHopAdjustment = 0.0;
+
+   QVector<FermentableData> fermentables;
+   QVector<HopData> hops;
+   QVector<double> yeastAttenuations_pct;
+
+   /*!
+    * \brief Copies \b rec. Has to be called on the thread that owns the
+    *        database, as the ingredient lists come from there.
+    */
+   static RecipeSnapshot fromRecipe(Recipe* rec);
+};
+
+/*!
+ * \struct RecipeCalcResult
+ *
+ * \brief Everything RecipeCalc::calculate() works out, named as on Recipe.
+ */
+struct RecipeCalcResult
+{
+   double grainsInMash_kg = 0.0;
+   double grains_kg = 0.0;
+
+   double wortFromMash_l = 0.0;
+   double boilVolume_l = 0.0;
+   double postBoilVolume_l = 0.0;
+   double finalVolume_l = 0.0;
+   double finalVolumeNoLosses_l = 0.0;
+
+   double og = 1.0;
+   double fg = 1.0;
+   double og_fermentable = 1.0;
+   double fg_fermentable = 1.0;
+   double boilGrav = 1.0;
+   double ABV_pct = 0.0;
+   double calories = 0.0;
+
+   double color_srm = 0.0;
+
+   double IBU = 0.0;
+   //! IBUs from each hop, in the same order as RecipeSnapshot::hops
+   QVector<double> ibus;
+};
+
+/*!
+ * \class RecipeCalc
+ *
+ * \brief The recipe calculations as pure functions of a RecipeSnapshot.
+ *
+ * These follow Recipe::recalcAll() step for step, so a snapshot of a recipe
+ * calculates to the same numbers the recipe shows. The formulas chosen in
+ * the options are read, but nothing is written, so calculate() is safe to
+ * call from any thread.
+ */
+class RecipeCalc
+{
+public:
+   static RecipeCalcResult calculate(RecipeSnapshot const& snap);
+
+   //! \brief Sucrose equivalent of \b ferm. Same as Fermentable::equivSucrose_kg()
+   static double equivSucrose_kg(RecipeSnapshot::FermentableData const& ferm);
+   //! \brief What IbuMethods needs to know about the wort \b snap's hops go into, once \b out has its OG and volumes
+   static IbuMethods::Wort ibuWort(RecipeSnapshot const& snap, RecipeCalcResult const& out);
+
+private:
+   static void calcVolumes(RecipeSnapshot const& snap, RecipeCalcResult& out);
+   static void calcOgFg(RecipeSnapshot const& snap, RecipeCalcResult& out);
+   static void calcBoilGrav(RecipeSnapshot const& snap, RecipeCalcResult& out);
+   static void calcColor(RecipeSnapshot const& snap, RecipeCalcResult& out);
+   static void calcIBU(RecipeSnapshot const& snap, RecipeCalcResult& out);
+   static void calcCalories(RecipeCalcResult& out);
+};
+
+#endif
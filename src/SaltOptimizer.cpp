@@ -0,0 +1,325 @@
+/*
+ * SaltOptimizer.cpp is part of Brewtarget, and is Copyright the following
+ * authors 2024
+ *
+ * Brewtarget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brewtarget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SaltOptimizer.h"
+
+#include <cmath>
+#include <QDebug>
+
+#include "matrix.h"
+
+namespace {
+   // The pH chemistry is Kai Troester's, published at
+   // http://braukaiser.com/wiki/index.php/Beer_color_to_mash_pH_(v2.0)
+   // 50 mEq/l is what Kai uses.
+   double const mEq = 50.0;
+   // grams per mole
+   double const Cagpm = 40.0;
+   double const Mggpm = 24.30;
+   double const HCO3gpm = 61.01;
+   double const CO3gpm = 60.01;
+   double const lactic_gpm = 90.0;
+   double const H3PO4_gpm = 98.0;
+
+   //! Near enough to the target, which for the ions is what WaterDialog::setDigits() shows as in range
+   double const ppmTolerance = 0.05;
+   double const pHTolerance = 0.05;
+   //! So that an ion the target has little or none of does not swamp the rest
+   double const ppmFloor = 1.0;
+
+   double ionOf(Salt::Ions const& ions, int ion)
+   {
+      switch (ion) {
+         case Water::Ca:   return ions.Ca;
+         case Water::Cl:   return ions.Cl;
+         case Water::HCO3: return ions.HCO3;
+         case Water::Mg:   return ions.Mg;
+         case Water::Na:   return ions.Na;
+         case Water::SO4:  return ions.SO4;
+         default: return 0.0;
+      }
+   }
+
+   double ppmBand(double target_ppm)
+   {
+      return qMax(ppmTolerance * target_ppm, ppmFloor);
+   }
+
+   double dot(QVector<double> const& a, QVector<double> const& b)
+   {
+      double ret = 0.0;
+      for( int i = 0; i < a.size(); ++i )
+         ret += a[i] * b[i];
+      return ret;
+   }
+
+   /*!
+    * Minimises |Az - b| over the columns of \b A that are \b passive, through
+    * the normal equations. The other elements of \b z are 0.
+    *
+    * \returns false if those columns are not independent
+    */
+   bool leastSquares(QVector< QVector<double> > const& A, QVector<double> const& b,
+                     QVector<bool> const& passive, QVector<double>& z)
+   {
+      QVector<int> cols;
+      int i, j;
+
+      for( j = 0; j < A.size(); ++j ) {
+         if ( passive[j] )
+            cols.append(j);
+      }
+
+      int const k = cols.size();
+      Matrix normal(k, k + 1);
+      for( i = 0; i < k; ++i ) {
+         for( j = 0; j < k; ++j )
+            normal.setVal(i, j, dot(A[cols[i]], A[cols[j]]));
+         normal.setVal(i, k, dot(A[cols[i]], b));
+      }
+
+      normal.rref();
+      if ( ! normal.hasNonZeroDiags() )
+         return false;
+
+      z.fill(0.0);
+      for( i = 0; i < k; ++i )
+         z[cols[i]] = normal.getVal(i, k);
+      return true;
+   }
+
+   /*!
+    * Lawson and Hanson's non-negative least squares. \b A is by column, and
+    * each column should be scaled to about 1 for Matrix::rref() to cope.
+    *
+    * Columns are made free one at a time, the one the residual pulls on
+    * hardest first. Whenever the least squares solution over the free
+    * columns would take one below zero, we go as far towards it as we can
+    * and pin whatever hit zero.
+    */
+   void nnls(QVector< QVector<double> > const& A, QVector<double> const& b, QVector<double>& x, int& iterations)
+   {
+      int const n = A.size();
+      QVector<bool> passive(n, false);
+      // Columns that could not be solved for alongside the others
+      QVector<bool> stuck(n, false);
+      QVector<double> z(n);
+      int i, j;
+
+      double const tolerance = 1e-10 * (1.0 + dot(b, b));
+      x.fill(0.0, n);
+
+      for( int outer = 0; outer < 3 * n; ++outer ) {
+         QVector<double> residual = b;
+         for( j = 0; j < n; ++j ) {
+            for( i = 0; i < residual.size(); ++i )
+               residual[i] -= A[j][i] * x[j];
+         }
+
+         int best = -1;
+         double bestPull = tolerance;
+         for( j = 0; j < n; ++j ) {
+            double pull = dot(A[j], residual);
+            if ( ! passive[j] && ! stuck[j] && pull > bestPull ) {
+               best = j;
+               bestPull = pull;
+            }
+         }
+         if ( best < 0 )
+            break;
+         passive[best] = true;
+
+         // Every pass that does not finish pins at least one column
+         for( int inner = 0; inner <= n; ++inner ) {
+            ++iterations;
+            if ( ! leastSquares(A, b, passive, z) ) {
+               passive[best] = false;
+               break;
+            }
+
+            double alpha = 1.0;
+            for( j = 0; j < n; ++j ) {
+               if ( passive[j] && z[j] <= 0.0 )
+                  alpha = qMin(alpha, x[j] > z[j] ? x[j] / (x[j] - z[j]) : 0.0);
+            }
+            if ( alpha >= 1.0 ) {
+               x = z;
+               break;
+            }
+
+            for( j = 0; j < n; ++j ) {
+               if ( ! passive[j] )
+                  continue;
+               x[j] += alpha * (z[j] - x[j]);
+               if ( x[j] <= 1e-12 ) {
+                  x[j] = 0.0;
+                  passive[j] = false;
+               }
+            }
+         }
+
+         // Only rounding can make the column we just freed go straight back
+         // to zero, and it would do the same again next time
+         if ( ! passive[best] )
+            stuck[best] = true;
+      }
+   }
+}
+
+SaltOptimizer::SaltOptimizer(Mash const& mash)
+   : m_mash(mash),
+     m_limits(Salt::numTypes)
+{
+   m_limits[Salt::LACTIC].percentAcid = 88.0;
+   m_limits[Salt::H3PO4].percentAcid = 10.0;
+}
+
+QVector<Salt::Types> const& SaltOptimizer::additions()
+{
+   static QVector<Salt::Types> const ret = {
+      Salt::CACL2, Salt::CACO3, Salt::CASO4, Salt::MGSO4,
+      Salt::NACL, Salt::NAHCO3, Salt::LACTIC, Salt::H3PO4
+   };
+   return ret;
+}
+
+SaltOptimizer::Result SaltOptimizer::solve(Water* target, double targetpH) const
+{
+   QVector<double> targetPpm(Water::numIons);
+
+   for( int i = 0; i < Water::numIons; ++i )
+      targetPpm[i] = target->ppm(static_cast<Water::Ions>(i));
+   return solve(targetPpm, targetpH);
+}
+
+SaltOptimizer::Result SaltOptimizer::solve(QVector<double> const& targetPpm, double targetpH) const
+{
+   Result ret;
+   int i, j;
+
+   if ( m_mash.water_l <= 0.0 || m_mash.thickness_LKg <= 0.0 ) {
+      qWarning() << Q_FUNC_INFO << "Can not work out additions without any water or grain";
+      ret.ppm = m_mash.ppm;
+      ret.pH = m_mash.pH;
+      return ret;
+   }
+
+   bool const wantpH = targetpH > 0.0;
+   int const rows = Water::numIons + (wantpH ? 1 : 0);
+
+   // What a gram of each salt or a ml of each acid does, measured in bands
+   QVector<Salt::Types> types;
+   QVector< QVector<double> > A;
+   QVector<double> scale;
+   foreach( Salt::Types type, additions() ) {
+      Limits const& limit = m_limits[type];
+      QVector<double> col(rows, 0.0);
+
+      if ( ! limit.allowed )
+         continue;
+
+      if ( type == Salt::LACTIC || type == Salt::H3PO4 ) {
+         if ( ! wantpH )
+            continue;
+         double acid_g = Salt::acidPerLitre_g(type, limit.percentAcid) / 1000.0;
+         col[Water::numIons] = -acidpH(type == Salt::LACTIC ? acid_g : 0.0,
+                                       type == Salt::H3PO4 ? acid_g : 0.0,
+                                       m_mash.thickness_LKg) / pHTolerance;
+      }
+      else {
+         Salt::Ions const ions = Salt::ionsPerGram(type);
+         for( i = 0; i < Water::numIons; ++i )
+            col[i] = ionOf(ions, i) / m_mash.water_l / ppmBand(targetPpm[i]);
+         if ( wantpH )
+            col[Water::numIons] = addedSaltpH(ions.Ca, ions.Mg, ions.HCO3, ions.CO3, m_mash.thickness_LKg) / pHTolerance;
+      }
+
+      double norm = std::sqrt(dot(col, col));
+      if ( norm <= 0.0 )
+         continue;
+      for( i = 0; i < rows; ++i )
+         col[i] /= norm;
+      types.append(type);
+      A.append(col);
+      scale.append(norm);
+   }
+
+   QVector<double> b(rows);
+   for( i = 0; i < Water::numIons; ++i )
+      b[i] = (targetPpm[i] - m_mash.ppm[i]) / ppmBand(targetPpm[i]);
+   if ( wantpH )
+      b[Water::numIons] = (targetpH - m_mash.pH) / pHTolerance;
+
+   QVector<double> x;
+   nnls(A, b, x, ret.iterations);
+
+   // Back to kg and L, and what they come to
+   double ca_mg = 0.0, mg_mg = 0.0, hco3_mg = 0.0, co3_mg = 0.0;
+   double lactic_g = 0.0, H3PO4_g = 0.0;
+   ret.ppm = m_mash.ppm;
+   for( j = 0; j < types.size(); ++j ) {
+      Salt::Types type = types[j];
+      double amount = x[j] / scale[j];
+
+      ret.amounts[type] = amount / 1000.0;
+      if ( type == Salt::LACTIC )
+         lactic_g = Salt::acidPerLitre_g(type, m_limits[type].percentAcid) * amount / 1000.0;
+      else if ( type == Salt::H3PO4 )
+         H3PO4_g = Salt::acidPerLitre_g(type, m_limits[type].percentAcid) * amount / 1000.0;
+      else {
+         Salt::Ions const ions = Salt::ionsPerGram(type);
+         for( i = 0; i < Water::numIons; ++i )
+            ret.ppm[i] += ionOf(ions, i) * amount / m_mash.water_l;
+         ca_mg += ions.Ca * amount;
+         mg_mg += ions.Mg * amount;
+         hco3_mg += ions.HCO3 * amount;
+         co3_mg += ions.CO3 * amount;
+      }
+   }
+   ret.pH = m_mash.pH + addedSaltpH(ca_mg, mg_mg, hco3_mg, co3_mg, m_mash.thickness_LKg)
+                      - acidpH(lactic_g, H3PO4_g, m_mash.thickness_LKg);
+
+   ret.reached = ! wantpH || std::fabs(ret.pH - targetpH) <= pHTolerance;
+   for( i = 0; i < Water::numIons; ++i ) {
+      if ( std::fabs(ret.ppm[i] - targetPpm[i]) > ppmBand(targetPpm[i]) )
+         ret.reached = false;
+   }
+
+   return ret;
+}
+
+double SaltOptimizer::addedSaltpH(double ca_mg, double mg_mg, double hco3_mg, double co3_mg, double thickness_LKg)
+{
+   // I have no idea where the 2 comes from, but Kai did it.
+   double ca = ca_mg/Cagpm * 2;
+   double mg = mg_mg/Mggpm * 2;
+   double hco3 = hco3_mg/HCO3gpm;
+   double co3 = co3_mg/CO3gpm;
+
+   // The 3.5 and 7 come from Paul Kohlbach's work from the 1940's, and the
+   // 61 is another magic number from Kai. These are masses rather than
+   // mg/L, so there is no need to divide by the volume.
+   double totalDelta = 0.0 - ca/3.5 - mg/7 + (hco3+co3)/61;
+   return totalDelta/thickness_LKg/mEq;
+}
+
+double SaltOptimizer::acidpH(double lactic_g, double H3PO4_g, double thickness_LKg)
+{
+   double totalDelta = 1000 * lactic_g / lactic_gpm + 1000 * H3PO4_g / H3PO4_gpm;
+   return totalDelta/mEq/thickness_LKg;
+}
@@ -0,0 +1,102 @@
+/*
+ * SaltOptimizer.h is part of Brewtarget, and is Copyright the following
+ * authors 2024
+ *
+ * Brewtarget is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brewtarget is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SALTOPTIMIZER_H
+#define _SALTOPTIMIZER_H
+
+#include <QVector>
+
+#include "salt.h"
+#include "water.h"
+
+/*!
+ * \class SaltOptimizer
+ *
+ * \brief Works out the salt and acid additions that bring a base water to a
+ *        target profile and mash pH.
+ *
+ * With the water chemistry WaterDialog uses, the ppm of every ion and the
+ * mash pH are linear in the amount of each addition, and no addition can be
+ * taken back out. So solve() is a non-negative least squares problem: each
+ * ion is measured against the 5% band WaterDialog shows as in range, the pH
+ * against 0.05, and the additions are found with Lawson and Hanson's active
+ * set method over Matrix. A water with more of an ion than the target just
+ * gets none of the salts that add it.
+ */
+class SaltOptimizer
+{
+public:
+   //! \brief The water the additions go into
+   struct Mash {
+      //! Mash and sparge water together, which is what the additions are spread over
+      double water_l = 0.0;
+      //! Litres of strike water per kg of grain
+      double thickness_LKg = 0.0;
+      //! The mash pH with no additions
+      double pH = 5.6;
+      //! Indexed by Water::Ions. What the water has before any additions, after any RO.
+      QVector<double> ppm = QVector<double>(Water::numIons, 0.0);
+   };
+
+   //! \brief What solve() may do with one kind of addition
+   struct Limits {
+      bool allowed = true;
+      //! How strong the acid on hand is. Only used for the acids.
+      double percentAcid = 0.0;
+   };
+
+   struct Result {
+      //! False unless every ion is in its 5% band and the pH within 0.05
+      bool reached = false;
+      //! Indexed by Salt::Types. kg for the salts and L for the acids, like Salt::amount().
+      QVector<double> amounts = QVector<double>(Salt::numTypes, 0.0);
+      //! Indexed by Water::Ions. What the water comes to with \c amounts.
+      QVector<double> ppm = QVector<double>(Water::numIons, 0.0);
+      double pH = 0.0;
+      int iterations = 0;
+   };
+
+   //! \brief Sets up for \b mash, with every addition allowed and the acids at the strengths SaltTableModel starts them at.
+   explicit SaltOptimizer(Mash const& mash);
+
+   //! \brief The additions solve() works out: CaCl2, CaCO3, CaSO4, MgSO4, NaCl, NaHCO3, lactic and phosphoric acid
+   static QVector<Salt::Types> const& additions();
+
+   Limits& limits(Salt::Types type) { return m_limits[type]; }
+   Limits const& limits(Salt::Types type) const { return m_limits[type]; }
+
+   /*!
+    * \brief Additions that bring the water as near to \b targetPpm, indexed
+    *        by Water::Ions, and the mash as near to \b targetpH as they can.
+    *
+    * A \b targetpH of 0 leaves the pH to fall where it may, and the acids out.
+    */
+   Result solve(QVector<double> const& targetPpm, double targetpH) const;
+   Result solve(Water* target, double targetpH) const;
+
+   //! \brief The pH shift from adding \b ca_mg of calcium, \b mg_mg of magnesium and so on to the mash.
+   static double addedSaltpH(double ca_mg, double mg_mg, double hco3_mg, double co3_mg, double thickness_LKg);
+   //! \brief How far \b lactic_g of lactic acid and \b H3PO4_g of phosphoric acid bring the mash pH down.
+   static double acidpH(double lactic_g, double H3PO4_g, double thickness_LKg);
+
+private:
+   Mash m_mash;
+   QVector<Limits> m_limits;
+};
+
+#endif
@@ -43,6 +43,7 @@
 #include "mash.h"
 #include "mashstep.h"
 #include "brewtarget.h"
+#include "SaltOptimizer.h"
 
 static QStringList addToName = QStringList() << QObject::tr("Never")
                                              << QObject::tr("Mash")
@@ -280,9 +281,6 @@ double SaltTableModel::total(Salt::Types type) const
 
 double SaltTableModel::totalAcidWeight(Salt::Types type) const
 {
-   const double H3PO4_density = 1.685;
-   const double lactic_density = 1.2;
-
    double ret = 0.0;
    if (type != Salt::NONE) {
       foreach(Salt* i, saltObs) {
@@ -294,14 +292,10 @@ double SaltTableModel::totalAcidWeight(Salt::Types type) const
             }
             // Lactic acid isn't quite so easy
             else if ( type == Salt::LACTIC ) {
-               double density = i->percentAcid()/88.0 * (lactic_density - 1.0) + 1.0;
-               double lactic_wgt = 1000.0 * i->amount() * mult * density;
-               ret += (i->percentAcid()/100.0) * lactic_wgt;
+               ret += Salt::acidPerLitre_g(type, i->percentAcid()) * i->amount() * mult;
             }
             else if ( type == Salt::H3PO4 ) {
-               double density = i->percentAcid()/85.0 * (H3PO4_density - 1.0) + 1.0;
-               double H3PO4_wgt = 1000.0 * i->amount() * density;
-               ret += (i->percentAcid()/100.0) * H3PO4_wgt;
+               ret += Salt::acidPerLitre_g(type, i->percentAcid()) * i->amount();
             }
          }
       }
@@ -309,6 +303,52 @@ double SaltTableModel::totalAcidWeight(Salt::Types type) const
    return ret;
 }
 
+double SaltTableModel::totalOutsideMash(Water::Ions ion) const
+{
+   double ret = 0.0;
+   foreach(Salt* i, saltObs) {
+      if ( i->addTo() == Salt::MASH )
+         continue;
+
+      double mult  = multiplier(i);
+      switch(ion) {
+         case Water::Ca:   ret += mult * i->Ca(); break;
+         case Water::Cl:   ret += mult * i->Cl(); break;
+         case Water::HCO3: ret += mult * i->HCO3(); break;
+         case Water::Mg:   ret += mult * i->Mg(); break;
+         case Water::Na:   ret += mult * i->Na(); break;
+         case Water::SO4:  ret += mult * i->SO4(); break;
+         default: break;
+      }
+   }
+   return ret;
+}
+
+double SaltTableModel::pHOutsideMash(double thickness_LKg) const
+{
+   double ca = 0.0, mg = 0.0, hco3 = 0.0, co3 = 0.0;
+   double lactic_g = 0.0, H3PO4_g = 0.0;
+
+   foreach(Salt* i, saltObs) {
+      if ( i->addTo() == Salt::MASH || i->addTo() == Salt::NEVER || i->type() == Salt::ACIDMLT )
+         continue;
+
+      // The same sums as total_Ca() and friends, and totalAcidWeight()
+      double mult  = multiplier(i);
+      ca   += mult * i->Ca();
+      mg   += mult * i->Mg();
+      hco3 += mult * i->HCO3();
+      co3  += mult * i->CO3();
+      if ( i->type() == Salt::LACTIC )
+         lactic_g += Salt::acidPerLitre_g(Salt::LACTIC, i->percentAcid()) * i->amount() * mult;
+      else if ( i->type() == Salt::H3PO4 )
+         H3PO4_g += Salt::acidPerLitre_g(Salt::H3PO4, i->percentAcid()) * i->amount();
+   }
+
+   return SaltOptimizer::addedSaltpH(ca, mg, hco3, co3, thickness_LKg)
+        - SaltOptimizer::acidpH(lactic_g, H3PO4_g, thickness_LKg);
+}
+
 void SaltTableModel::removeSalt(Salt* salt)
 {
    int i;
@@ -647,6 +687,28 @@ void SaltTableModel::contextMenu(const QPoint &point)
 
 }
 
+void SaltTableModel::setMashAddition(Salt::Types type, double amount, double percentAcid)
+{
+   QList<int> dead;
+
+   for( int i = 0; i < saltObs.size(); ++i ) {
+      if ( saltObs.at(i)->type() == type && saltObs.at(i)->addTo() == Salt::MASH )
+         dead.append(i);
+   }
+   if ( dead.size() )
+      removeSalts(dead);
+
+   if ( amount > 0.0 ) {
+      Salt* gaq = new Salt(saltNames.at(type),true);
+      gaq->setType(type);
+      gaq->setAddTo(Salt::MASH);
+      gaq->setAmount(amount);
+      gaq->setPercentAcid(percentAcid);
+      addSalt(gaq);
+      emit newTotals();
+   }
+}
+
 void SaltTableModel::saveAndClose()
 {
    // all of the writes should have been instantaneous unless
@@ -88,7 +88,18 @@ public:
    double total( Salt::Types type ) const;
    double totalAcidWeight(Salt::Types type) const;
 
+   //! \brief total() for the salts setMashAddition() leaves alone, which is all but those added to the mash only
+   double totalOutsideMash(Water::Ions ion) const;
+   //! \brief The mash pH shift from those same salts and acids, leaving out acid malt
+   double pHOutsideMash(double thickness_LKg) const;
+
    void removeSalts(QList<int>deadSalts);
+   /*!
+    * \brief Replaces the \b type additions to the mash only with one of
+    *        \b amount, or with nothing if \b amount is 0. Additions to the
+    *        sparge, or to both, stay as they are.
+    */
+   void setMashAddition(Salt::Types type, double amount, double percentAcid = 0.0);
    void saveAndClose();
 
 public slots:
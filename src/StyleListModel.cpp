@@ -27,6 +27,11 @@ StyleListModel::StyleListModel(QWidget* parent)
    : QAbstractListModel(parent), recipe(0)
 {
    connect( &(Database::instance()), &Database::newStyleSignal, this, &StyleListModel::addStyle );
+   connect( &(Database::instance()), &Database::elementsAdded, this, [this](QList<Ingredient*> const& added) {
+      QList<Style*> styles = Database::elementsOfType<Style>(added);
+      if ( ! styles.isEmpty() )
+         addStyles(styles);
+   });
    connect( &(Database::instance()), SIGNAL(deletedSignal(Style*)), this, SLOT(removeStyle(Style*)) );
    repopulateList();
 }
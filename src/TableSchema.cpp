@@ -20,6 +20,7 @@
 #include "brewtarget.h"
 #include "database.h"
 #include <QString>
+#include <QMetaProperty>
 #include "PropertySchema.h"
 #include "TableSchema.h"
 
@@ -140,41 +141,61 @@ const QStringList TableSchema::allForeignKeyColumnNames(Brewtarget::DBTypes type
 
 const PropertySchema* TableSchema::property(QString prop) const
 {
-   PropertySchema* retval = nullptr;
-   if ( m_properties.contains(prop) ) {
-      retval = m_properties.value(prop);
+   return m_properties.value(prop, nullptr);
+}
+
+const PropertySchema* TableSchema::foreignKey(QString fkey) const
+{
+   return m_foreignKeys.value(fkey, nullptr);
+}
+
+const PropertySchema* TableSchema::metaProperty(QMetaObject const* meta, int propertyIndex) const
+{
+   if ( m_metaPropertiesOf.loadAcquire() != meta ) {
+      QMutexLocker locker(&m_metaPropertiesMutex);
+
+      // Somebody may have beaten us to it
+      if ( m_metaPropertiesOf.loadAcquire() == nullptr ) {
+         QVector<PropertySchema*> props(meta->propertyCount(), nullptr);
+         for ( int i = 0; i < props.size(); ++i ) {
+            QString name = QString::fromLatin1(meta->property(i).name());
+            PropertySchema* p = m_properties.value(name, nullptr);
+            props[i] = p ? p : m_foreignKeys.value(name, nullptr);
+         }
+         m_metaProperties = props;
+         m_metaPropertiesOf.storeRelease(meta);
+      }
+      // Only one class lives in a table. Anybody else takes the slow road.
+      else if ( m_metaPropertiesOf.loadAcquire() != meta ) {
+         return nullptr;
+      }
    }
-   return retval;
+
+   if ( propertyIndex < 0 || propertyIndex >= m_metaProperties.size() )
+      return nullptr;
+
+   return m_metaProperties.at(propertyIndex);
 }
 
 const QString TableSchema::propertyName(QString prop, Brewtarget::DBTypes type) const
 {
    Brewtarget::DBTypes selected = type == Brewtarget::ALLDB ? m_defType : type;
-   QString retval;
-   if ( m_properties.contains(prop) ) {
-      retval =  m_properties.value(prop)->propName(selected);
-   }
-   return retval;
+   PropertySchema const* p = m_properties.value(prop, nullptr);
+   return p ? p->propName(selected) : QString();
 
 }
 const QString TableSchema::propertyToColumn(QString prop, Brewtarget::DBTypes type) const
 {
    Brewtarget::DBTypes selected = type == Brewtarget::ALLDB ? m_defType : type;
-   QString retval;
-   if ( m_properties.contains(prop) ) {
-      retval =  m_properties.value(prop)->colName(selected);
-   }
-   return retval;
+   PropertySchema const* p = m_properties.value(prop, nullptr);
+   return p ? p->colName(selected) : QString();
 }
 
 const QString TableSchema::foreignKeyToColumn(QString fkey, Brewtarget::DBTypes type) const
 {
    Brewtarget::DBTypes selected = type == Brewtarget::ALLDB ? m_defType : type;
-   QString retval;
-   if ( m_foreignKeys.contains(fkey) ) {
-      retval =  m_foreignKeys.value(fkey)->colName(selected);
-   }
-   return retval;
+   PropertySchema const* p = m_foreignKeys.value(fkey, nullptr);
+   return p ? p->colName(selected) : QString();
 }
 
 const QString TableSchema::foreignKeyToColumn(Brewtarget::DBTypes type) const
@@ -191,10 +212,9 @@ const QString TableSchema::foreignKeyToColumn(Brewtarget::DBTypes type) const
 const QString TableSchema::propertyToXml(QString prop, Brewtarget::DBTypes type) const
 {
    Brewtarget::DBTypes selected = type == Brewtarget::ALLDB ? m_defType : type;
-   QString retval;
-   if ( m_properties.contains(prop) ) {
-      retval = m_properties.value(prop)->xmlName(selected);
-   }
+   PropertySchema const* p = m_properties.value(prop, nullptr);
+   QString retval = p ? p->xmlName(selected) : QString();
+
    if ( retval.isEmpty() ) {
       foreach( PropertySchema* p, m_properties.values() ) {
          if ( p->propName(selected) == prop ) {
@@ -226,44 +246,29 @@ const QString TableSchema::xmlToProperty(QString xmlName, Brewtarget::DBTypes ty
 const QString TableSchema::propertyColumnType(QString prop, Brewtarget::DBTypes type) const
 {
    Brewtarget::DBTypes selected = type == Brewtarget::ALLDB ? m_defType : type;
-   if ( m_properties.contains(prop) ) {
-      return m_properties.value(prop)->colType(selected);
-   }
-   else {
-      return QString();
-   }
+   PropertySchema const* p = m_properties.value(prop, nullptr);
+   return p ? p->colType(selected) : QString();
 }
 
 const QVariant TableSchema::propertyColumnDefault(QString prop, Brewtarget::DBTypes type) const
 {
    Brewtarget::DBTypes selected = type == Brewtarget::ALLDB ? m_defType : type;
-   QVariant retval = QString();
-   if ( m_properties.contains(prop) ) {
-      retval = m_properties.value(prop)->defaultValue(selected);
-   }
-   return retval;
+   PropertySchema const* p = m_properties.value(prop, nullptr);
+   return p ? p->defaultValue(selected) : QVariant(QString());
 }
 
 int TableSchema::propertyColumnSize(QString prop, Brewtarget::DBTypes type) const
 {
    Brewtarget::DBTypes selected = type == Brewtarget::ALLDB ? m_defType : type;
-   if ( m_properties.contains(prop) ) {
-      return m_properties.value(prop)->colSize(selected);
-   }
-   else {
-      return 0;
-   }
+   PropertySchema const* p = m_properties.value(prop, nullptr);
+   return p ? p->colSize(selected) : 0;
 }
 
 Brewtarget::DBTable TableSchema::foreignTable(QString fkey, Brewtarget::DBTypes type) const
 {
    Brewtarget::DBTypes selected = type == Brewtarget::ALLDB ? m_defType : type;
-   Brewtarget::DBTable retval = Brewtarget::NOTABLE;
-
-   if ( m_foreignKeys.contains(fkey) ) {
-      retval =  m_foreignKeys.value(fkey)->fTable(selected);
-   }
-   return retval;
+   PropertySchema const* p = m_foreignKeys.value(fkey, nullptr);
+   return p ? p->fTable(selected) : Brewtarget::NOTABLE;
 
 }
 
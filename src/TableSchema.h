@@ -22,6 +22,10 @@
 #include "PropertySchema.h"
 #include "brewtarget.h"
 #include <QString>
+#include <QVector>
+#include <QMutex>
+#include <QAtomicPointer>
+#include <QMetaObject>
 
 class TableSchema : QObject
 {
@@ -59,6 +63,14 @@ public:
 
    // Get the property object. Try not to use this?
    const PropertySchema* property(QString prop) const;
+   // Get the foreign key object, or nullptr
+   const PropertySchema* foreignKey(QString fkey) const;
+   // Get the property or foreign key stored for the propertyIndex'th
+   // property of meta, or nullptr. meta has to be the metaObject() of this
+   // table's class. The first call builds an array indexed by
+   // QMetaProperty::propertyIndex(), so every call after that is a lookup
+   // without any string compares or copies.
+   const PropertySchema* metaProperty(QMetaObject const* meta, int propertyIndex) const;
    // some properties may be named differently (like inventory v quanta)
    const QString propertyName(QString prop, Brewtarget::DBTypes type = Brewtarget::ALLDB) const;
    // get the database column name for this property
@@ -155,6 +167,12 @@ private:
    // metaphor.
    Brewtarget::DBTypes m_defType;
 
+   // Built on the first call to metaProperty(). m_metaPropertiesOf is only
+   // set once the array is complete, so readers never need the mutex.
+   mutable QVector<PropertySchema*> m_metaProperties;
+   mutable QAtomicPointer<const QMetaObject> m_metaPropertiesOf;
+   mutable QMutex m_metaPropertiesMutex;
+
    // getter only. But this is private because only my dearest,
    // closest friends can do this
    Brewtarget::DBTypes defType() const;
@@ -23,10 +23,17 @@
 #include "recipe.h"
 #include "equipment.h"
 #include "database.h"
+#include "OptionsCache.h"
 #include "hop.h"
 #include "fermentable.h"
 #include "mash.h"
 #include "mashstep.h"
+#include "RecipeSnapshot.h"
+#include "Algorithms.h"
+#include "IbuMethods.h"
+#include "HopOptimizer.h"
+#include "GristOptimizer.h"
+#include "SaltOptimizer.h"
 #include "Log.h"
 
 #include <QDebug>
@@ -251,6 +258,457 @@ void Testing::postBoilLossOgTest()
    QVERIFY2( fuzzyComp(recLoss->og(), recNoLoss->og(), 0.002), "OG of recipe with post-boil loss is different from no-loss recipe" );
 }
 
+namespace {
+   /*!
+    * A 20 L batch of pale malt alone, boiled down from 24 L over an hour at
+    * 70% efficiency. Built by hand so nothing goes near the database; the
+    * tests add their own hops, mash and other fermentables.
+    */
+   RecipeSnapshot paleMaltSnapshot(double grain_kg)
+   {
+      RecipeSnapshot snap;
+
+      snap.batchSize_l = 20.0;
+      snap.boilSize_l = 24.0;
+      snap.efficiency_pct = 70.0;
+
+      // 4 L/hr for an hour gets us from the boil size to the batch size
+      snap.hasEquipment = true;
+      snap.boilTime_min = 60.0;
+      snap.evapRate_lHr = 4.0;
+
+      RecipeSnapshot::FermentableData grain;
+      grain.type = Fermentable::Grain;
+      grain.amount_kg = grain_kg;
+      grain.yield_pct = 70.0;
+      grain.moisture_pct = 0.0;
+      grain.color_srm = 2.0;
+      grain.ibuGalPerLb = 0.0;
+      grain.isMashed = true;
+      grain.addAfterBoil = false;
+      grain.fermentable = true;
+      snap.fermentables.append(grain);
+
+      return snap;
+   }
+}
+
+void Testing::recipeSnapshotCalcTest()
+{
+   // The same recipe as recipeCalcTest_allGrain(), but built by hand so
+   // nothing here goes near the database.
+   double const grain_kg = 5.0;
+   RecipeSnapshot snap = paleMaltSnapshot(grain_kg);
+   RecipeSnapshot::FermentableData const grain = snap.fermentables.first();
+
+   snap.grainAbsorption_LKg = 1.0;
+   snap.hopUtilization_pct = 100.0;
+
+   snap.hasMash = true;
+   snap.totalMashWater_l = snap.boilSize_l + snap.grainAbsorption_LKg * grain_kg;
+
+   RecipeSnapshot::HopData hop;
+   hop.use = Hop::Boil;
+   hop.form = Hop::Leaf;
+   hop.alpha_pct = 4.0;
+   hop.amount_kg = 0.085;
+   hop.time_min = 60.0;
+   snap.hops.append(hop);
+
+   RecipeCalcResult calc = RecipeCalc::calculate(snap);
+
+   double mcus = grain.color_srm * (grain_kg * 2.205) / (snap.batchSize_l * 0.2642);
+   double srm = 1.49 * pow(mcus, 0.686);
+   double plato = grain_kg * grain.yield_pct/100.0 * snap.efficiency_pct/100.0 / (snap.batchSize_l * 1.050) * 100;
+   double og = 259.0/(259.0-plato);
+   double ibus = hop.amount_kg*1e6 * hop.alpha_pct/100.0 * 0.235 / snap.batchSize_l;
+
+   QVERIFY2( fuzzyComp(calc.boilVolume_l,  snap.boilSize_l,  0.1),     "Wrong boil volume calculation" );
+   QVERIFY2( fuzzyComp(calc.finalVolume_l, snap.batchSize_l, 0.1),     "Wrong final volume calculation" );
+   QVERIFY2( fuzzyComp(calc.og,            og,               0.002),   "Wrong OG calculation" );
+   QVERIFY2( fuzzyComp(calc.IBU,           ibus,             5.0),     "Wrong IBU calculation" );
+   QVERIFY2( fuzzyComp(calc.color_srm,     srm,              srm*0.1), "Wrong color calculation" );
+   QCOMPARE( calc.ibus.size(), 1 );
+}
+
+namespace {
+   //! The secant search PlatoToSG_20C20C() used before it had a table.
+   double secantPlatoToSG( double plato )
+   {
+      Polynomial poly( Polynomial() << -616.868 << 1111.14 << -630.272 << 135.997 );
+      poly[0] -= plato;
+      return poly.rootFind( 1.000, 1.050 );
+   }
+
+   //! What platoToSgBenchmark() times
+   enum PlatoMethod { PlatoSecant, PlatoSingle, PlatoBatch };
+
+   //! One hop of every use and form, at a spread of times
+   IbuMethods::HopBatch hopScheduleBatch()
+   {
+      IbuMethods::HopBatch batch;
+
+      for( int use = Hop::Mash; use <= Hop::Dry_Hop; ++use ) {
+         for( int form = Hop::Leaf; form <= Hop::Plug; ++form )
+            batch.append( 0.04 + 0.01 * form, 10.0 + use, 5.0 + 15.0 * form, use, form );
+      }
+      return batch;
+   }
+
+   //! 20 L of 1.060 wort, boiled for an hour
+   IbuMethods::Wort hopScheduleWort()
+   {
+      IbuMethods::Wort wort;
+
+      wort.finalVolume_l = 20.0;
+      wort.gravity = 1.060;
+      wort.boilTime_min = 60;
+      wort.hopUtilization = 0.9;
+      wort.firstWortAdjustment = 1.1;
+      wort.mashHopAdjustment = 0.2;
+      return wort;
+   }
+}
+
+void Testing::platoToSgTest()
+{
+   QVector<double> plato;
+   QVector<double> sg;
+   QVector<double> back;
+   double p;
+
+   // Past both ends of the table too
+   for( p = -10.0; p <= 80.0; p += 0.01 )
+      plato.append(p);
+   sg.resize(plato.size());
+   back.resize(plato.size());
+
+   Algorithms::PlatoToSG_20C20C( plato.constData(), sg.data(), plato.size() );
+   Algorithms::SG_20C20C_toPlato( sg.constData(), back.data(), sg.size() );
+
+   for( int i = 0; i < plato.size(); ++i ) {
+      QVERIFY2( fuzzyComp(Algorithms::PlatoToSG_20C20C(plato[i]), secantPlatoToSG(plato[i]), 1e-7), "Wrong SG from Plato" );
+      QVERIFY2( fuzzyComp(sg[i], Algorithms::PlatoToSG_20C20C(plato[i]), 1e-12), "Batch SG differs from single SG" );
+      QVERIFY2( fuzzyComp(back[i], plato[i], 1e-6), "Plato does not survive the round trip" );
+   }
+}
+
+void Testing::platoToSgBenchmark_data()
+{
+   QTest::addColumn<int>("method");
+
+   QTest::newRow("secant") << int(PlatoSecant);
+   QTest::newRow("single") << int(PlatoSingle);
+   QTest::newRow("batch")  << int(PlatoBatch);
+}
+
+void Testing::platoToSgBenchmark()
+{
+   QFETCH(int, method);
+   int const n = 10000;
+   QVector<double> plato(n);
+   QVector<double> sg(n);
+
+   for( int i = 0; i < n; ++i )
+      plato[i] = (i % 400) / 10.0;
+
+   QBENCHMARK {
+      switch( method ) {
+         case PlatoSecant:
+            for( int i = 0; i < n; ++i )
+               sg[i] = secantPlatoToSG(plato[i]);
+            break;
+         case PlatoSingle:
+            for( int i = 0; i < n; ++i )
+               sg[i] = Algorithms::PlatoToSG_20C20C(plato[i]);
+            break;
+         default:
+            Algorithms::PlatoToSG_20C20C( plato.constData(), sg.data(), n );
+            break;
+      }
+   }
+
+   // Whatever was timed has to have come up with the right answers. The inputs repeat every 400.
+   for( int i = 0; i < 400; ++i )
+      QVERIFY2( fuzzyComp(sg[i], secantPlatoToSG(plato[i]), 1e-7), "SG differs from the secant search" );
+}
+
+void Testing::ibuBatchTest()
+{
+   Brewtarget::IbuType const formulas[] = { Brewtarget::TINSETH, Brewtarget::RAGER, Brewtarget::NOONAN };
+   IbuMethods::HopBatch batch = hopScheduleBatch();
+   IbuMethods::Wort wort = hopScheduleWort();
+
+   // QVERIFY returns early, and the other tests want the formula they set up
+   struct FormulaGuard {
+      Brewtarget::IbuType saved;
+      ~FormulaGuard() { Brewtarget::ibuFormula = saved; }
+   } const guard = { Brewtarget::ibuFormula };
+
+   QVector<double> ibus(batch.size());
+   for( Brewtarget::IbuType formula : formulas ) {
+      double total = 0.0;
+      Brewtarget::ibuFormula = formula;
+      double batchTotal = IbuMethods::getIbus( formula, batch, wort, ibus.data() );
+
+      // Recipe::ibuFromHop() as it was before the batch kernel
+      for( int i = 0; i < batch.size(); ++i ) {
+         double minutes = batch.use[i] == Hop::Boil ? batch.minutes[i] : wort.boilTime_min;
+         double expected = IbuMethods::getIbus( batch.AArating[i], batch.grams[i], wort.finalVolume_l, wort.gravity, minutes );
+         if( batch.use[i] == Hop::First_Wort )
+            expected *= wort.firstWortAdjustment;
+         else if( batch.use[i] == Hop::Mash )
+            expected *= wort.mashHopAdjustment;
+         else if( batch.use[i] != Hop::Boil )
+            expected = 0.0;
+         expected *= wort.hopUtilization * (batch.form[i] == Hop::Pellet ? 1.10 : batch.form[i] == Hop::Plug ? 1.02 : 1.0);
+
+         QVERIFY2( fuzzyComp(ibus[i], expected, 1e-9), "Batch IBUs differ from single hop IBUs" );
+         total += expected;
+      }
+      QVERIFY2( fuzzyComp(batchTotal, total, 1e-9), "Wrong batch IBU total" );
+   }
+}
+
+void Testing::ibuBatchBenchmark_data()
+{
+   QTest::addColumn<int>("formula");
+
+   QTest::newRow("tinseth") << int(Brewtarget::TINSETH);
+   QTest::newRow("rager")   << int(Brewtarget::RAGER);
+   QTest::newRow("noonan")  << int(Brewtarget::NOONAN);
+}
+
+void Testing::ibuBatchBenchmark()
+{
+   QFETCH(int, formula);
+   IbuMethods::HopBatch batch = hopScheduleBatch();
+   IbuMethods::Wort wort = hopScheduleWort();
+   double total = 0.0;
+
+   QBENCHMARK {
+      total += IbuMethods::getIbus( static_cast<Brewtarget::IbuType>(formula), batch, wort );
+   }
+   QVERIFY( total > 0.0 );
+}
+
+void Testing::hopOptimizerTest()
+{
+   RecipeSnapshot snap = paleMaltSnapshot(5.0);
+   RecipeSnapshot::HopData hop;
+
+   // Bittering, flavour and aroma
+   hop.use = Hop::Boil;
+   hop.form = Hop::Pellet;
+   hop.alpha_pct = 10.0;
+   hop.amount_kg = 0.020;
+   hop.time_min = 60.0;
+   snap.hops.append(hop);
+   hop.alpha_pct = 5.0;
+   hop.amount_kg = 0.030;
+   hop.time_min = 15.0;
+   snap.hops.append(hop);
+   hop.amount_kg = 0.040;
+   hop.time_min = 0.0;
+   snap.hops.append(hop);
+
+   HopOptimizer optimizer(snap);
+   optimizer.limits(0).max_g = 50.0;
+   optimizer.limits(1).max_g = 100.0;
+   optimizer.limits(2).fixed = true;
+
+   HopOptimizer::Result result = optimizer.solve(45.0);
+
+   QVERIFY( result.reached );
+   QVERIFY2( fuzzyComp(result.ibu, 45.0, 1e-3), "Missed the target IBU" );
+   QVERIFY2( result.grams[0] <= 50.0 + 1e-9, "Went over the maximum" );
+   QCOMPARE( result.grams[2], 40.0 );
+
+   // What the solver thinks it got has to be what the recipe gets
+   for( int i = 0; i < snap.hops.size(); ++i )
+      snap.hops[i].amount_kg = result.grams[i] / 1000.0;
+   QVERIFY2( fuzzyComp(RecipeCalc::calculate(snap).IBU, 45.0, 1e-3), "Recipe does not come to the target IBU" );
+
+   // More than the limits allow gets as close as it can
+   result = optimizer.solve(1000.0);
+   QVERIFY( ! result.reached );
+   QVERIFY2( fuzzyComp(result.grams[0], 50.0, 1e-9), "Bittering hop should be at its maximum" );
+   QVERIFY2( fuzzyComp(result.grams[1], 100.0, 1e-9), "Flavour hop should be at its maximum" );
+}
+
+void Testing::gristOptimizerTest()
+{
+   RecipeSnapshot snap = paleMaltSnapshot(4.0);
+
+   snap.trubChillerLoss_l = 1.0;
+   snap.grainAbsorption_LKg = 1.0;
+   snap.hasMash = true;
+   snap.totalMashWater_l = 30.0;
+
+   // Base malt, a crystal malt and some sugar
+   snap.fermentables[0].yield_pct = 80.0;
+   snap.fermentables[0].moisture_pct = 4.0;
+   RecipeSnapshot::FermentableData ferm = snap.fermentables[0];
+   ferm.amount_kg = 0.3;
+   ferm.yield_pct = 74.0;
+   ferm.color_srm = 60.0;
+   snap.fermentables.append(ferm);
+   ferm.type = Fermentable::Sugar;
+   ferm.amount_kg = 0.2;
+   ferm.yield_pct = 100.0;
+   ferm.moisture_pct = 0.0;
+   ferm.color_srm = 0.0;
+   snap.fermentables.append(ferm);
+
+   GristOptimizer optimizer(snap);
+   optimizer.limits(1).max_pct = 10.0;
+   optimizer.limits(2).fixed = true;
+
+   GristOptimizer::Result result = optimizer.solve(1.060, 10.0);
+
+   QVERIFY( result.reached );
+   QVERIFY2( fuzzyComp(result.og, 1.060, 0.0001), "Missed the target OG" );
+   QVERIFY2( fuzzyComp(result.color_srm, 10.0, 0.05), "Missed the target colour" );
+   QCOMPARE( result.amounts_kg[2], 0.2 );
+
+   double total_kg = result.amounts_kg[0] + result.amounts_kg[1] + result.amounts_kg[2];
+   QVERIFY2( result.amounts_kg[1] <= 0.10 * total_kg + 1e-6, "Crystal malt over its share of the grist" );
+
+   // What the solver thinks it got has to be what the recipe gets
+   for( int i = 0; i < snap.fermentables.size(); ++i )
+      snap.fermentables[i].amount_kg = result.amounts_kg[i];
+   RecipeCalcResult calc = RecipeCalc::calculate(snap);
+   QVERIFY2( fuzzyComp(calc.og, result.og, 1e-9), "Recipe does not come to the reported OG" );
+
+   // Too dark for 10% crystal malt at this gravity
+   result = optimizer.solve(1.040, 40.0);
+   QVERIFY( ! result.reached );
+}
+
+namespace {
+   //! The profiles in default_db.sqlite, in Water::Ions order: Ca, Cl, HCO3, Mg, Na, SO4
+   double const waterProfiles[][Water::numIons] = {
+      { 295.0,  25.0, 300.0, 45.0,  55.0, 725.0 }, // Burton on Trent
+      {  80.0,  75.0, 100.0,  5.0,  25.0,  80.0 }, // Balanced profile
+      { 150.0, 150.0, 220.0, 10.0,  80.0, 160.0 }, // Balanced profile II
+      {  75.0,  50.0,   0.0,  5.0,  10.0, 150.0 }, // Light and hoppy
+      { 187.0,  85.0,  20.0, 41.0, 113.0, 720.0 }, // Burton on Trent, decarbonated
+      { 250.0, 100.0, 340.0, 20.0,  10.0, 300.0 }, // Dortmund, historic
+      { 155.0, 100.0,  53.0, 23.0,  10.0, 300.0 }, // Dortmund, decarbonated
+      { 110.0,  19.0, 280.0,  4.0,  12.0,  53.0 }, // Dublin
+      { 100.0,  45.0, 235.0, 18.0,  20.0, 105.0 }, // Edinburgh
+      { 100.0,  60.0, 265.0,  5.0,  35.0,  50.0 }, // London
+      {  82.0,   2.0, 320.0, 20.0,   4.0,  16.0 }, // Munich Dark
+      {  40.0,  75.0,  29.0, 20.0,   4.0,  52.0 }, // Munich decarbonated
+      {   7.0,   5.0,  25.0,  3.0,   2.0,   5.0 }, // Pilsen
+      {  90.0,  82.0, 223.0, 12.0,  45.0,  65.0 }  // Dusseldorf
+   };
+   int const numWaterProfiles = sizeof(waterProfiles) / sizeof(waterProfiles[0]);
+
+   QVector<double> waterProfile(int profile)
+   {
+      QVector<double> ret(Water::numIons);
+
+      for( int i = 0; i < Water::numIons; ++i )
+         ret[i] = waterProfiles[profile][i];
+      return ret;
+   }
+
+   //! 30 L of \b profile water, mashed at 3 L/kg
+   SaltOptimizer::Mash waterProfileMash(int profile)
+   {
+      SaltOptimizer::Mash mash;
+
+      mash.water_l = 30.0;
+      mash.thickness_LKg = 3.0;
+      mash.pH = 5.6;
+      mash.ppm = waterProfile(profile);
+      return mash;
+   }
+}
+
+void Testing::saltOptimizerTest()
+{
+   // Pilsen water with 4 g CaCl2, 6 g gypsum, 2 g epsom and 1.5 ml of lactic
+   SaltOptimizer::Mash mash = waterProfileMash(12);
+   QVector<double> target = mash.ppm;
+   double const grams[] = { 4.0, 6.0, 2.0 };
+   Salt::Types const salts[] = { Salt::CACL2, Salt::CASO4, Salt::MGSO4 };
+   double ca_mg = 0.0, mg_mg = 0.0;
+
+   for( int s = 0; s < 3; ++s ) {
+      Salt::Ions ions = Salt::ionsPerGram(salts[s]);
+      target[Water::Ca]  += ions.Ca  * grams[s] / mash.water_l;
+      target[Water::Cl]  += ions.Cl  * grams[s] / mash.water_l;
+      target[Water::Mg]  += ions.Mg  * grams[s] / mash.water_l;
+      target[Water::SO4] += ions.SO4 * grams[s] / mash.water_l;
+      ca_mg += ions.Ca * grams[s];
+      mg_mg += ions.Mg * grams[s];
+   }
+   double lactic_g = Salt::acidPerLitre_g(Salt::LACTIC, 88.0) * 0.0015;
+   double targetpH = mash.pH + SaltOptimizer::addedSaltpH(ca_mg, mg_mg, 0.0, 0.0, mash.thickness_LKg)
+                             - SaltOptimizer::acidpH(lactic_g, 0.0, mash.thickness_LKg);
+
+   SaltOptimizer optimizer(mash);
+   optimizer.limits(Salt::H3PO4).allowed = false;
+   SaltOptimizer::Result result = optimizer.solve(target, targetpH);
+
+   QVERIFY2( result.reached, "Did not reach a profile the additions can make" );
+   QVERIFY2( fuzzyComp(result.pH, targetpH, 0.05), "Wrong mash pH" );
+   for( int i = 0; i < Water::numIons; ++i )
+      QVERIFY2( fuzzyComp(result.ppm[i], target[i], qMax(0.05 * target[i], 1.0)), "Ion out of range" );
+   QVERIFY2( result.amounts[Salt::H3PO4] == 0.0, "Used an acid that is not allowed" );
+   QVERIFY2( fuzzyComp(result.amounts[Salt::LACTIC], 0.0015, 0.0002), "Wrong amount of lactic acid" );
+
+   // Burton has more sulfate than Dublin, so nothing that adds any
+   mash = waterProfileMash(0);
+   SaltOptimizer burton(mash);
+   result = burton.solve(waterProfile(7), 0.0);
+   QVERIFY( result.amounts[Salt::CASO4] == 0.0 );
+   QVERIFY( result.amounts[Salt::MGSO4] == 0.0 );
+   QVERIFY( result.amounts[Salt::LACTIC] == 0.0 );
+   QVERIFY( ! result.reached );
+}
+
+void Testing::saltOptimizerProfilesTest()
+{
+   for( int base = 0; base < numWaterProfiles; ++base ) {
+      SaltOptimizer optimizer(waterProfileMash(base));
+
+      for( int t = 0; t < numWaterProfiles; ++t ) {
+         SaltOptimizer::Result result = optimizer.solve(waterProfile(t), 5.4);
+
+         foreach( Salt::Types type, SaltOptimizer::additions() )
+            QVERIFY2( result.amounts[type] >= 0.0, "Negative addition" );
+         for( int i = 0; i < Water::numIons; ++i )
+            QVERIFY2( result.ppm[i] >= waterProfiles[base][i] - 1e-9, "Additions took an ion out" );
+      }
+   }
+}
+
+void Testing::saltOptimizerBenchmark()
+{
+   QVector<SaltOptimizer*> optimizers;
+   QVector< QVector<double> > targets;
+   int iterations = 0;
+
+   for( int p = 0; p < numWaterProfiles; ++p ) {
+      optimizers.append( new SaltOptimizer(waterProfileMash(p)) );
+      targets.append( waterProfile(p) );
+   }
+
+   // Every base water against every target
+   QBENCHMARK {
+      foreach( SaltOptimizer* optimizer, optimizers ) {
+         foreach( QVector<double> const& target, targets )
+            iterations += optimizer->solve(target, 5.4).iterations;
+      }
+   }
+
+   qDeleteAll(optimizers);
+   QVERIFY( iterations > 0 );
+}
+
 void Testing::testLogRotation()
 {
    QCOMPARE(Log::loggingEnabled, true);
@@ -293,5 +751,6 @@ void Testing::cleanupTestCase()
 
    // Clear all persistent properties linked with this test suite.
    // It will clear all settings that are application specific, user-scoped, and in the brewtarget namespace.
-   QSettings().clear();
+   OptionsCache::instance().clear();
+   OptionsCache::destroy();
 }
\ No newline at end of file
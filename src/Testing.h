@@ -123,6 +123,38 @@ private slots:
    //! \brief Verify post-boil losses do not affect OG
    void postBoilLossOgTest();
 
+   //! \brief Verify RecipeCalc gets the all-grain numbers from a bare snapshot
+   void recipeSnapshotCalcTest();
+
+   //! \brief Verify the Plato to SG conversions agree with the secant method
+   void platoToSgTest();
+
+   //! \brief Benchmark: the Plato to SG conversions against the secant method
+   void platoToSgBenchmark_data();
+   void platoToSgBenchmark();
+
+   //! \brief Verify the batch IBU kernel agrees with the single-hop formulas
+   void ibuBatchTest();
+
+   //! \brief Benchmark: the batch IBU kernel, once per formula
+   void ibuBatchBenchmark_data();
+   void ibuBatchBenchmark();
+
+   //! \brief Verify HopOptimizer hits a target IBU within its limits
+   void hopOptimizerTest();
+
+   //! \brief Verify GristOptimizer hits a target OG and colour within its limits
+   void gristOptimizerTest();
+
+   //! \brief Verify SaltOptimizer matches a profile its additions can reach
+   void saltOptimizerTest();
+
+   //! \brief Verify SaltOptimizer keeps to its limits between every pair of a set of water profiles
+   void saltOptimizerProfilesTest();
+
+   //! \brief Benchmark: SaltOptimizer between every pair of the same profiles
+   void saltOptimizerBenchmark();
+
    //! \brief Verify Log rotation is working
    void testLogRotation();
 };
@@ -22,6 +22,8 @@
 #include <QComboBox>
 #include <QFont>
 #include <QInputDialog>
+#include <QMessageBox>
+#include <QMetaEnum>
 
 #include "WaterDialog.h"
 #include "WaterListModel.h"
@@ -41,6 +43,7 @@
 #include "mashstep.h"
 #include "salt.h"
 #include "ColorMethods.h"
+#include "SaltOptimizer.h"
 
 WaterDialog::WaterDialog(QWidget* parent) : QDialog(parent),
    m_ppm_digits( QVector<BtDigitWidget*>(Water::numIons) ),
@@ -125,6 +128,7 @@ WaterDialog::WaterDialog(QWidget* parent) : QDialog(parent),
    connect( m_salt_table_model,    &SaltTableModel::newTotals, this, &WaterDialog::newTotals);
    connect( pushButton_addSalt,    &QAbstractButton::clicked,  m_salt_table_model, &SaltTableModel::catchSalt);
    connect( pushButton_removeSalt, &QAbstractButton::clicked,  this, &WaterDialog::removeSalts);
+   connect( pushButton_solveSalts, &QAbstractButton::clicked,  this, &WaterDialog::solveSalts);
 
    connect( spinBox_mashRO, SIGNAL(valueChanged(int)),   this, SLOT(setMashRO(int)));
    connect( spinBox_spargeRO, SIGNAL(valueChanged(int)), this, SLOT(setSpargeRO(int)));
@@ -332,6 +336,70 @@ void WaterDialog::removeSalts()
    m_salt_table_model->removeSalts(deadSalts);
 }
 
+void WaterDialog::solveSalts()
+{
+   if ( ! m_rec || ! m_rec->mash() || m_base == nullptr || m_target == nullptr )
+      return;
+
+   Mash* mash = m_rec->mash();
+   double allTheWaters = mash->totalMashWater_l();
+
+   if ( qFuzzyCompare(allTheWaters,0.0) ) {
+      qWarning() << QString("Can not set strike water chemistry without a mash");
+      return;
+   }
+
+   // Same dilution as newTotals()
+   double dInfuse = m_mashRO * mash->totalInfusionAmount_l();
+   double dSparge = m_spargeRO * mash->totalSpargeAmount_l();
+   double modifier = 1.0 - (dInfuse + dSparge) / allTheWaters;
+
+   SaltOptimizer::Mash water;
+   water.water_l = allTheWaters;
+   water.thickness_LKg = m_thickness;
+   // Only the additions to the mash get replaced, so whatever goes in the
+   // sparge stays and counts towards the starting point
+   for (int i = 0; i < Water::numIons; ++i ) {
+      Water::Ions ion = static_cast<Water::Ions>(i);
+      water.ppm[i] = modifier * m_base->ppm(ion) + m_salt_table_model->totalOutsideMash(ion) / allTheWaters;
+   }
+   // Acid malt is part of the grist, so likewise
+   water.pH = calculateGristpH() + calculateSaltpH() + m_salt_table_model->pHOutsideMash(m_thickness)
+            - SaltOptimizer::acidpH(m_salt_table_model->totalAcidWeight(Salt::ACIDMLT), 0.0, m_thickness);
+
+   // 5.4 is the usual aim, and comfortably inside what btDigit_ph shows as good
+   double const targetpH = 5.4;
+   SaltOptimizer optimizer(water);
+   SaltOptimizer::Result result = optimizer.solve(m_target, targetpH);
+
+   if ( ! result.reached ) {
+      QMetaEnum ions = QMetaEnum::fromType<Water::Ions>();
+      QStringList misses;
+
+      for (int i = 0; i < Water::numIons; ++i ) {
+         double target = m_target->ppm(static_cast<Water::Ions>(i));
+         // The same bands as SaltOptimizer::Result::reached
+         if ( qAbs(result.ppm[i] - target) > qMax(0.05 * target, 1.0) )
+            misses << tr("%1: %2 ppm rather than %3").arg(ions.valueToKey(i)).arg(result.ppm[i], 0, 'f', 0).arg(target, 0, 'f', 0);
+      }
+      if ( qAbs(result.pH - targetpH) > 0.05 )
+         misses << tr("Mash pH: %1 rather than %2").arg(result.pH, 0, 'f', 2).arg(targetpH, 0, 'f', 1);
+
+      QMessageBox::StandardButton answer =
+         QMessageBox::question(this, tr("Target not reached"),
+                               tr("No mix of salts and acids gets all the way to the target profile. The closest comes to\n\n%1\n\n"
+                                  "Replace the mash additions with it anyway?").arg(misses.join("\n")),
+                               QMessageBox::Yes | QMessageBox::No, QMessageBox::No);
+      if ( answer != QMessageBox::Yes )
+         return;
+   }
+
+   foreach( Salt::Types type, SaltOptimizer::additions() ) {
+      m_salt_table_model->setMashAddition(type, result.amounts[type], optimizer.limits(type).percentAcid);
+   }
+   newTotals();
+}
+
 // All of the pH calculations are taken from the work done by Kai Troester and
 // published at
 // http://braukaiser.com/wiki/index.php/Beer_color_to_mash_pH_(v2.0)
@@ -344,10 +412,6 @@ const double mEq = 50.0;
 const double Cagpm = 40.0;
 // Mg grams per mole
 const double Mggpm = 24.30;
-// HCO3 grams per mole
-const double HCO3gpm = 61.01;
-// CO3 grams per mole
-const double CO3gpm = 60.01;
 
 // The pH of a beer with no color
 const double nosrmbeer_ph = 5.6;
@@ -402,41 +466,24 @@ double WaterDialog::calculateSaltpH()
 //! \brief Calculates the pH delta caused by any salt additions.
 double WaterDialog::calculateAddedSaltpH()
 {
-
    // We need the value from the salt table model, because we need all the
    // added salts, but not the base.
-   double ca = m_salt_table_model->total_Ca()/Cagpm * 2;
-   double mg = m_salt_table_model->total_Mg()/Mggpm * 2;
-   double hco3 = m_salt_table_model->total_HCO3()/HCO3gpm;
-   double co3 = m_salt_table_model->total_CO3()/CO3gpm;
-
-   // The 61 is another magic number from Kai. Sigh
-   // unlike previous calculations, I am getting a mass here so I do not
-   // need to convert from mg/L
-   double totalDelta = 0.0 - ca/3.5 - mg/7 + (hco3+co3)/61;
-   return totalDelta/m_thickness/mEq;
+   return SaltOptimizer::addedSaltpH(m_salt_table_model->total_Ca(),
+                                     m_salt_table_model->total_Mg(),
+                                     m_salt_table_model->total_HCO3(),
+                                     m_salt_table_model->total_CO3(),
+                                     m_thickness);
 }
 
 //! \brief Calculates the pH adjustment caused by lactic acid, H3PO4 and/or acid
 //! malts
 double WaterDialog::calculateAcidpH()
 {
-   const double H3PO4_gpm = 98;
-   const double lactic_gpm = 90;
-   double totalDelta = 0.0;
-
    double lactic_amt   = m_salt_table_model->totalAcidWeight(Salt::LACTIC);
    double acidmalt_amt = m_salt_table_model->totalAcidWeight(Salt::ACIDMLT);
    double H3PO4_amt    = m_salt_table_model->totalAcidWeight(Salt::H3PO4);
 
-   if ( lactic_amt + acidmalt_amt > 0.0 ) {
-      totalDelta += 1000 * (lactic_amt + acidmalt_amt) / lactic_gpm;
-   }
-   if ( H3PO4_amt > 0.0 ) {
-      totalDelta += 1000 * H3PO4_amt / H3PO4_gpm;
-   }
-
-   return totalDelta/mEq/m_thickness;
+   return SaltOptimizer::acidpH(lactic_amt + acidmalt_amt, H3PO4_amt, m_thickness);
 }
 
 //! \brief Calculates the theoretical distilled water mash pH. I make some
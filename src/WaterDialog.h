@@ -57,6 +57,8 @@ public slots:
    void update_targetProfile(int selected);
    void newTotals();
    void removeSalts();
+   //! \brief Replaces the salt and acid additions with the ones that come closest to the target profile
+   void solveSalts();
    void setMashRO(int val);
    void setSpargeRO(int val);
    void saveAndClose();
@@ -26,6 +26,11 @@ WaterListModel::WaterListModel(QWidget* parent)
    : QAbstractListModel(parent), m_recipe(nullptr)
 {
    connect( &(Database::instance()), &Database::newWaterSignal, this, &WaterListModel::addWater );
+   connect( &(Database::instance()), &Database::elementsAdded, this, [this](QList<Ingredient*> const& added) {
+      QList<Water*> waters = Database::elementsOfType<Water>(added);
+      if ( ! waters.isEmpty() )
+         addWaters(waters);
+   });
    connect( &(Database::instance()), SIGNAL(deletedSignal(Water*)), this, SLOT(removeWater(Water*)) );
    repopulateList();
 }
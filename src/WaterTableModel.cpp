@@ -66,6 +66,11 @@ void WaterTableModel::observeDatabase(bool val)
       observeRecipe(nullptr);
       removeAll();
       connect( &(Database::instance()), &Database::newWaterSignal, this, &WaterTableModel::addWater );
+      connect( &(Database::instance()), &Database::elementsAdded, this, [this](QList<Ingredient*> const& added) {
+         QList<Water*> waters = Database::elementsOfType<Water>(added);
+         if ( ! waters.isEmpty() )
+            addWaters(waters);
+      });
       connect( &(Database::instance()), SIGNAL(deletedSignal(Water*)), this, SLOT(removeWater(Water*)) );
       addWaters( Database::instance().waters() );
    }
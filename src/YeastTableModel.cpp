@@ -108,6 +108,11 @@ void YeastTableModel::observeDatabase(bool val)
 
       removeAll();
       connect( &(Database::instance()), &Database::newYeastSignal, this, &YeastTableModel::addYeast );
+      connect( &(Database::instance()), &Database::elementsAdded, this, [this](QList<Ingredient*> const& added) {
+         QList<Yeast*> yeasts = Database::elementsOfType<Yeast>(added);
+         if ( ! yeasts.isEmpty() )
+            addYeasts(yeasts);
+      });
       connect( &(Database::instance()), SIGNAL(deletedSignal(Yeast*)), this, SLOT(removeYeast(Yeast*)) );
       addYeasts( Database::instance().yeasts() );
    }
@@ -34,6 +34,8 @@
 #include <QFile>
 #include <QMessageBox>
 #include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
 #include <QDebug>
 #include <QPair>
 
@@ -55,7 +57,9 @@
 
 #include "TableSchema.h"
 BeerXML::BeerXML(DatabaseSchema* tables) : QObject(),
-   m_tables(tables)
+   m_tables(tables),
+   m_parsed(nullptr),
+   m_parsedNext(0)
 {
 }
 
@@ -473,6 +477,476 @@ void BeerXML::toXml( Yeast* a, QDomDocument& doc, QDomNode& parent )
    parent.appendChild(node);
 }
 
+namespace {
+   //! Runs an export on the thread pool.
+   class ExportRunner : public QRunnable
+   {
+   public:
+      ExportRunner(std::function<void()> job) : m_job(job) {}
+      void run() override { m_job(); }
+
+   private:
+      std::function<void()> m_job;
+   };
+
+   QString xmlTag( Brewtarget::DBTable table )
+   {
+      switch( table ) {
+         case Brewtarget::BREWNOTETABLE:    return QString("BREWNOTE");
+         case Brewtarget::EQUIPTABLE:       return QString("EQUIPMENT");
+         case Brewtarget::FERMTABLE:        return QString("FERMENTABLE");
+         case Brewtarget::HOPTABLE:         return QString("HOP");
+         case Brewtarget::INSTRUCTIONTABLE: return QString("INSTRUCTION");
+         case Brewtarget::MISCTABLE:        return QString("MISC");
+         case Brewtarget::STYLETABLE:       return QString("STYLE");
+         case Brewtarget::WATERTABLE:       return QString("WATER");
+         case Brewtarget::YEASTTABLE:       return QString("YEAST");
+         default:                           return QString();
+      }
+   }
+
+   //! An element that only holds other records, eg HOPS.
+   BeerXmlExport::Record container( QString const& tag )
+   {
+      BeerXmlExport::Record ret;
+      ret.tag = tag;
+      return ret;
+   }
+}
+
+QVector<BeerXmlExport::Field> const& BeerXML::xmlFields( Brewtarget::DBTable table, QMetaObject const* meta )
+{
+   QHash< int, QVector<BeerXmlExport::Field> >::const_iterator i = m_xmlFields.constFind(table);
+   if ( i != m_xmlFields.constEnd() )
+      return *i;
+
+   TableSchema* tbl = m_tables->table(table);
+   QVector<BeerXmlExport::Field> fields;
+
+   foreach (QString element, tbl->allPropertyNames()) {
+      QString tag = tbl->propertyToXml(element);
+      if ( tag.isEmpty() )
+         continue;
+
+      BeerXmlExport::Field field;
+      field.propertyIndex = meta->indexOfProperty(element.toUtf8().constData());
+      field.property = element;
+      field.tag = tag;
+      field.type = tbl->propertyColumnType(element);
+      fields.append(field);
+   }
+
+   return *m_xmlFields.insert(table, fields);
+}
+
+BeerXmlExport::Record BeerXML::exportFields( Ingredient* thing, QString const& tag )
+{
+   BeerXmlExport::Record ret;
+   QMetaObject const* meta = thing->metaObject();
+
+   ret.tag = tag;
+   ret.version = thing->version();
+   ret.fields = xmlFields(thing->table(), meta);
+   ret.values.reserve(ret.fields.size());
+   foreach( BeerXmlExport::Field const& field, ret.fields ) {
+      if ( field.propertyIndex >= 0 )
+         ret.values.append(meta->property(field.propertyIndex).read(thing));
+      else
+         ret.values.append(QVariant());
+   }
+
+   return ret;
+}
+
+BeerXmlExport::Record BeerXML::exportRecord( MashStep* a )
+{
+   BeerXmlExport::Record ret = exportFields(a, "MASH_STEP");
+
+   // flySparge and batchSparge aren't part of the BeerXML spec.
+   // This makes sure we give BeerXML something it understands.
+   for ( int i = 0; i < ret.fields.size(); ++i ) {
+      if ( ret.fields.at(i).property == PropertyNames::MashStep::type ) {
+         if ( (a->type() == MashStep::flySparge) || (a->type() == MashStep::batchSparge ) )
+            ret.values[i] = MashStep::types[0];
+         else
+            ret.values[i] = a->typeString();
+      }
+   }
+
+   return ret;
+}
+
+BeerXmlExport::Record BeerXML::exportRecord( Mash* a )
+{
+   BeerXmlExport::Record ret = exportFields(a, "MASH");
+   BeerXmlExport::Record steps = container("MASH_STEPS");
+
+   foreach( MashStep* step, a->mashSteps() )
+      steps.children.append(exportRecord(step));
+   ret.children.append(steps);
+
+   return ret;
+}
+
+BeerXmlExport::Record BeerXML::exportRecord( Recipe* a )
+{
+   BeerXmlExport::Record ret = exportFields(a, "RECIPE");
+   BeerXmlExport::Record hops = container("HOPS");
+   BeerXmlExport::Record ferms = container("FERMENTABLES");
+   BeerXmlExport::Record miscs = container("MISCS");
+   BeerXmlExport::Record yeasts = container("YEASTS");
+   BeerXmlExport::Record waters = container("WATERS");
+   BeerXmlExport::Record instructions = container("INSTRUCTIONS");
+   BeerXmlExport::Record brewNotes = container("BREWNOTES");
+
+   // Same order as toXml(Recipe*)
+   Style* style = a->style();
+   if( style != nullptr )
+      ret.children.append(exportFields(style, "STYLE"));
+
+   foreach( Hop* hop, a->hops() )
+      hops.children.append(exportFields(hop, "HOP"));
+   ret.children.append(hops);
+
+   foreach( Fermentable* ferm, a->fermentables() )
+      ferms.children.append(exportFields(ferm, "FERMENTABLE"));
+   ret.children.append(ferms);
+
+   foreach( Misc* misc, a->miscs() )
+      miscs.children.append(exportFields(misc, "MISC"));
+   ret.children.append(miscs);
+
+   foreach( Yeast* yeast, a->yeasts() )
+      yeasts.children.append(exportFields(yeast, "YEAST"));
+   ret.children.append(yeasts);
+
+   foreach( Water* water, a->waters() )
+      waters.children.append(exportFields(water, "WATER"));
+   ret.children.append(waters);
+
+   Mash* mash = a->mash();
+   if( mash != nullptr )
+      ret.children.append(exportRecord(mash));
+
+   foreach( Instruction* instruction, a->instructions() )
+      instructions.children.append(exportFields(instruction, "INSTRUCTION"));
+   ret.children.append(instructions);
+
+   foreach( BrewNote* note, a->brewNotes() )
+      brewNotes.children.append(exportFields(note, "BREWNOTE"));
+   ret.children.append(brewNotes);
+
+   Equipment* equip = a->equipment();
+   if( equip )
+      ret.children.append(exportFields(equip, "EQUIPMENT"));
+
+   return ret;
+}
+
+BeerXmlExport* BeerXML::exporter( QList<Ingredient*> const& things, QString const& fileName )
+{
+   BeerXmlExport* ret = new BeerXmlExport(fileName);
+   QList<Recipe*> recipes;
+
+   foreach( Ingredient* thing, things ) {
+      Recipe* rec = qobject_cast<Recipe*>(thing);
+      if ( rec )
+         recipes.append(rec);
+   }
+
+   // All recipes live under the RECIPES tag, whereas the equipment, hops,
+   // etc. go under DATABASE. A file only gets one of them.
+   ret->m_recipes = ! recipes.isEmpty();
+   if ( ret->m_recipes ) {
+      foreach( Recipe* rec, recipes )
+         ret->m_records.append(exportRecord(rec));
+   }
+   else {
+      foreach( Ingredient* thing, things ) {
+         QString tag = xmlTag(thing->table());
+         if ( ! tag.isEmpty() )
+            ret->m_records.append(exportFields(thing, tag));
+      }
+   }
+
+   return ret;
+}
+
+BeerXmlExport::BeerXmlExport(QString const& fileName, QObject* parent)
+   : QObject(parent),
+     m_fileName(fileName),
+     m_recipes(false)
+{
+}
+
+QString BeerXmlExport::fileName() const
+{
+   return m_fileName;
+}
+
+void BeerXmlExport::start()
+{
+   QThreadPool::globalInstance()->start(new ExportRunner([this]() { run(); }));
+}
+
+void BeerXmlExport::run()
+{
+   QFile file(m_fileName);
+   bool ok = file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+
+   if ( ! ok ) {
+      qWarning() << QString("BeerXmlExport::run Could not open %1 for writing.").arg(m_fileName);
+   }
+   else {
+      QXmlStreamWriter xml(&file);
+      int total = m_records.size();
+      int lastPercent = -1;
+
+      xml.setCodec(QTextCodec::codecForLocale());
+      xml.setAutoFormatting(true);
+      xml.setAutoFormattingIndent(1);
+
+      // The headers make other BeerXML parsers happy
+      xml.writeStartDocument();
+      xml.writeComment("BeerXML generated by brewtarget");
+      xml.writeStartElement(m_recipes ? "RECIPES" : "DATABASE");
+
+      for ( int i = 0; i < total; ++i ) {
+         writeRecord(xml, m_records.at(i));
+         // Each record is done with once it is written
+         m_records[i] = Record();
+
+         int percent = 100 * (i + 1) / total;
+         if ( percent != lastPercent ) {
+            lastPercent = percent;
+            emit progress(i + 1, total);
+         }
+      }
+
+      xml.writeEndDocument();
+      ok = ! xml.hasError();
+      file.close();
+   }
+
+   emit finished(ok);
+   deleteLater();
+}
+
+void BeerXmlExport::writeRecord(QXmlStreamWriter& xml, Record const& record)
+{
+   xml.writeStartElement(record.tag);
+
+   // This sucks. Not quite sure what to do, but hard code it
+   if ( record.version >= 0 )
+      xml.writeTextElement("VERSION", Ingredient::text(record.version));
+
+   for ( int i = 0; i < record.fields.size(); ++i ) {
+      xml.writeTextElement(record.fields.at(i).tag,
+                           BeerXML::textFromValue(record.values.at(i), record.fields.at(i).type));
+   }
+
+   foreach( Record const& child, record.children )
+      writeRecord(xml, child);
+
+   xml.writeEndElement();
+}
+
+QDomElement BeerXML::readRecord(QXmlStreamReader& xml, QDomDocument& doc)
+{
+   QDomElement root = doc.createElement(xml.name().toString());
+   QDomElement current = root;
+   doc.appendChild(root);
+
+   while( ! xml.atEnd() )
+   {
+      xml.readNext();
+
+      if ( xml.isStartElement() ) {
+         QDomElement child = doc.createElement(xml.name().toString());
+         current.appendChild(child);
+         current = child;
+      }
+      else if ( xml.isEndElement() ) {
+         if ( current == root )
+            break;
+         current = current.parentNode().toElement();
+      }
+      else if ( xml.isCharacters() && ! xml.isWhitespace() ) {
+         // Entities can split text up. fromXml() only looks at the first
+         // text child, so keep it in one piece.
+         QDomNode last = current.lastChild();
+         if ( last.isText() )
+            last.toText().appendData(xml.text().toString());
+         else
+            current.appendChild(doc.createTextNode(xml.text().toString()));
+      }
+   }
+
+   return root;
+}
+
+namespace {
+   //! The table and class a record's tag stands for, or NOTABLE.
+   Brewtarget::DBTable recordTable( QString const& tag, QMetaObject const** meta )
+   {
+      if ( tag == "RECIPE" )           { *meta = &Recipe::staticMetaObject;      return Brewtarget::RECTABLE; }
+      else if ( tag == "STYLE" )       { *meta = &Style::staticMetaObject;       return Brewtarget::STYLETABLE; }
+      else if ( tag == "EQUIPMENT" )   { *meta = &Equipment::staticMetaObject;   return Brewtarget::EQUIPTABLE; }
+      else if ( tag == "FERMENTABLE" ) { *meta = &Fermentable::staticMetaObject; return Brewtarget::FERMTABLE; }
+      else if ( tag == "HOP" )         { *meta = &Hop::staticMetaObject;         return Brewtarget::HOPTABLE; }
+      else if ( tag == "MISC" )        { *meta = &Misc::staticMetaObject;        return Brewtarget::MISCTABLE; }
+      else if ( tag == "YEAST" )       { *meta = &Yeast::staticMetaObject;       return Brewtarget::YEASTTABLE; }
+      else if ( tag == "WATER" )       { *meta = &Water::staticMetaObject;       return Brewtarget::WATERTABLE; }
+      else if ( tag == "MASH" )        { *meta = &Mash::staticMetaObject;        return Brewtarget::MASHTABLE; }
+      else if ( tag == "MASH_STEP" )   { *meta = &MashStep::staticMetaObject;    return Brewtarget::MASHSTEPTABLE; }
+      else if ( tag == "INSTRUCTION" ) { *meta = &Instruction::staticMetaObject; return Brewtarget::INSTRUCTIONTABLE; }
+      else if ( tag == "BREWNOTE" )    { *meta = &BrewNote::staticMetaObject;    return Brewtarget::BREWNOTETABLE; }
+
+      *meta = nullptr;
+      return Brewtarget::NOTABLE;
+   }
+}
+
+BeerXML::ParsedRecord BeerXML::parseRecord( QDomElement const& record ) const
+{
+   ParsedRecord ret;
+   QList<QDomElement> todo;
+
+   // Walk the whole record, parents before children, picking out the
+   // elements that become things of their own. Everything else (HOPS,
+   // MASH_STEPS, ...) is just gone through.
+   todo.append(record);
+   while( ! todo.isEmpty() )
+   {
+      QDomElement element = todo.takeFirst();
+      QList<QDomElement> children;
+      ParsedFields fields;
+      TableSchema* schema = nullptr;
+
+      Brewtarget::DBTable table = recordTable(element.tagName(), &fields.meta);
+      if ( table != Brewtarget::NOTABLE )
+         schema = m_tables->table(table);
+
+      for( QDomElement field = element.firstChildElement(); ! field.isNull(); field = field.nextSiblingElement() )
+      {
+         QDomNode child = field.firstChild();
+         if ( child.isNull() || ! child.isText() ) {
+            children.append(field);
+            continue;
+         }
+         if ( ! schema )
+            continue;
+
+         QString pTag = schema->xmlToProperty(field.tagName());
+         if ( pTag.isEmpty() )
+            continue;
+
+         // The same conversions as fromXml()
+         QDomText textNode = child.toText();
+         int index = fields.meta->indexOfProperty(pTag.toLatin1().constData());
+         QVariant value;
+         switch( index < 0 ? QVariant::Invalid : fields.meta->property(index).type() )
+         {
+            case QVariant::Bool:
+               value = Ingredient::getBool(textNode);
+               break;
+            case QVariant::Double:
+               value = Ingredient::getDouble(textNode);
+               break;
+            case QVariant::Int:
+               value = Ingredient::getInt(textNode);
+               break;
+            case QVariant::DateTime:
+               value = Ingredient::getDateTime(textNode);
+               break;
+            case QVariant::Date:
+               value = Ingredient::getDate(textNode);
+               break;
+            case QVariant::String:
+               value = Ingredient::getString(textNode);
+               break;
+            default:
+               qWarning() << QString("%1: don't understand property type. xmlTag=%2")
+                     .arg(Q_FUNC_INFO)
+                     .arg(field.tagName());
+               continue;
+         }
+         fields.values.append(qMakePair(index, value));
+      }
+
+      if ( schema ) {
+         fields.element = element;
+         ret.append(fields);
+      }
+      todo = children + todo;
+   }
+
+   return ret;
+}
+
+Ingredient* BeerXML::importRecord( QDomElement const& record, ParsedRecord const* parsed )
+{
+   QString tag = record.tagName();
+   Ingredient* ret = nullptr;
+
+   m_parsed = parsed;
+   m_parsedNext = 0;
+
+   try {
+      if ( tag == "RECIPE" )
+         ret = recipeFromXml(record);
+      else if ( tag == "EQUIPMENT" )
+         ret = equipmentFromXml(record);
+      else if ( tag == "FERMENTABLE" )
+         ret = fermentableFromXml(record);
+      else if ( tag == "HOP" )
+         ret = hopFromXml(record);
+      else if ( tag == "MISC" )
+         ret = miscFromXml(record);
+      else if ( tag == "STYLE" )
+         ret = styleFromXml(record);
+      else if ( tag == "YEAST" )
+         ret = yeastFromXml(record);
+      else if ( tag == "WATER" )
+         ret = waterFromXml(record);
+      else if ( tag == "MASHS" ) {
+         // Mashes saved on their own rather than in a recipe. Hand back the
+         // first one that did not come in right, or else the last one.
+         for( QDomElement mash = record.firstChildElement("MASH"); ! mash.isNull(); mash = mash.nextSiblingElement("MASH") ) {
+            Mash* temp = mashFromXml(mash);
+            if ( ! ret || ret->isValid() )
+               ret = temp;
+         }
+      }
+   }
+   catch (QString e) {
+      m_parsed = nullptr;
+      throw;
+   }
+
+   m_parsed = nullptr;
+   return ret;
+}
+
+BeerXML::ParsedFields const* BeerXML::findParsed( QDomNode const& node )
+{
+   if ( ! m_parsed || m_parsed->isEmpty() )
+      return nullptr;
+
+   // The *FromXml() methods mostly go through a record in the order
+   // parseRecord() did, so start looking just after the last one found.
+   int size = m_parsed->size();
+   for ( int i = 0; i < size; ++i ) {
+      int at = (m_parsedNext + i) % size;
+      if ( m_parsed->at(at).element == node ) {
+         m_parsedNext = at + 1;
+         return &m_parsed->at(at);
+      }
+   }
+
+   return nullptr;
+}
+
 // fromXml ====================================================================
 void BeerXML::fromXml(Ingredient* element, QHash<QString,QString> const& xmlTagsToProperties, QDomNode const& elementNode)
 {
@@ -558,6 +1032,20 @@ void BeerXML::fromXml(Ingredient* element, QDomNode const& elementNode)
    QDate dateVal;
    TableSchema* schema = m_tables->table( element->table() );
 
+   // If the importer has already converted this one, just set the values
+   ParsedFields const* parsed = findParsed(elementNode);
+   if ( parsed && parsed->meta == element->metaObject() ) {
+      for ( auto const& value : parsed->values ) {
+         QMetaProperty prop = parsed->meta->property(value.first);
+         prop.write(element, value.second);
+         if ( ! element->isValid() ) {
+            qCritical() << QString("%1 could not populate %2 from XML").arg(Q_FUNC_INFO).arg(prop.name());
+            return;
+         }
+      }
+      return;
+   }
+
    for( node = elementNode.firstChild(); ! node.isNull(); node = node.nextSibling() )
    {
       if( ! node.isElement() )
@@ -716,7 +1204,7 @@ Equipment* BeerXML::equipmentFromXml( QDomNode const& node, Recipe* parent )
    blockSignals(false);
 
 
-   if ( createdNew ) {
+   if( createdNew && ! db.holdNewElement(ret, "equipments") ) {
       emit db.changed( db.metaProperty("equipments"), QVariant() );
       emit db.newEquipmentSignal(ret);
    }
@@ -741,7 +1229,7 @@ Fermentable* BeerXML::fermentableFromXml( QDomNode const& node, Recipe* parent )
       if ( parent == nullptr )
       {
          // No parent means we handle the transaction
-         db.sqlDatabase().transaction();
+         db.beginTransaction();
          // Check to see if we already have a Fermentable with this name
          db.getElementsByName<Fermentable>( matching,
                Brewtarget::FERMTABLE,
@@ -791,17 +1279,17 @@ Fermentable* BeerXML::fermentableFromXml( QDomNode const& node, Recipe* parent )
    }
    catch (QString e) {
       if ( parent == nullptr ) {
-         db.sqlDatabase().rollback();
+         db.rollbackTransaction();
       }
       qCritical () << QString("%1 %2").arg(Q_FUNC_INFO).arg(e);
    }
 
    if ( parent == nullptr ) {
-      db.sqlDatabase().commit();
+      db.commitTransaction();
    }
 
    blockSignals(false);
-   if ( createdNew ) {
+   if( createdNew && ! db.holdNewElement(ret, "fermentables") ) {
       emit db.changed( db.metaProperty("fermentables"), QVariant() );
       emit db.newFermentableSignal(ret);
    }
@@ -894,7 +1382,7 @@ Hop* BeerXML::hopFromXml( QDomNode const& node, Recipe* parent )
       if( parent == nullptr )
       {
          // as always, start the transaction if no parent
-         db.sqlDatabase().transaction();
+         db.beginTransaction();
          // Check to see if there is a hop already in the DB with the same name.
          db.getElementsByName<Hop>( matching,
                Brewtarget::HOPTABLE,
@@ -974,18 +1462,18 @@ Hop* BeerXML::hopFromXml( QDomNode const& node, Recipe* parent )
       qCritical() << QString("%1 %2").arg(Q_FUNC_INFO).arg(e);
       blockSignals(false);
       if ( ! parent )
-         db.sqlDatabase().rollback();
+         db.rollbackTransaction();
 
       abort();
    }
 
    if ( ! parent ) {
-      db.sqlDatabase().commit();
+      db.commitTransaction();
    }
 
    blockSignals(false);
 
-   if( createdNew ) {
+   if( createdNew && ! db.holdNewElement(ret, "hops") ) {
       emit db.changed( db.metaProperty("hops"), QVariant() );
       emit db.newHopSignal(ret);
    }
@@ -1022,7 +1510,8 @@ Instruction* BeerXML::instructionFromXml( QDomNode const& node, Recipe* parent )
    }
 
    blockSignals(false);
-   emit db.changed( db.metaProperty("instructions"), QVariant() );
+   if ( ! db.holdNewElement(ret, "instructions") )
+      emit db.changed( db.metaProperty("instructions"), QVariant() );
    return ret;
 }
 
@@ -1058,7 +1547,7 @@ Mash* BeerXML::mashFromXml( QDomNode const& node, Recipe* parent )
 
       //Need to insert the Mash before the Mash steps to get
       //the ID for foreign key contraint in Maststep table.
-      db.sqlDatabase().transaction();
+      db.beginTransaction();
       ret->insertInDatabase();
 
       // Now, get the individual mash steps.
@@ -1083,16 +1572,18 @@ Mash* BeerXML::mashFromXml( QDomNode const& node, Recipe* parent )
    catch (QString e) {
       qCritical() << QString("%1 %2").arg(Q_FUNC_INFO).arg(e);
       blockSignals(false);
-      db.sqlDatabase().rollback();
+      db.rollbackTransaction();
       abort();
    }
 
-   db.sqlDatabase().commit();
+   db.commitTransaction();
 
    blockSignals(false);
 
-   emit db.changed( db.metaProperty("mashs"), QVariant() );
-   emit db.newMashSignal(ret);
+   if ( ! db.holdNewElement(ret, "mashs") ) {
+      emit db.changed( db.metaProperty("mashs"), QVariant() );
+      emit db.newMashSignal(ret);
+   }
    emit ret->mashStepsChanged();
 
    return ret;
@@ -1232,7 +1723,7 @@ Misc* BeerXML::miscFromXml( QDomNode const& node, Recipe* parent )
       // If we are just importing a misc by itself, need to do some dupe-checking.
       if( parent == nullptr ) {
          // Check to see if there is a hop already in the DB with the same name.
-         db.sqlDatabase().transaction();
+         db.beginTransaction();
 
          db.getElementsByName<Misc>( matching, Brewtarget::MISCTABLE, name, db.allMiscs );
 
@@ -1283,13 +1774,13 @@ Misc* BeerXML::miscFromXml( QDomNode const& node, Recipe* parent )
    catch (QString e) {
       qCritical() << QString("%1 %2").arg(Q_FUNC_INFO).arg(e);
       if ( ! parent )
-         db.sqlDatabase().rollback();
+         db.rollbackTransaction();
       blockSignals(false);
       abort();
    }
 
    blockSignals(false);
-   if( createdNew )
+   if( createdNew && ! db.holdNewElement(ret, "miscs") )
    {
       emit db.changed( db.metaProperty("miscs"), QVariant() );
       emit db.newMiscSignal(ret);
@@ -1310,7 +1801,7 @@ Recipe* BeerXML::recipeFromXml( QDomNode const& node )
    try {
 
       // This is all one long, gnarly transaction.
-      db.sqlDatabase().transaction();
+      db.beginTransaction();
 
       // Oh sweet mercy
       ret = new Recipe(name);
@@ -1402,7 +1893,7 @@ Recipe* BeerXML::recipeFromXml( QDomNode const& node )
          brewNoteFromXml(n, ret);
 
       // If we get here, commit
-      db.sqlDatabase().commit();
+      db.commitTransaction();
 
       // Recalc everything, just for grins and giggles.
       ret->recalcAll();
@@ -1410,12 +1901,13 @@ Recipe* BeerXML::recipeFromXml( QDomNode const& node )
    }
    catch (QString e) {
       qCritical() << QString("%1 %2").arg(Q_FUNC_INFO).arg(e);
-      db.sqlDatabase().rollback();
+      db.rollbackTransaction();
       blockSignals(false);
       abort();
    }
 
-   emit db.newRecipeSignal(ret);
+   if ( ! db.holdNewElement(ret, "recipes") )
+      emit db.newRecipeSignal(ret);
    return ret;
 }
 
@@ -1436,7 +1928,7 @@ Style* BeerXML::styleFromXml( QDomNode const& node, Recipe* parent )
       // If we are just importing a style by itself, need to do some dupe-checking.
       if ( parent == nullptr ) {
          // No parent means we handle the transaction
-         db.sqlDatabase().transaction();
+         db.beginTransaction();
          // Check to see if there is a style already in the DB with the same name.
          db.getElementsByName<Style>( matching, Brewtarget::STYLETABLE, name, db.allStyles );
 
@@ -1486,13 +1978,13 @@ Style* BeerXML::styleFromXml( QDomNode const& node, Recipe* parent )
    catch (QString e) {
       qCritical() << QString("%1 %2").arg(Q_FUNC_INFO).arg(e);
       if ( ! parent )
-         db.sqlDatabase().rollback();
+         db.rollbackTransaction();
       blockSignals(false);
       abort();
    }
 
    blockSignals(false);
-   if ( createdNew ) {
+   if( createdNew && ! db.holdNewElement(ret, "styles") ) {
       emit db.changed( db.metaProperty("styles"), QVariant() );
       emit db.newStyleSignal(ret);
    }
@@ -1515,7 +2007,7 @@ Water* BeerXML::waterFromXml( QDomNode const& node, Recipe* parent )
    try {
       // If we are just importing a style by itself, need to do some dupe-checking.
       if( parent == nullptr ) {
-         db.sqlDatabase().transaction();
+         db.beginTransaction();
          // Check to see if there is a hop already in the DB with the same name.
          db.getElementsByName<Water>( matching, Brewtarget::WATERTABLE, name, db.allWaters );
 
@@ -1541,13 +2033,13 @@ Water* BeerXML::waterFromXml( QDomNode const& node, Recipe* parent )
    catch (QString e) {
       qCritical() << Q_FUNC_INFO << e;
       if ( parent == nullptr )
-         db.sqlDatabase().rollback();
+         db.rollbackTransaction();
       blockSignals(false);
       abort();
    }
 
    blockSignals(false);
-   if( createdNew )
+   if( createdNew && ! db.holdNewElement(ret, "waters") )
    {
       emit db.changed( db.metaProperty("waters"), QVariant() );
       emit db.newWaterSignal(ret);
@@ -1572,7 +2064,7 @@ Yeast* BeerXML::yeastFromXml( QDomNode const& node, Recipe* parent )
       // If we are just importing a yeast by itself, need to do some dupe-checking.
       if ( parent == nullptr ) {
          // start the transaction, just in case
-         db.sqlDatabase().transaction();
+         db.beginTransaction();
          // Check to see if there is a yeast already in the DB with the same name.
          db.getElementsByName<Yeast>( matching, Brewtarget::YEASTTABLE, name, db.allYeasts );
 
@@ -1654,23 +2146,21 @@ Yeast* BeerXML::yeastFromXml( QDomNode const& node, Recipe* parent )
 
       if( parent ) {
          // we are in a transaction boundary, so tell addToRecipe not to start
-         // another
+         // another. It marks the recipe's yeasts dirty as well.
          db.addToRecipe( parent, ret, false );
-         parent->recalcOgFg();
-         parent->recalcABV_pct();
       }
    }
    catch (QString e) {
       qCritical() << Q_FUNC_INFO<< e;
       if ( ! parent )
-         db.sqlDatabase().rollback();
+         db.rollbackTransaction();
       blockSignals(false);
       throw;
    }
 
-   db.sqlDatabase().commit();
+   db.commitTransaction();
    blockSignals(false);
-   if( createdNew )
+   if( createdNew && ! db.holdNewElement(ret, "yeasts") )
    {
       emit db.changed( db.metaProperty("yeasts"), QVariant() );
       emit db.newYeastSignal(ret);
@@ -36,6 +36,9 @@ class BeerXML;
 #include <QDebug>
 #include <QRegExp>
 #include <QMap>
+#include <QVector>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
 
 #include "ingredient.h"
 #include "brewtarget.h"
@@ -55,6 +58,60 @@ class Style;
 class Water;
 class Yeast;
 
+/*!
+ * \class BeerXmlExport
+ *
+ * \brief One BeerXML export, written to its file on a worker thread.
+ *
+ * Get one from BeerXML::exporter(), connect to it and start() it. Every
+ * value it needs is read when it is made, on the calling thread, so the
+ * worker only formats and writes. It deletes itself after finished().
+ */
+class BeerXmlExport : public QObject
+{
+   Q_OBJECT
+
+   friend class BeerXML;
+public:
+   //! A property that goes to BeerXML, resolved once per table.
+   struct Field {
+      int propertyIndex;
+      QString property;
+      QString tag;
+      QString type;
+   };
+
+   //! An element to write: a record, or a container (HOPS, ...) of records.
+   struct Record {
+      QString tag;
+      int version = -1;
+      QVector<Field> fields;
+      QVector<QVariant> values;
+      QList<Record> children;
+   };
+
+   //! \brief Hands the writing to the global thread pool.
+   void start();
+   QString fileName() const;
+
+signals:
+   //! \brief \b done of the \b total top level records are written.
+   void progress(int done, int total);
+   //! \brief The export is over; \b ok says whether the file is complete.
+   void finished(bool ok);
+
+private:
+   BeerXmlExport(QString const& fileName, QObject* parent = nullptr);
+
+   //! \brief Writes the whole file. Runs on the worker.
+   void run();
+   void writeRecord(QXmlStreamWriter& xml, Record const& record);
+
+   QString m_fileName;
+   bool m_recipes;
+   QVector<Record> m_records;
+};
+
 /*!
  * \class BeerXML
  * \author Mik Firestone
@@ -67,6 +124,7 @@ class BeerXML : public QObject
    Q_OBJECT
 
    friend class Database;
+   friend class BeerXmlExport;
 public:
 
    virtual ~BeerXML() {}
@@ -84,6 +142,14 @@ public:
    void toXml( Style* a, QDomDocument& doc, QDomNode& parent );
    void toXml( Water* a, QDomDocument& doc, QDomNode& parent );
    void toXml( Yeast* a, QDomDocument& doc, QDomNode& parent );
+
+   /*!
+    * \brief Prepares an export of \b things to \b fileName.
+    *
+    * As with the old DOM export, if there are any recipes in \b things,
+    * only the recipes are written.
+    */
+   BeerXmlExport* exporter( QList<Ingredient*> const& things, QString const& fileName );
    //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 
    /*! Populates the \b element with properties. This must be a class that
@@ -108,13 +174,72 @@ public:
    Water*       waterFromXml(       QDomNode const& node, Recipe* parent = nullptr );
    Yeast*       yeastFromXml(       QDomNode const& node, Recipe* parent = nullptr );
    Recipe*      recipeFromXml(      QDomNode const& node);
+
+   /*!
+    * \brief The simple properties of one element in a record, already
+    *        converted to the types of the class they are going into.
+    */
+   struct ParsedFields {
+      QDomElement element;
+      QMetaObject const* meta;
+      //! Index of the property in \b meta, and its value
+      QVector< QPair<int,QVariant> > values;
+   };
+   //! Every element of a record that is a thing of its own (HOP, MASH_STEP, ...), parents first.
+   typedef QVector<ParsedFields> ParsedRecord;
+
+   /*!
+    * \brief Does the text conversion fromXml() would do for \b record and
+    *        everything in it, without going near the database.
+    *
+    * This is safe to call from any thread, as long as nothing else is
+    * using the document \b record belongs to at the same time.
+    */
+   ParsedRecord parseRecord( QDomElement const& record ) const;
+
+   /*!
+    * \brief Imports \b record, which has to be one of the top level things
+    *        (RECIPE, EQUIPMENT, HOP, ...) or the MASHS that mashes saved on
+    *        their own come in. Returns null if there was nothing to import.
+    *
+    * If \b parsed is given, it must have come from parseRecord(record), and
+    * its values are used rather than converting the text again.
+    */
+   Ingredient* importRecord( QDomElement const& record, ParsedRecord const* parsed = nullptr );
    //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 private:
 
    DatabaseSchema* m_tables;
 
+   //! What importRecord() was handed, while it is running
+   ParsedRecord const* m_parsed;
+   int m_parsedNext;
+
+   //! \brief The entry in m_parsed for \b node, or nullptr.
+   ParsedFields const* findParsed( QDomNode const& node );
+
    BeerXML(DatabaseSchema* tables);
-   QString textFromValue(QVariant value, QString type);
+
+   /*!
+    * \brief Reads the element \b xml is sitting on, and everything in it,
+    *        into \b doc and returns it.
+    *
+    * \b xml has to be on the StartElement. It is left on the matching
+    * EndElement. This lets the importer stream the file and still hand each
+    * record to the QDomNode based *FromXml() methods.
+    */
+   QDomElement readRecord(QXmlStreamReader& xml, QDomDocument& doc);
+   static QString textFromValue(QVariant value, QString type);
+
+   //! The exported properties of each table, in the order they are written.
+   QHash< int, QVector<BeerXmlExport::Field> > m_xmlFields;
+
+   QVector<BeerXmlExport::Field> const& xmlFields( Brewtarget::DBTable table, QMetaObject const* meta );
+   //! \brief Reads the simple properties of \b thing into a record called \b tag.
+   BeerXmlExport::Record exportFields( Ingredient* thing, QString const& tag );
+   BeerXmlExport::Record exportRecord( Recipe* a );
+   BeerXmlExport::Record exportRecord( Mash* a );
+   BeerXmlExport::Record exportRecord( MashStep* a );
    int getQualifiedHopTypeIndex(QString type, Hop* hop);
    int getQualifiedHopUseIndex(QString use, Hop* hop);
 
@@ -54,6 +54,7 @@
 #include "brewtarget.h"
 #include "config.h"
 #include "database.h"
+#include "OptionsCache.h"
 #include "Algorithms.h"
 #include "fermentable.h"
 #include "UnitSystem.h"
@@ -75,6 +76,7 @@
 #include "DiastaticPowerUnitSystem.h"
 
 #include "BtSplashScreen.h"
+#include "BatchRecalc.h"
 #include "MainWindow.h"
 #include "mash.h"
 #include "instruction.h"
@@ -522,7 +524,7 @@ bool Brewtarget::initialize(const QString &userDirectory)
    qDebug() << "Loading Database...";
    if (Database::instance().loadSuccessful())
    {
-      if ( ! QSettings().contains("converted") )
+      if ( ! hasOption("converted") )
          Database::instance().convertFromXml();
 
       return true;
@@ -610,6 +612,7 @@ void Brewtarget::cleanup()
    delete _mainWindow;
 
    Database::dropInstance();
+   OptionsCache::destroy();
 
 }
 
@@ -623,6 +626,25 @@ void Brewtarget::setInteractive(bool val)
    _isInteractive = val;
 }
 
+int Brewtarget::runRecalcAll(const QString &reportFile, int jobs, const QString &userDirectory)
+{
+   int ret = 0;
+
+   // Nobody is there to answer any questions
+   setInteractive(false);
+   if( !initialize(userDirectory) )
+   {
+      cleanup();
+      return 1;
+   }
+
+   ret = BatchRecalc::run(reportFile, jobs);
+
+   cleanup();
+
+   return ret;
+}
+
 int Brewtarget::run(const QString &userDirectory)
 {
    int ret = 0;
@@ -865,7 +887,7 @@ void Brewtarget::convertPersistentOptions()
 
 #endif
    // And remove the flag
-   QSettings().remove("hadOldConfig");
+   removeOption("hadOldConfig");
 }
 
 QString Brewtarget::getOptionValue(const QDomDocument& optionsDoc, const QString& option, bool* hasOption)
@@ -1542,7 +1564,7 @@ bool Brewtarget::hasOption(QString attribute, const QString section, iUnitOps op
    else
       name = generateName(attribute,section,ops);
 
-   return QSettings().contains(name);
+   return OptionsCache::instance().contains(name);
 }
 
 void Brewtarget::setOption(QString attribute, QVariant value, const QString section, iUnitOps ops)
@@ -1554,7 +1576,7 @@ void Brewtarget::setOption(QString attribute, QVariant value, const QString sect
    else
       name = generateName(attribute,section,ops);
 
-   QSettings().setValue(name,value);
+   OptionsCache::instance().setValue(name,value);
 }
 
 QVariant Brewtarget::option(QString attribute, QVariant default_value, QString section, iUnitOps ops)
@@ -1566,7 +1588,7 @@ QVariant Brewtarget::option(QString attribute, QVariant default_value, QString s
    else
       name = generateName(attribute,section,ops);
 
-   return QSettings().value(name,default_value);
+   return OptionsCache::instance().value(name,default_value);
 }
 
 void Brewtarget::removeOption(QString attribute, QString section)
@@ -1578,8 +1600,7 @@ void Brewtarget::removeOption(QString attribute, QString section)
    else
       name = generateName(attribute,section,NOOP);
 
-   if ( hasOption(name) )
-        QSettings().remove(name);
+   OptionsCache::instance().remove(name);
 }
 
 QString Brewtarget::generateName(QString attribute, const QString section, iUnitOps ops)
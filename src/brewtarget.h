@@ -187,6 +187,14 @@ public:
     * \return Exit code from the application.
     */
    static int run(const QString &userDirectory = QString());
+   /*!
+    * \brief Recalculates every recipe without showing any windows, and
+    *        writes the results to \b reportFile. See BatchRecalc.
+    * \param userDirectory If !isEmpty, overwrites the current settings.
+    * \param jobs How many threads to calculate on. 0 means one per core.
+    * \return Exit code from the application.
+    */
+   static int runRecalcAll(const QString &reportFile, int jobs = 0, const QString &userDirectory = QString());
 
    static double toDouble(QString text, bool* ok = nullptr);
    static double toDouble(const Ingredient* element, QString attribute, QString caller);
@@ -34,6 +34,7 @@
 #include <QIODevice>
 #include <QDomNodeList>
 #include <QDomNode>
+#include <QXmlStreamReader>
 #include <QTextStream>
 #include <QTextCodec>
 #include <QObject>
@@ -54,6 +55,13 @@
 #include <QInputDialog>
 #include <QCryptographicHash>
 #include <QPair>
+#include <QSet>
+#include <QSemaphore>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QVector>
+#include <QVersionNumber>
+#include <memory>
 
 #include "Algorithms.h"
 #include "brewnote.h"
@@ -101,11 +109,28 @@ QString Database::dbFileName;
 QFile Database::dataDbFile;
 QString Database::dataDbFileName;
 QString Database::dbConName;
+bool Database::dbWal = false;
 
 QHash< QThread*, QString > Database::_threadToConnection;
+QHash< QThread*, QString > Database::_threadToReadConnection;
 QMutex Database::_threadToConnectionMutex;
+QThreadStorage<Database::ThreadConnection*> Database::_threadConnection;
+QThreadStorage<Database::ThreadConnection*> Database::_threadReadConnection;
+QSemaphore Database::_connectionSlots( qMax(4, 2 * QThread::idealThreadCount()) );
+QAtomicInt Database::_connectionsCreated;
+QAtomicInt Database::_connectionsReused;
+QAtomicInt Database::_connectionsReleased;
+QAtomicInt Database::_connectionWaits;
+QAtomicInt Database::_connectionGeneration;
+int Database::_workerConnections = 0;
 
 Database::Database()
+   : m_statementHits(0),
+     m_statementMisses(0),
+     m_flushingWrites(false),
+     m_transactionOpen(false),
+     m_importDepth(0),
+     m_importFailed(false)
 {
    //.setUndoLimit(100);
    // Lock this here until we actually construct the first database connection.
@@ -114,6 +139,26 @@ Database::Database()
    dbDefn = new DatabaseSchema();
    m_beerxml = new BeerXML(dbDefn);
 
+   // Property writes are held for this long so that, eg, typing into a
+   // field costs one transaction rather than one per keystroke.
+   m_writeBehindTimer.setSingleShot(true);
+   m_writeBehindTimer.setInterval(500);
+   connect( &m_writeBehindTimer, &QTimer::timeout, this, [this]() {
+      try {
+         flush();
+      }
+      catch (QString e) {
+         // The writes are still queued, and go again with the next one
+         qCritical() << QString("%1 %2 writes still queued: %3")
+                        .arg(Q_FUNC_INFO).arg(m_pendingWrites.size()).arg(e);
+      }
+   });
+
+   // In WAL mode the log is folded back into the database once we have
+   // been left alone for a bit, rather than in the middle of a write.
+   m_checkpointTimer.setSingleShot(true);
+   m_checkpointTimer.setInterval(5000);
+   connect( &m_checkpointTimer, &QTimer::timeout, this, [this]() { checkpoint(); } );
 }
 
 Database::~Database()
@@ -160,6 +205,9 @@ bool Database::loadSQLite()
       if( newdb.exists() )
       {
          dbFile.remove();
+         // A log left over from the old file would be played into the new one
+         QFile::remove(QString("%1-wal").arg(dbFileName));
+         QFile::remove(QString("%1-shm").arg(dbFileName));
          newdb.copy(dbFileName);
          QFile::setPermissions( dbFileName, QFile::ReadOwner | QFile::WriteOwner | QFile::ReadGroup );
          newdb.remove();
@@ -203,15 +251,33 @@ bool Database::loadSQLite()
    }
    else
    {
-      // NOTE: synchronous=off reduces query time by an order of magnitude!
       QSqlQuery pragma(sqldb);
+      dbWal = Brewtarget::option("sqliteWal", false).toBool();
       try {
-         if ( ! pragma.exec( "PRAGMA synchronous = off" ) )
-            throw QString("could not disable synchronous writes");
+         if ( dbWal ) {
+            // Writes that survive a crash, and readers on other connections
+            // that neither wait for nor hold up the writer.
+            if ( ! pragma.exec( "PRAGMA journal_mode = WAL" ) || ! pragma.next() ||
+                 pragma.value(0).toString().compare("wal", Qt::CaseInsensitive) != 0 )
+               throw QString("could not switch to write-ahead logging");
+            if ( ! pragma.exec( "PRAGMA synchronous = NORMAL" ) )
+               throw QString("could not set synchronous writes");
+            // checkpoint() normally gets there first; this is for when we are never idle
+            if ( ! pragma.exec( "PRAGMA wal_autocheckpoint = 10000" ) )
+               throw QString("could not set the checkpoint limit");
+         }
+         else {
+            // The journal mode sticks to the file, so leave WAL explicitly
+            if ( ! pragma.exec( "PRAGMA journal_mode = DELETE" ) )
+               throw QString("could not switch to a rollback journal");
+            // NOTE: synchronous=off reduces query time by an order of magnitude!
+            if ( ! pragma.exec( "PRAGMA synchronous = off" ) )
+               throw QString("could not disable synchronous writes");
+            if ( ! pragma.exec( "PRAGMA locking_mode = EXCLUSIVE"))
+               throw QString("could not enable exclusive locks");
+         }
          if ( ! pragma.exec( "PRAGMA foreign_keys = on"))
             throw QString("could not enable foreign keys");
-         if ( ! pragma.exec( "PRAGMA locking_mode = EXCLUSIVE"))
-            throw QString("could not enable exclusive locks");
          if ( ! pragma.exec("PRAGMA temp_store = MEMORY") )
             throw QString("could not enable temporary memory");
 
@@ -375,52 +441,76 @@ bool Database::load()
 
    populateElements( allRecipes, Brewtarget::RECTABLE );
 
-   // Connect fermentable,hop changed signals to their parent recipe.
-   QHash<int,Recipe*>::iterator i;
-   QList<Fermentable*>::iterator j;
-   QList<Hop*>::iterator k;
-   QList<Yeast*>::iterator l;
-   QList<Mash*>::iterator m;
-   QList<MashStep*>::iterator n;
-
+   // Connect fermentable,hop changed signals to their parent recipe. Rather
+   // than asking the database about each recipe in turn, read every
+   // relationship table once and wire things up from the in-memory maps.
+   TableSchema* recTbl  = dbDefn->table(Brewtarget::RECTABLE);
+   TableSchema* stepTbl = dbDefn->table(Brewtarget::MASHSTEPTABLE);
+   QString recKey = recTbl->keyName(Brewtarget::dbType());
+
+   QHash< int, QList<int> > recEquips = relationMap(Brewtarget::RECTABLE, recKey, recTbl->foreignKeyToColumn(kpropEquipmentId));
+   QHash< int, QList<int> > recMashs  = relationMap(Brewtarget::RECTABLE, recKey, recTbl->foreignKeyToColumn(kpropMashId));
+
+   // These stay around after load, and are what fermentables(Recipe*) and
+   // friends answer from.
+   buildRecipeIndex( m_recipeFermentables, Brewtarget::FERMINRECTABLE, allFermentables );
+   buildRecipeIndex( m_recipeHops, Brewtarget::HOPINRECTABLE, allHops );
+   buildRecipeIndex( m_recipeMiscs, Brewtarget::MISCINRECTABLE, allMiscs );
+   buildRecipeIndex( m_recipeYeasts, Brewtarget::YEASTINRECTABLE, allYeasts );
+   buildRecipeIndex( m_recipeWaters, Brewtarget::WATERINRECTABLE, allWaters );
+   buildRecipeIndex( m_recipeSalts, Brewtarget::SALTINRECTABLE, allSalts );
+
+   // mash_id -> mash steps, skipping the deleted ones
+   QString stepFilter = QString("%1 = %2")
+         .arg(stepTbl->propertyToColumn(PropertyNames::Ingredient::deleted))
+         .arg(Brewtarget::dbFalse());
+   QHash< int, QList<int> > mashSteps = relationMap(Brewtarget::MASHSTEPTABLE,
+                                                    stepTbl->foreignKeyToColumn(),
+                                                    stepTbl->keyName(Brewtarget::dbType()),
+                                                    stepFilter);
 
-   for( i = allRecipes.begin(); i != allRecipes.end(); i++ )
+   for( QHash<int,Recipe*>::const_iterator i = allRecipes.constBegin(); i != allRecipes.constEnd(); ++i )
    {
-      Equipment* e = equipment(*i);
-      if( e )
-      {
-         connect( e, &Ingredient::changed, *i, &Recipe::acceptEquipChange );
-         connect( e, &Equipment::changedBoilSize_l, *i, &Recipe::setBoilSize_l);
-         connect( e, &Equipment::changedBoilTime_min, *i, &Recipe::setBoilTime_min);
+      Recipe* rec = i.value();
+
+      foreach( int key, recEquips.value(i.key()) ) {
+         Equipment* e = allEquipments.value(key);
+         if( e ) {
+            connect( e, &Ingredient::changed, rec, &Recipe::acceptEquipChange );
+            connect( e, &Equipment::changedBoilSize_l, rec, &Recipe::setBoilSize_l);
+            connect( e, &Equipment::changedBoilTime_min, rec, &Recipe::setBoilTime_min);
+         }
       }
 
-      QList<Fermentable*> tmpF = fermentables(*i);
-      for( j = tmpF.begin(); j != tmpF.end(); ++j ) {
-         connect( *j, SIGNAL(changed(QMetaProperty,QVariant)), *i, SLOT(acceptFermChange(QMetaProperty,QVariant)) );
+      foreach( Fermentable* f, m_recipeFermentables.value(i.key()) ) {
+         connect( f, SIGNAL(changed(QMetaProperty,QVariant)), rec, SLOT(acceptFermChange(QMetaProperty,QVariant)) );
       }
 
-      QList<Hop*> tmpH = hops(*i);
-      for( k = tmpH.begin(); k != tmpH.end(); ++k ) {
-         connect( *k, SIGNAL(changed(QMetaProperty,QVariant)), *i, SLOT(acceptHopChange(QMetaProperty,QVariant)) );
+      foreach( Hop* h, m_recipeHops.value(i.key()) ) {
+         connect( h, SIGNAL(changed(QMetaProperty,QVariant)), rec, SLOT(acceptHopChange(QMetaProperty,QVariant)) );
       }
 
-      QList<Yeast*> tmpY = yeasts(*i);
-      for( l = tmpY.begin(); l != tmpY.end(); ++l ) {
-         connect( *l, SIGNAL(changed(QMetaProperty,QVariant)), *i, SLOT(acceptYeastChange(QMetaProperty,QVariant)) );
+      foreach( Yeast* y, m_recipeYeasts.value(i.key()) ) {
+         connect( y, SIGNAL(changed(QMetaProperty,QVariant)), rec, SLOT(acceptYeastChange(QMetaProperty,QVariant)) );
       }
 
       // a recipe may not have a mash. Can't connect what doesn't exist
-      if ( mash(*i) != nullptr ) {
-         connect( mash(*i), SIGNAL(changed(QMetaProperty,QVariant)), *i, SLOT(acceptMashChange(QMetaProperty,QVariant)) );
+      foreach( int key, recMashs.value(i.key()) ) {
+         Mash* m = allMashs.value(key);
+         if( m )
+            connect( m, SIGNAL(changed(QMetaProperty,QVariant)), rec, SLOT(acceptMashChange(QMetaProperty,QVariant)) );
       }
    }
 
-   QList<Mash*> tmpM = mashs();
-   for( m = tmpM.begin(); m != tmpM.end(); ++m )
+   for( QHash<int,Mash*>::const_iterator m = allMashs.constBegin(); m != allMashs.constEnd(); ++m )
    {
-      QList<MashStep*> tmpMS = mashSteps(*m);
-      for( n=tmpMS.begin(); n != tmpMS.end(); ++n) {
-         connect( *n, SIGNAL(changed(QMetaProperty,QVariant)), *m, SLOT(acceptMashStepChange(QMetaProperty,QVariant)) );
+      if( m.value()->deleted() )
+         continue;
+
+      foreach( int key, mashSteps.value(m.key()) ) {
+         MashStep* ms = allMashSteps.value(key);
+         if( ms )
+            connect( ms, SIGNAL(changed(QMetaProperty,QVariant)), m.value(), SLOT(acceptMashStepChange(QMetaProperty,QVariant)) );
       }
    }
 
@@ -506,14 +596,40 @@ QSqlDatabase Database::sqlDatabase()
    //http://www.linuxjournal.com/article/9602
 
    QThread* t = QThread::currentThread();
+   bool worker = dbInstance && t != dbInstance->thread();
    QSqlDatabase sqldb;
 
+   if ( worker && _threadConnection.hasLocalData() ) {
+      if ( _threadConnection.localData()->generation == _connectionGeneration.loadAcquire() ) {
+         _connectionsReused.fetchAndAddRelaxed(1);
+         return _threadConnection.localData()->db;
+      }
+      // unload() has closed it since, so let go of what is left
+      _threadConnection.setLocalData(nullptr);
+   }
+   else if ( dbInstance ) {
+      // Nearly every call comes from here, so don't make it queue for the mutex
+      if ( dbInstance->m_ownerConnection.isValid() ) {
+         _connectionsReused.fetchAndAddRelaxed(1);
+         return dbInstance->m_ownerConnection;
+      }
+   }
+
+   // Wait for a slot before the mutex, which whoever gives one back needs
+   if ( worker )
+      acquireConnectionSlot();
+
    _threadToConnectionMutex.lock();
    // If this thread already has a connection, return it.
    if( _threadToConnection.contains(t) )
    {
       QSqlDatabase ret = QSqlDatabase::database(_threadToConnection[t]);
+      if ( dbInstance && ! worker )
+         dbInstance->m_ownerConnection = ret;
       _threadToConnectionMutex.unlock();
+      if ( worker )
+         _connectionSlots.release();
+      _connectionsReused.fetchAndAddRelaxed(1);
       return ret;
    }
    // Create a unique connection name, just containing the addy of the thread.
@@ -521,39 +637,159 @@ QSqlDatabase Database::sqlDatabase()
 
    // Create the new connection.
    try {
-      if ( Brewtarget::dbType() == Brewtarget::PGSQL ) {
-         sqldb = QSqlDatabase::addDatabase("QPSQL",conName);
-
-         sqldb.setHostName( dbHostname );
-         sqldb.setDatabaseName( dbName );
-         sqldb.setUserName( dbUsername );
-         sqldb.setPort( dbPortnum );
-         sqldb.setPassword( dbPassword );
-
-         if( ! sqldb.open() )
-            throw QString("Could not open %1 for reading.\n%2")
-            .arg(dbHostname).arg(sqldb.lastError().text());
-      }
-      else {
-         sqldb = QSqlDatabase::addDatabase("QSQLITE",conName);
-         sqldb.setDatabaseName(dbFileName);
-         if( ! sqldb.open() )
-            throw QString("Could not open %1 for reading.\n%2")
-            .arg(dbFileName).arg(sqldb.lastError().text());
-      }
+      sqldb = openConnection(conName, false);
    }
    catch (QString e) {
       qCritical() << QString("%1 %2").arg(Q_FUNC_INFO).arg(e);
       _threadToConnectionMutex.unlock();
+      if ( worker )
+         _connectionSlots.release();
       throw;
    }
 
    // Put new connection in the hash.
    _threadToConnection.insert(t,conName);
+   if ( worker ) {
+      ++_workerConnections;
+      _threadConnection.setLocalData(new ThreadConnection(conName, false, sqldb));
+   }
+   else if ( dbInstance ) {
+      dbInstance->m_ownerConnection = sqldb;
+   }
    _threadToConnectionMutex.unlock();
+   _connectionsCreated.fetchAndAddRelaxed(1);
+   return sqldb;
+}
+
+QSqlDatabase Database::readOnlyDatabase()
+{
+   QThread* t = QThread::currentThread();
+
+   // Anything but WAL won't let a second connection read past our writer
+   if ( ! dbWal || Brewtarget::dbType() != Brewtarget::SQLITE || ! dbInstance || t == dbInstance->thread() )
+      return sqlDatabase();
+
+   if ( _threadReadConnection.hasLocalData() ) {
+      if ( _threadReadConnection.localData()->generation == _connectionGeneration.loadAcquire() ) {
+         _connectionsReused.fetchAndAddRelaxed(1);
+         return _threadReadConnection.localData()->db;
+      }
+      _threadReadConnection.setLocalData(nullptr);
+   }
+
+   acquireConnectionSlot();
+
+   QMutexLocker locker(&_threadToConnectionMutex);
+   QString conName = QString("ro_0x%1").arg(reinterpret_cast<uintptr_t>(t), 0, 16);
+   QSqlDatabase sqldb;
+   try {
+      sqldb = openConnection(conName, true);
+   }
+   catch (QString e) {
+      qCritical() << QString("%1 %2").arg(Q_FUNC_INFO).arg(e);
+      _connectionSlots.release();
+      throw;
+   }
+
+   _threadToReadConnection.insert(t,conName);
+   ++_workerConnections;
+   _threadReadConnection.setLocalData(new ThreadConnection(conName, true, sqldb));
+   _connectionsCreated.fetchAndAddRelaxed(1);
+   return sqldb;
+}
+
+QSqlDatabase Database::openConnection( QString const& conName, bool readOnly )
+{
+   QSqlDatabase sqldb;
+
+   if ( Brewtarget::dbType() == Brewtarget::PGSQL ) {
+      sqldb = QSqlDatabase::addDatabase("QPSQL",conName);
+
+      sqldb.setHostName( dbHostname );
+      sqldb.setDatabaseName( dbName );
+      sqldb.setUserName( dbUsername );
+      sqldb.setPort( dbPortnum );
+      sqldb.setPassword( dbPassword );
+
+      if( ! sqldb.open() ) {
+         QString e = QString("Could not open %1 for reading.\n%2").arg(dbHostname).arg(sqldb.lastError().text());
+         sqldb = QSqlDatabase();
+         QSqlDatabase::removeDatabase(conName);
+         throw e;
+      }
+   }
+   else {
+      sqldb = QSqlDatabase::addDatabase("QSQLITE",conName);
+      sqldb.setDatabaseName(dbFileName);
+      if ( readOnly )
+         sqldb.setConnectOptions("QSQLITE_OPEN_READONLY");
+      if( ! sqldb.open() ) {
+         QString e = QString("Could not open %1 for reading.\n%2").arg(dbFileName).arg(sqldb.lastError().text());
+         sqldb = QSqlDatabase();
+         QSqlDatabase::removeDatabase(conName);
+         throw e;
+      }
+   }
+
    return sqldb;
 }
 
+void Database::acquireConnectionSlot()
+{
+   if ( _connectionSlots.tryAcquire() )
+      return;
+
+   _connectionWaits.fetchAndAddRelaxed(1);
+   qDebug() << QString("%1 all %2 worker connections are in use, waiting").arg(Q_FUNC_INFO).arg(_workerConnections);
+   if ( ! _connectionSlots.tryAcquire(1, 30000) )
+      throw QString("%1 timed out waiting for a database connection").arg(Q_FUNC_INFO);
+}
+
+Database::ThreadConnection::ThreadConnection(QString const& name, bool readOnly, QSqlDatabase const& db)
+   : name(name), readOnly(readOnly), db(db), generation(_connectionGeneration.loadAcquire())
+{
+}
+
+Database::ThreadConnection::~ThreadConnection()
+{
+   // No handles may be left when the connection is removed, and that
+   // includes the statements prepared on it
+   db = QSqlDatabase();
+   if ( dbInstance ) {
+      QMutexLocker statements(&dbInstance->m_statementsMutex);
+      dbInstance->m_statements.remove(name);
+   }
+
+   QMutexLocker locker(&_threadToConnectionMutex);
+   QHash< QThread*, QString >& connections = readOnly ? _threadToReadConnection : _threadToConnection;
+
+   // unload() may have closed it already
+   QThread* t = connections.key(name, nullptr);
+   if ( t == nullptr )
+      return;
+
+   connections.remove(t);
+   QSqlDatabase::database( name, false ).close();
+   QSqlDatabase::removeDatabase( name );
+
+   --_workerConnections;
+   _connectionSlots.release();
+   _connectionsReleased.fetchAndAddRelaxed(1);
+}
+
+Database::ConnectionStats Database::connectionStats()
+{
+   ConnectionStats ret;
+   ret.created  = _connectionsCreated.loadAcquire();
+   ret.reused   = _connectionsReused.loadAcquire();
+   ret.released = _connectionsReleased.loadAcquire();
+   ret.waits    = _connectionWaits.loadAcquire();
+
+   QMutexLocker locker(&_threadToConnectionMutex);
+   ret.open = _threadToConnection.size() + _threadToReadConnection.size();
+   return ret;
+}
+
 
 template <class T> void Database::populateElements( QHash<int,T*>& hash, Brewtarget::DBTable table )
 {
@@ -576,14 +812,218 @@ template <class T> void Database::populateElements( QHash<int,T*>& hash, Brewtar
    while( q.next() ) {
       int key = q.record().value(tbl->keyName(Brewtarget::dbType())).toInt();
 
-      T* e = new T(table, key, q.record());
+      // A startup merge may already have put this one in
       if( ! hash.contains(key) )
-         hash.insert(key, e);
+         hash.insert(key, new T(table, key, q.record()));
+   }
+
+   q.finish();
+}
+
+template <class T> void Database::populateNewElements( QHash<int,T*>& hash, Brewtarget::DBTable table,
+                                                       int lastKey, char const* listProperty )
+{
+   QSqlQuery q(sqlDatabase());
+   TableSchema* tbl = dbDefn->table(table);
+   QString keyName = tbl->keyName(Brewtarget::dbType());
+   q.setForwardOnly(true);
+   q.prepare( QString("SELECT * FROM %1 WHERE %2 > :key ORDER BY %2").arg(tbl->tableName()).arg(keyName) );
+   q.bindValue(":key", lastKey);
+
+   try {
+      if ( ! q.exec() )
+         throw QString("%1 %2").arg(q.lastQuery()).arg(q.lastError().text());
+   }
+   catch (QString e) {
+      qCritical() << QString("%1 %2").arg(Q_FUNC_INFO).arg(e);
+      q.finish();
+      throw;
+   }
+
+   while( q.next() ) {
+      int key = q.record().value(keyName).toInt();
+      if ( hash.contains(key) )
+         continue;
+
+      T* e = new T(table, key, q.record());
+      hash.insert(key, e);
+      // This is only ever called inside an import session, which announces
+      // everything at once when it ends.
+      holdNewElement(e, listProperty);
+   }
+
+   q.finish();
+}
+
+
+QHash< int, QList<int> > Database::relationMap( Brewtarget::DBTable table,
+                                                QString const& parentCol,
+                                                QString const& childCol,
+                                                QString const& filter )
+{
+   QHash< int, QList<int> > ret;
+   readBarrier(table);
+
+   QSqlQuery q(sqlDatabase());
+   TableSchema* tbl = dbDefn->table(table);
+   q.setForwardOnly(true);
+
+   QString queryString = QString("SELECT %1, %2 FROM %3")
+         .arg(parentCol)
+         .arg(childCol)
+         .arg(tbl->tableName());
+   if( ! filter.isEmpty() )
+      queryString += QString(" WHERE %1").arg(filter);
+
+   try {
+      if ( ! q.exec(queryString) )
+         throw QString("could not execute query: %1 : %2").arg(queryString).arg(q.lastError().text());
+   }
+   catch (QString e) {
+      qCritical() << QString("%1 %2").arg(Q_FUNC_INFO).arg(e);
+      q.finish();
+      throw;
+   }
+
+   while( q.next() ) {
+      // NULL foreign keys (eg, a recipe without equipment) come back as 0
+      int child = q.value(1).toInt();
+      if ( child > 0 )
+         ret[q.value(0).toInt()].append(child);
    }
 
    q.finish();
+   return ret;
+}
+
+
+template <class T> void Database::buildRecipeIndex( QHash< int, QList<T*> >& index,
+                                                    Brewtarget::DBTable inrecTable,
+                                                    QHash<int,T*> const& allElements )
+{
+   TableSchema* inrec = dbDefn->table(inrecTable);
+   QHash< int, QList<int> > keys = relationMap(inrecTable, inrec->recipeIndexName(), inrec->inRecIndexName());
+
+   index.clear();
+   for( QHash< int, QList<int> >::const_iterator i = keys.constBegin(); i != keys.constEnd(); ++i ) {
+      QList<T*>& children = index[i.key()];
+      foreach( int key, i.value() ) {
+         T* e = allElements.value(key);
+         if( e )
+            children.append(e);
+      }
+   }
+}
+
+void Database::indexInRecipe( Brewtarget::DBTable inrecTable, int recKey, Ingredient* ing )
+{
+   // Instructions are ordered by the database, so they are not indexed
+   switch( inrecTable ) {
+      case Brewtarget::FERMINRECTABLE:  m_recipeFermentables[recKey].append(static_cast<Fermentable*>(ing)); break;
+      case Brewtarget::HOPINRECTABLE:   m_recipeHops[recKey].append(static_cast<Hop*>(ing)); break;
+      case Brewtarget::MISCINRECTABLE:  m_recipeMiscs[recKey].append(static_cast<Misc*>(ing)); break;
+      case Brewtarget::YEASTINRECTABLE: m_recipeYeasts[recKey].append(static_cast<Yeast*>(ing)); break;
+      case Brewtarget::WATERINRECTABLE: m_recipeWaters[recKey].append(static_cast<Water*>(ing)); break;
+      case Brewtarget::SALTINRECTABLE:  m_recipeSalts[recKey].append(static_cast<Salt*>(ing)); break;
+      default: break;
+   }
+}
+
+void Database::unindexInRecipe( Brewtarget::DBTable inrecTable, int recKey, Ingredient* ing )
+{
+   switch( inrecTable ) {
+      case Brewtarget::FERMINRECTABLE:  m_recipeFermentables[recKey].removeAll(static_cast<Fermentable*>(ing)); break;
+      case Brewtarget::HOPINRECTABLE:   m_recipeHops[recKey].removeAll(static_cast<Hop*>(ing)); break;
+      case Brewtarget::MISCINRECTABLE:  m_recipeMiscs[recKey].removeAll(static_cast<Misc*>(ing)); break;
+      case Brewtarget::YEASTINRECTABLE: m_recipeYeasts[recKey].removeAll(static_cast<Yeast*>(ing)); break;
+      case Brewtarget::WATERINRECTABLE: m_recipeWaters[recKey].removeAll(static_cast<Water*>(ing)); break;
+      case Brewtarget::SALTINRECTABLE:  m_recipeSalts[recKey].removeAll(static_cast<Salt*>(ing)); break;
+      default: break;
+   }
+}
+
+QString Database::nameIndexKey( QString const& name )
+{
+   return name.trimmed().toCaseFolded();
+}
+
+QList<int> Database::keysByName( Brewtarget::DBTable table, QString const& name )
+{
+   QMap< Brewtarget::DBTable, NameIndex >::const_iterator i = m_nameIndex.constFind(table);
+
+   if ( i == m_nameIndex.constEnd() ) {
+      TableSchema* tbl = dbDefn->table(table);
+      QString deletedCol = tbl->propertyToColumn(PropertyNames::Ingredient::deleted);
+      QString queryString = QString("SELECT %1, %2 FROM %3")
+                               .arg(tbl->keyName(Brewtarget::dbType()))
+                               .arg(tbl->propertyToColumn(PropertyNames::Ingredient::name))
+                               .arg(tbl->tableName());
+      if ( ! deletedCol.isEmpty() )
+         queryString += QString(" WHERE %1 = %2").arg(deletedCol).arg(Brewtarget::dbFalse());
+      queryString += QString(" ORDER BY %1").arg(tbl->keyName(Brewtarget::dbType()));
+
+      // Whatever is still in the write-behind queue has to be read back too
+      readBarrier(table);
+
+      QSqlQuery q(sqlDatabase());
+      q.setForwardOnly(true);
+      try {
+         if ( ! q.exec(queryString) )
+            throw QString("could not execute query: %1 : %2").arg(queryString).arg(q.lastError().text());
+      }
+      catch (QString e) {
+         qCritical() << Q_FUNC_INFO << e;
+         q.finish();
+         throw;
+      }
+
+      NameIndex& index = m_nameIndex[table];
+      while ( q.next() ) {
+         int key = q.value(0).toInt();
+         QString normalised = nameIndexKey(q.value(1).toString());
+         index.keys[normalised].append(key);
+         index.names.insert(key, normalised);
+      }
+      q.finish();
+
+      i = m_nameIndex.constFind(table);
+   }
+
+   return i->keys.value(nameIndexKey(name));
+}
+
+void Database::indexName( Brewtarget::DBTable table, int key, QString const& name )
+{
+   // A table nobody has looked in yet gets read in full when somebody does
+   if ( ! m_nameIndex.contains(table) )
+      return;
+
+   unindexName(table, key);
+
+   NameIndex& index = m_nameIndex[table];
+   QString normalised = nameIndexKey(name);
+   index.keys[normalised].append(key);
+   index.names.insert(key, normalised);
 }
 
+void Database::unindexName( Brewtarget::DBTable table, int key )
+{
+   QMap< Brewtarget::DBTable, NameIndex >::iterator i = m_nameIndex.find(table);
+   if ( i == m_nameIndex.end() )
+      return;
+
+   QHash< int, QString >::iterator name = i->names.find(key);
+   if ( name == i->names.end() )
+      return;
+
+   QHash< QString, QList<int> >::iterator keys = i->keys.find(*name);
+   if ( keys != i->keys.end() ) {
+      keys->removeAll(key);
+      if ( keys->isEmpty() )
+         i->keys.erase(keys);
+   }
+   i->names.erase(name);
+}
 
 template <class T> bool Database::getElements(QList<T*>& list,
                                               QString filter,
@@ -591,6 +1031,8 @@ template <class T> bool Database::getElements(QList<T*>& list,
                                               QHash<int,T*> allElements,
                                               QString id)
 {
+   readBarrier(table);
+
    QSqlQuery q(sqlDatabase());
    TableSchema* tbl = dbDefn->table( table );
    q.setForwardOnly(true);
@@ -633,16 +1075,46 @@ template <class T> bool Database::getElements(QList<T*>& list,
 
 void Database::unload()
 {
-   // selectSome saves context. If we close the database before we tear that
-   // context down, core gets dumped
-   selectSome.clear();
+   try {
+      flush();
+   }
+   catch (QString e) {
+      qCritical() << QString("%1 could not write pending changes: %2").arg(Q_FUNC_INFO).arg(e);
+   }
 
-   // so far, it seems we only create one connection to the db. This is
-   // likely overkill
-   foreach( QString conName, _threadToConnection.values() ) {
+   // The cached statements save context. If we close the database before we
+   // tear that context down, core gets dumped
+   qDebug() << QString("%1 statement cache: %2 hits, %3 misses")
+               .arg(Q_FUNC_INFO).arg(statementCacheHits()).arg(statementCacheMisses());
+   m_statementsMutex.lock();
+   m_statements.clear();
+   m_statementsMutex.unlock();
+
+   m_checkpointTimer.stop();
+
+   ConnectionStats stats = connectionStats();
+   qDebug() << QString("%1 connections: %2 created, %3 reused, %4 released, %5 waits, %6 open")
+               .arg(Q_FUNC_INFO).arg(stats.created).arg(stats.reused).arg(stats.released)
+               .arg(stats.waits).arg(stats.open);
+
+   // Worker threads still holding a connection will find it gone when they
+   // finish, so their slots are given back here.
+   m_ownerConnection = QSqlDatabase();
+   _threadToConnectionMutex.lock();
+   foreach( QString conName, _threadToConnection.values() + _threadToReadConnection.values() ) {
+      // A worker may have prepared something since the cache was cleared
+      m_statementsMutex.lock();
+      m_statements.remove(conName);
+      m_statementsMutex.unlock();
       QSqlDatabase::database( conName, false ).close();
       QSqlDatabase::removeDatabase( conName );
    }
+   _threadToConnection.clear();
+   _threadToReadConnection.clear();
+   _connectionSlots.release(_workerConnections);
+   _workerConnections = 0;
+   _connectionGeneration.fetchAndAddOrdered(1);
+   _threadToConnectionMutex.unlock();
 
    if (loadWasSuccessful && Brewtarget::dbType() == Brewtarget::SQLITE )
    {
@@ -781,7 +1253,9 @@ char const * Database::getDefaultBackupFileName()
 bool Database::backupToFile(QString newDbFileName)
 {
    // Make sure the singleton exists - otherwise there's nothing to backup.
-   instance();
+   // And that the file we are about to copy is up to date.
+   instance().flush();
+   instance().checkpoint(true);
 
    bool success = true;
 
@@ -840,6 +1314,8 @@ int Database::getParentIngredientKey(Ingredient const & ingredient) {
    if (parentToChildTableId != Brewtarget::NOTABLE) {
       TableSchema * parentToChildTable = this->dbDefn->table(parentToChildTableId);
 
+      readBarrier(parentToChildTableId);
+
       QString findParentIngredient =
          QString("SELECT %1 FROM %2 WHERE %3=%4").arg(parentToChildTable->parentIndexName())
                                                  .arg(parentToChildTable->tableName())
@@ -871,6 +1347,8 @@ bool Database::isStored(Ingredient const & ingredient) {
 
    TableSchema * table = this->dbDefn->table(this->dbDefn->classNameToTable(meta->className()));
 
+   readBarrier(table->dbTable());
+
    QString idColumnName = table->keyName(Brewtarget::dbType());
 
    QString queryString = QString("SELECT %1 AS id FROM %2 WHERE %3=%4").arg(idColumnName)
@@ -912,7 +1390,7 @@ Ingredient * Database::removeIngredientFromRecipe( Recipe* rec, Ingredient* ing
    int ndx = meta->indexOfClassInfo("signal");
    QString propName;
 
-   sqlDatabase().transaction();
+   beginTransaction();
    QSqlQuery q(sqlDatabase());
 
    qDebug() << QString("%1 Deleting Ingredient %2 #%3").arg(Q_FUNC_INFO).arg(meta->className()).arg(ing->_key);
@@ -968,6 +1446,8 @@ Ingredient * Database::removeIngredientFromRecipe( Recipe* rec, Ingredient* ing
       if ( ! q.exec( deleteIngredient ) )
          throw QString("failed to delete ingredient.");
 
+      unindexInRecipe( inrec->dbTable(), rec->_key, ing );
+      unindexName( table->dbTable(), ing->_key );
    }
    catch ( QString e ) {
       qCritical() << QString("%1 %2 %3 %4")
@@ -975,13 +1455,19 @@ Ingredient * Database::removeIngredientFromRecipe( Recipe* rec, Ingredient* ing
                            .arg(e)
                            .arg(q.lastQuery())
                            .arg(q.lastError().text());
-      sqlDatabase().rollback();
+      rollbackTransaction();
       q.finish();
       abort();
    }
 
-   rec->recalcAll();
-   sqlDatabase().commit();
+   switch( inrec->dbTable() ) {
+      case Brewtarget::FERMINRECTABLE:  rec->markDirty(Recipe::InputFermentables); break;
+      case Brewtarget::HOPINRECTABLE:   rec->markDirty(Recipe::InputHops); break;
+      case Brewtarget::YEASTINRECTABLE: rec->markDirty(Recipe::InputYeasts); break;
+      // Nothing else feeds the calculations
+      default: break;
+   }
+   commitTransaction();
 
    q.finish();
    emit rec->changed( rec->metaProperty(propName), QVariant() );
@@ -1034,6 +1520,8 @@ Recipe* Database::getParentRecipe( BrewNote const* note )
            .arg( tbl->keyName() )
            .arg(note->_key);
 
+   readBarrier(Brewtarget::BREWNOTETABLE);
+
    QSqlQuery q(sqlDatabase());
 
    try {
@@ -1168,7 +1656,7 @@ void Database::insertInstruction(Instruction* in, int pos)
                    .arg(in->_key);
    QString update;
 
-   sqlDatabase().transaction();
+   beginTransaction();
 
    QSqlQuery q(sqlDatabase());
 
@@ -1236,11 +1724,11 @@ void Database::insertInstruction(Instruction* in, int pos)
                            .arg(q.lastQuery())
                            .arg(q.lastError().text());
       q.finish();
-      sqlDatabase().rollback();
+      rollbackTransaction();
       throw;
    }
 
-   sqlDatabase().commit();
+   commitTransaction();
    q.finish();
 
    emit in->changed( in->metaProperty("instructionNumber"), pos );
@@ -1265,36 +1753,17 @@ QList<BrewNote*> Database::brewNotes(Recipe const* parent)
 
 QList<Fermentable*> Database::fermentables(Recipe const* parent)
 {
-   QList<Fermentable*> ret;
-   TableSchema* inrec = dbDefn->table(Brewtarget::FERMINRECTABLE);
-   // recipe_id = [parent->key]
-   QString filter = QString("%1 = %2").arg(inrec->recipeIndexName()).arg(parent->_key);
-
-   getElements(ret,filter, Brewtarget::FERMINRECTABLE, allFermentables, inrec->inRecIndexName());
-
-   return ret;
+   return m_recipeFermentables.value(parent->_key);
 }
 
 QList<Hop*> Database::hops(Recipe const* parent)
 {
-   QList<Hop*> ret;
-   TableSchema* inrec = dbDefn->table(Brewtarget::HOPINRECTABLE);
-   QString filter = QString("%1 = %2").arg(inrec->recipeIndexName()).arg(parent->_key);
-
-   getElements(ret,filter, Brewtarget::HOPINRECTABLE, allHops, inrec->inRecIndexName());
-
-   return ret;
+   return m_recipeHops.value(parent->_key);
 }
 
 QList<Misc*> Database::miscs(Recipe const* parent)
 {
-   QList<Misc*> ret;
-   TableSchema* inrec = dbDefn->table(Brewtarget::MISCINRECTABLE);
-   QString filter = QString("%1 = %2").arg(inrec->recipeIndexName()).arg(parent->_key);
-
-   getElements(ret,filter, Brewtarget::MISCINRECTABLE, allMiscs, inrec->inRecIndexName());
-
-   return ret;
+   return m_recipeMiscs.value(parent->_key);
 }
 
 Equipment* Database::equipment(Recipe const* parent)
@@ -1373,35 +1842,17 @@ QList<Instruction*> Database::instructions( Recipe const* parent )
 
 QList<Water*> Database::waters(Recipe const* parent)
 {
-   QList<Water*> ret;
-   TableSchema* inrec = dbDefn->table(Brewtarget::WATERINRECTABLE);
-   QString filter = QString("%1 = %2").arg(inrec->recipeIndexName()).arg(parent->_key);
-
-   getElements(ret,filter,Brewtarget::WATERINRECTABLE,allWaters,inrec->inRecIndexName());
-
-   return ret;
+   return m_recipeWaters.value(parent->_key);
 }
 
 QList<Salt*> Database::salts(Recipe const* parent)
 {
-   QList<Salt*> ret;
-   TableSchema* inrec = dbDefn->table(Brewtarget::SALTINRECTABLE);
-   QString filter = QString("%1 = %2").arg(inrec->recipeIndexName()).arg(parent->_key);
-
-   getElements(ret,filter,Brewtarget::SALTINRECTABLE,allSalts,inrec->inRecIndexName());
-
-   return ret;
+   return m_recipeSalts.value(parent->_key);
 }
 
 QList<Yeast*> Database::yeasts(Recipe const* parent)
 {
-   QList<Yeast*> ret;
-   TableSchema* inrec = dbDefn->table(Brewtarget::YEASTINRECTABLE);
-   QString filter = QString("%1 = %2").arg(inrec->recipeIndexName()).arg(parent->_key);
-
-   getElements(ret,filter,Brewtarget::YEASTINRECTABLE,allYeasts,inrec->inRecIndexName());
-
-   return ret;
+   return m_recipeYeasts.value(parent->_key);
 }
 
 // Named constructors =========================================================
@@ -1411,8 +1862,10 @@ BrewNote* Database::newBrewNote(BrewNote* other, bool signal)
    BrewNote* tmp = copy<BrewNote>(other, &allBrewNotes);
 
    if ( tmp && signal ) {
-      emit changed( metaProperty("brewNotes"), QVariant() );
-      emit newBrewNoteSignal(tmp);
+      if ( ! holdNewElement(tmp, "brewNotes") ) {
+         emit changed( metaProperty("brewNotes"), QVariant() );
+         emit newBrewNoteSignal(tmp);
+      }
    }
 
    return tmp;
@@ -1422,7 +1875,7 @@ BrewNote* Database::newBrewNote(Recipe* parent, bool signal)
 {
    BrewNote* tmp;
 
-   sqlDatabase().transaction();
+   beginTransaction();
 
    try {
       tmp = newIngredient(&allBrewNotes);
@@ -1435,16 +1888,18 @@ BrewNote* Database::newBrewNote(Recipe* parent, bool signal)
    }
    catch (QString e) {
       qCritical() << QString("%1 %2").arg(Q_FUNC_INFO).arg(e);
-      sqlDatabase().rollback();
+      rollbackTransaction();
       throw;
    }
 
-   sqlDatabase().commit();
+   commitTransaction();
    tmp->setDisplay(true);
    if ( signal )
    {
-      emit changed( metaProperty("brewNotes"), QVariant() );
-      emit newBrewNoteSignal(tmp);
+      if ( ! holdNewElement(tmp, "brewNotes") ) {
+         emit changed( metaProperty("brewNotes"), QVariant() );
+         emit newBrewNoteSignal(tmp);
+      }
    }
 
    return tmp;
@@ -1460,8 +1915,10 @@ Equipment* Database::newEquipment(Equipment* other)
       tmp = newIngredient(&allEquipments);
 
    if ( tmp ) {
-      emit changed( metaProperty("equipments"), QVariant() );
-      emit newEquipmentSignal(tmp);
+      if ( ! holdNewElement(tmp, "equipments") ) {
+         emit changed( metaProperty("equipments"), QVariant() );
+         emit newEquipmentSignal(tmp);
+      }
    }
    else {
       qCritical() << QString("%1 couldn't copy %2").arg(Q_FUNC_INFO).arg(other->name());
@@ -1483,7 +1940,7 @@ Fermentable* Database::newFermentable(Fermentable* other)
       else {
          // new ingredients don't. this gets ugly fast, because we are now
          // writing to two tables and need some transactional protection
-         sqlDatabase().transaction();
+         beginTransaction();
          transact = true;
          tmp = newIngredient(&allFermentables);
          int invkey = newInventory( dbDefn->table(Brewtarget::FERMTABLE));
@@ -1492,16 +1949,18 @@ Fermentable* Database::newFermentable(Fermentable* other)
    }
    catch (QString e) {
       qCritical() << QString("%1 %2").arg(Q_FUNC_INFO).arg(e);
-      if ( transact ) sqlDatabase().rollback();
+      if ( transact ) rollbackTransaction();
       throw;
    }
 
    if ( transact ) {
-      sqlDatabase().commit();
+      commitTransaction();
    }
    if ( tmp ) {
-      emit changed( metaProperty("fermentables"), QVariant() );
-      emit newFermentableSignal(tmp);
+      if ( ! holdNewElement(tmp, "fermentables") ) {
+         emit changed( metaProperty("fermentables"), QVariant() );
+         emit newFermentableSignal(tmp);
+      }
    }
    else {
       qCritical() << QString("%1 couldn't copy %2").arg(Q_FUNC_INFO).arg(other->name());
@@ -1520,7 +1979,7 @@ Hop* Database::newHop(Hop* other)
          tmp = copy(other, &allHops);
       }
       else {
-         sqlDatabase().transaction();
+         beginTransaction();
          transact = true;
          tmp = newIngredient(&allHops);
          int invkey = newInventory( dbDefn->table(Brewtarget::HOPTABLE));
@@ -1529,17 +1988,19 @@ Hop* Database::newHop(Hop* other)
    }
    catch (QString e) {
       qCritical() << QString("%1 %2").arg(Q_FUNC_INFO).arg(e);
-      if ( transact ) sqlDatabase().rollback();
+      if ( transact ) rollbackTransaction();
       throw;
    }
 
    if ( transact ) {
-      sqlDatabase().commit();
+      commitTransaction();
    }
 
    if ( tmp ) {
-      emit changed( metaProperty("hops"), QVariant() );
-      emit newHopSignal(tmp);
+      if ( ! holdNewElement(tmp, "hops") ) {
+         emit changed( metaProperty("hops"), QVariant() );
+         emit newHopSignal(tmp);
+      }
    }
    else {
       qCritical() << QString("%1 could not %2 hop")
@@ -1554,7 +2015,7 @@ Instruction* Database::newInstruction(Recipe* rec)
 {
    Instruction* tmp;
 
-   sqlDatabase().transaction();
+   beginTransaction();
 
    try {
       tmp = newIngredient(&allInstructions);
@@ -1565,12 +2026,12 @@ Instruction* Database::newInstruction(Recipe* rec)
    }
    catch ( QString e ) {
       qCritical() << QString("%1 %2").arg( Q_FUNC_INFO ).arg(e);
-      sqlDatabase().rollback();
+      rollbackTransaction();
       throw;
    }
 
    // Database's instructions have changed.
-   sqlDatabase().commit();
+   commitTransaction();
    emit changed( metaProperty("instructions"), QVariant() );
 
    return tmp;
@@ -1588,6 +2049,7 @@ int Database::instructionNumber(Instruction const* in)
          .arg(tbl->inRecIndexName())
          .arg(in->key());
 
+   readBarrier(Brewtarget::INSTINRECTABLE);
    QSqlQuery q(query,sqlDatabase());
 
    if( q.next() )
@@ -1602,7 +2064,7 @@ Mash* Database::newMash(Mash* other, bool displace)
 
    try {
       if ( other ) {
-         sqlDatabase().transaction();
+         beginTransaction();
          tmp = copy<Mash>(other, &allMashs);
       }
       else {
@@ -1626,16 +2088,18 @@ Mash* Database::newMash(Mash* other, bool displace)
    }
    catch (QString e) {
       if ( other )
-         sqlDatabase().rollback();
+         rollbackTransaction();
       throw;
    }
 
    if ( other ) {
-      sqlDatabase().commit();
+      commitTransaction();
    }
 
-   emit changed( metaProperty("mashs"), QVariant() );
-   emit newMashSignal(tmp);
+   if ( ! holdNewElement(tmp, "mashs") ) {
+      emit changed( metaProperty("mashs"), QVariant() );
+      emit newMashSignal(tmp);
+   }
 
    return tmp;
 }
@@ -1645,7 +2109,7 @@ Mash* Database::newMash(Recipe* parent, bool transact)
    Mash* tmp;
 
    if ( transact ) {
-      sqlDatabase().transaction();
+      beginTransaction();
    }
 
    try {
@@ -1660,16 +2124,18 @@ Mash* Database::newMash(Recipe* parent, bool transact)
    catch (QString e) {
       qCritical() << QString("%1 %2").arg(Q_FUNC_INFO).arg(e);
       if ( transact )
-         sqlDatabase().rollback();
+         rollbackTransaction();
       throw;
    }
 
    if ( transact ) {
-      sqlDatabase().commit();
+      commitTransaction();
    }
 
-   emit changed( metaProperty("mashs"), QVariant() );
-   emit newMashSignal(tmp);
+   if ( ! holdNewElement(tmp, "mashs") ) {
+      emit changed( metaProperty("mashs"), QVariant() );
+      emit newMashSignal(tmp);
+   }
 
    connect( tmp, SIGNAL(changed(QMetaProperty,QVariant)), parent, SLOT(acceptMashChange(QMetaProperty,QVariant)) );
    return tmp;
@@ -1694,7 +2160,7 @@ MashStep* Database::newMashStep(Mash* mash, bool connected)
                         .arg(tbl->foreignKeyToColumn())
                         .arg(mash->_key);
 
-   sqlDatabase().transaction();
+   beginTransaction();
 
    QSqlQuery q(sqlDatabase());
    q.setForwardOnly(true);
@@ -1719,11 +2185,11 @@ MashStep* Database::newMashStep(Mash* mash, bool connected)
    }
    catch (QString e) {
       qCritical() << QString("%1 %2").arg(Q_FUNC_INFO).arg(e);
-      sqlDatabase().rollback();
+      rollbackTransaction();
       throw;
    }
 
-   sqlDatabase().commit();
+   commitTransaction();
 
    if ( connected )
       connect( tmp, SIGNAL(changed(QMetaProperty,QVariant)), mash, SLOT(acceptMashStepChange(QMetaProperty,QVariant)) );
@@ -1743,7 +2209,7 @@ Misc* Database::newMisc(Misc* other)
         tmp = copy(other, &allMiscs);
       }
       else {
-         sqlDatabase().transaction();
+         beginTransaction();
          transact = true;
          tmp = newIngredient(&allMiscs);
          int invkey = newInventory( dbDefn->table(Brewtarget::MISCTABLE));
@@ -1752,17 +2218,19 @@ Misc* Database::newMisc(Misc* other)
    }
    catch (QString e) {
       qCritical() << QString("%1 %2").arg(Q_FUNC_INFO).arg(e);
-      if ( transact ) sqlDatabase().rollback();
+      if ( transact ) rollbackTransaction();
       throw;
    }
 
    if ( transact ) {
-      sqlDatabase().commit();
+      commitTransaction();
    }
 
    if ( tmp ) {
-      emit changed( metaProperty("miscs"), QVariant() );
-      emit newMiscSignal(tmp);
+      if ( ! holdNewElement(tmp, "miscs") ) {
+         emit changed( metaProperty("miscs"), QVariant() );
+         emit newMiscSignal(tmp);
+      }
    }
    else {
       qCritical() << QString("%1 could not %2 misc")
@@ -1777,7 +2245,7 @@ Recipe* Database::newRecipe(QString name)
 {
    Recipe* tmp;
 
-   sqlDatabase().transaction();
+   beginTransaction();
 
    try {
       tmp = newIngredient(name,&allRecipes);
@@ -1786,7 +2254,7 @@ Recipe* Database::newRecipe(QString name)
    }
    catch (QString e ) {
       qCritical() << QString("%1 %2").arg(Q_FUNC_INFO).arg(e);
-      sqlDatabase().rollback();
+      rollbackTransaction();
       throw;
    }
 
@@ -1802,9 +2270,11 @@ Recipe* Database::newRecipe(QString name)
       throw;
    }
 
-   sqlDatabase().commit();
-   emit changed( metaProperty("recipes"), QVariant() );
-   emit newRecipeSignal(tmp);
+   commitTransaction();
+   if ( ! holdNewElement(tmp, "recipes") ) {
+      emit changed( metaProperty("recipes"), QVariant() );
+      emit newRecipeSignal(tmp);
+   }
 
    return tmp;
 }
@@ -1813,7 +2283,7 @@ Recipe* Database::newRecipe(Recipe* other)
 {
    Recipe* tmp;
 
-   sqlDatabase().transaction();
+   beginTransaction();
    try {
       tmp = copy<Recipe>(other, &allRecipes);
 
@@ -1833,13 +2303,15 @@ Recipe* Database::newRecipe(Recipe* other)
    }
    catch (QString e) {
       qCritical() << QString("%1 %2").arg(Q_FUNC_INFO).arg(e);
-      sqlDatabase().rollback();
+      rollbackTransaction();
       throw;
    }
 
-   sqlDatabase().commit();
-   emit changed( metaProperty("recipes"), QVariant() );
-   emit newRecipeSignal(tmp);
+   commitTransaction();
+   if ( ! holdNewElement(tmp, "recipes") ) {
+      emit changed( metaProperty("recipes"), QVariant() );
+      emit newRecipeSignal(tmp);
+   }
 
    return tmp;
 }
@@ -1853,12 +2325,14 @@ Style* Database::newStyle(Style* other)
    }
    catch (QString e) {
       qCritical() << QString("%1 %2").arg(Q_FUNC_INFO).arg(e);
-      sqlDatabase().rollback();
+      rollbackTransaction();
       throw;
    }
 
-   emit changed( metaProperty("styles"), QVariant() );
-   emit newStyleSignal(tmp);
+   if ( ! holdNewElement(tmp, "styles") ) {
+      emit changed( metaProperty("styles"), QVariant() );
+      emit newStyleSignal(tmp);
+   }
 
    return tmp;
 }
@@ -1872,7 +2346,7 @@ Style* Database::newStyle(QString name)
    }
    catch (QString e) {
       qCritical() << QString("%1 %2").arg(Q_FUNC_INFO).arg(e);
-      sqlDatabase().rollback();
+      rollbackTransaction();
       throw;
    }
 
@@ -1889,8 +2363,10 @@ Style* Database::newStyle(QString name)
       throw;
    }
 
-   emit changed( metaProperty("styles"), QVariant() );
-   emit newStyleSignal(tmp);
+   if ( ! holdNewElement(tmp, "styles") ) {
+      emit changed( metaProperty("styles"), QVariant() );
+      emit newStyleSignal(tmp);
+   }
 
    return tmp;
 }
@@ -1907,12 +2383,14 @@ Water* Database::newWater(Water* other)
    }
    catch (QString e) {
       qCritical() << QString("%1 %2").arg(Q_FUNC_INFO).arg(e);
-      sqlDatabase().rollback();
+      rollbackTransaction();
       throw;
    }
 
-   emit changed( metaProperty("waters"), QVariant() );
-   emit newWaterSignal(tmp);
+   if ( ! holdNewElement(tmp, "waters") ) {
+      emit changed( metaProperty("waters"), QVariant() );
+      emit newWaterSignal(tmp);
+   }
 
    return tmp;
 }
@@ -1929,12 +2407,14 @@ Salt* Database::newSalt(Salt* other)
    }
    catch (QString e) {
       qCritical() << QString("%1 %2").arg(Q_FUNC_INFO).arg(e);
-      sqlDatabase().rollback();
+      rollbackTransaction();
       throw;
    }
 
-   emit changed( metaProperty("salts"), QVariant() );
-   emit newSaltSignal(tmp);
+   if ( ! holdNewElement(tmp, "salts") ) {
+      emit changed( metaProperty("salts"), QVariant() );
+      emit newSaltSignal(tmp);
+   }
 
    return tmp;
 }
@@ -1949,7 +2429,7 @@ Yeast* Database::newYeast(Yeast* other)
          tmp = copy(other, &allYeasts);
       }
       else {
-         sqlDatabase().transaction();
+         beginTransaction();
          transact = true;
          tmp = newIngredient(&allYeasts);
          int invkey = newInventory( dbDefn->table(Brewtarget::YEASTTABLE));
@@ -1958,15 +2438,17 @@ Yeast* Database::newYeast(Yeast* other)
    }
    catch (QString e) {
       qCritical() << QString("%1 %2").arg(Q_FUNC_INFO).arg(e);
-      sqlDatabase().rollback();
+      rollbackTransaction();
       throw;
    }
 
    if ( transact ) {
-      sqlDatabase().commit();
+      commitTransaction();
+   }
+   if ( ! holdNewElement(tmp, "yeasts") ) {
+      emit changed( metaProperty("yeasts"), QVariant() );
+      emit newYeastSignal(tmp);
    }
-   emit changed( metaProperty("yeasts"), QVariant() );
-   emit newYeastSignal(tmp);
 
    return tmp;
 }
@@ -1979,15 +2461,15 @@ int Database::insertElement(Ingredient* ins)
    }
 
    int key;
-   QSqlQuery q( sqlDatabase() );
 
    TableSchema* schema = dbDefn->table(ins->table());
-   QString insertQ = schema->generateInsertProperties(Brewtarget::dbType());
    QStringList allProps = schema->allPropertyNames(Brewtarget::dbType());
 
-   ///qDebug() << Q_FUNC_INFO << "SQL:" << insertQ;
+   QSqlQuery q = preparedStatement( InsertProperties, schema, QString(), [schema]() {
+      return schema->generateInsertProperties(Brewtarget::dbType());
+   });
+   QString insertQ = q.lastQuery();
    qDebug() << QString("%1 SQL: %2").arg(Q_FUNC_INFO).arg(insertQ);
-   q.prepare(insertQ);
 
    QString sqlParameters;
    QTextStream sqlParametersConcat(&sqlParameters);
@@ -2013,11 +2495,14 @@ int Database::insertElement(Ingredient* ins)
       q.finish();
    }
    catch (QString e) {
-      sqlDatabase().rollback();
+      rollbackTransaction();
       qCritical() << QString("%1 %2 %3").arg(Q_FUNC_INFO).arg(e).arg( q.lastError().text());
       abort();
    }
    ins->_key = key;
+   if ( ! ins->deleted() )
+      indexName( ins->table(), key, ins->name() );
+   noteImportInsert(ins);
 
    return key;
 
@@ -2033,8 +2518,10 @@ int Database::insertStyle(Style* ins)
 
    allStyles.insert(key,ins);
 
-   emit changed( metaProperty("styles"), QVariant() );
-   emit newStyleSignal(ins);
+   if ( ! holdNewElement(ins, "styles") ) {
+      emit changed( metaProperty("styles"), QVariant() );
+      emit newStyleSignal(ins);
+   }
 
    return key;
 }
@@ -2045,8 +2532,10 @@ int Database::insertEquipment(Equipment* ins)
    ins->setCacheOnly(false);
 
    allEquipments.insert(key,ins);
-   emit changed( metaProperty("equipments"), QVariant() );
-   emit newEquipmentSignal(ins);
+   if ( ! holdNewElement(ins, "equipments") ) {
+      emit changed( metaProperty("equipments"), QVariant() );
+      emit newEquipmentSignal(ins);
+   }
 
    return key;
 }
@@ -2054,7 +2543,7 @@ int Database::insertEquipment(Equipment* ins)
 int Database::insertFermentable(Fermentable* ins)
 {
    int key;
-   sqlDatabase().transaction();
+   beginTransaction();
 
    try {
       key = insertElement(ins);
@@ -2069,17 +2558,19 @@ int Database::insertFermentable(Fermentable* ins)
       throw;
    }
 
-   sqlDatabase().commit();
+   commitTransaction();
    allFermentables.insert(key,ins);
-   emit changed( metaProperty("fermentables"), QVariant() );
-   emit newFermentableSignal(ins);
+   if ( ! holdNewElement(ins, "fermentables") ) {
+      emit changed( metaProperty("fermentables"), QVariant() );
+      emit newFermentableSignal(ins);
+   }
    return key;
 }
 
 int Database::insertHop(Hop* ins)
 {
    int key;
-   sqlDatabase().transaction();
+   beginTransaction();
 
    try {
       key = insertElement(ins);
@@ -2092,18 +2583,20 @@ int Database::insertHop(Hop* ins)
       throw;
    }
 
-   sqlDatabase().commit();
+   commitTransaction();
    allHops.insert(key,ins);
-   emit changed( metaProperty("hops"), QVariant() );
-   emit newHopSignal(ins);
-
+   if ( ! holdNewElement(ins, "hops") ) {
+      emit changed( metaProperty("hops"), QVariant() );
+      emit newHopSignal(ins);
+   }
+
    return key;
 }
 
 int Database::insertInstruction(Instruction* ins, Recipe* parent)
 {
    int key;
-   sqlDatabase().transaction();
+   beginTransaction();
 
    try {
       key = insertElement(ins);
@@ -2114,11 +2607,11 @@ int Database::insertInstruction(Instruction* ins, Recipe* parent)
    }
    catch (QString e) {
       qCritical() << QString("%1 %2").arg(Q_FUNC_INFO).arg(e);
-      sqlDatabase().rollback();
+      rollbackTransaction();
       throw;
    }
 
-   sqlDatabase().commit();
+   commitTransaction();
 
    allInstructions.insert(key,ins);
    emit changed( metaProperty("instructions"), QVariant() );
@@ -2132,8 +2625,10 @@ int Database::insertMash(Mash* ins)
    ins->setCacheOnly(false);
 
    allMashs.insert(key,ins);
-   emit changed( metaProperty("mashs"), QVariant() );
-   emit newMashSignal(ins);
+   if ( ! holdNewElement(ins, "mashs") ) {
+      emit changed( metaProperty("mashs"), QVariant() );
+      emit newMashSignal(ins);
+   }
 
    return key;
 }
@@ -2153,7 +2648,7 @@ int Database::insertMashStep(MashStep* ins, Mash* parent)
                         .arg(parent->_key);
    int key;
 
-   sqlDatabase().transaction();
+   beginTransaction();
    try {
       // we need to insert the mashstep into the db first to get the key
       key = insertElement(ins);
@@ -2173,11 +2668,11 @@ int Database::insertMashStep(MashStep* ins, Mash* parent)
    }
    catch (QString e) {
       qCritical() << QString("%1 %2").arg(Q_FUNC_INFO).arg(e);
-      sqlDatabase().rollback();
+      rollbackTransaction();
       throw;
    }
 
-   sqlDatabase().commit();
+   commitTransaction();
 
    allMashSteps.insert(key,ins);
    connect( ins, SIGNAL(changed(QMetaProperty,QVariant)), parent,
@@ -2192,7 +2687,7 @@ int Database::insertMashStep(MashStep* ins, Mash* parent)
 int Database::insertMisc(Misc* ins)
 {
    int key;
-   sqlDatabase().transaction();
+   beginTransaction();
 
    try {
       key = insertElement(ins);
@@ -2206,10 +2701,12 @@ int Database::insertMisc(Misc* ins)
       throw;
    }
 
-   sqlDatabase().commit();
+   commitTransaction();
    allMiscs.insert(key,ins);
-   emit changed( metaProperty("miscs"), QVariant() );
-   emit newMiscSignal(ins);
+   if ( ! holdNewElement(ins, "miscs") ) {
+      emit changed( metaProperty("miscs"), QVariant() );
+      emit newMiscSignal(ins);
+   }
 
    return key;
 }
@@ -2220,8 +2717,10 @@ int Database::insertRecipe(Recipe* ins)
    ins->setCacheOnly(false);
 
    allRecipes.insert(key,ins);
-   emit changed( metaProperty("recipes"), QVariant() );
-   emit newRecipeSignal(ins);
+   if ( ! holdNewElement(ins, "recipes") ) {
+      emit changed( metaProperty("recipes"), QVariant() );
+      emit newRecipeSignal(ins);
+   }
 
    return key;
 }
@@ -2229,7 +2728,7 @@ int Database::insertRecipe(Recipe* ins)
 int Database::insertYeast(Yeast* ins)
 {
    int key;
-   sqlDatabase().transaction();
+   beginTransaction();
 
    try {
       key = insertElement(ins);
@@ -2242,10 +2741,12 @@ int Database::insertYeast(Yeast* ins)
       throw;
    }
 
-   sqlDatabase().commit();
+   commitTransaction();
    allYeasts.insert(key,ins);
-   emit changed( metaProperty("yeasts"), QVariant() );
-   emit newYeastSignal(ins);
+   if ( ! holdNewElement(ins, "yeasts") ) {
+      emit changed( metaProperty("yeasts"), QVariant() );
+      emit newYeastSignal(ins);
+   }
 
    return key;
 }
@@ -2256,8 +2757,10 @@ int Database::insertWater(Water* ins)
    ins->setCacheOnly(false);
 
    allWaters.insert(key,ins);
-   emit changed( metaProperty("waters"), QVariant() );
-   emit newWaterSignal(ins);
+   if ( ! holdNewElement(ins, "waters") ) {
+      emit changed( metaProperty("waters"), QVariant() );
+      emit newWaterSignal(ins);
+   }
 
    return key;
 }
@@ -2268,8 +2771,10 @@ int Database::insertSalt(Salt* ins)
    ins->setCacheOnly(false);
 
    allSalts.insert(key,ins);
-   emit changed( metaProperty("salts"), QVariant() );
-   emit newSaltSignal(ins);
+   if ( ! holdNewElement(ins, "salts") ) {
+      emit changed( metaProperty("salts"), QVariant() );
+      emit newSaltSignal(ins);
+   }
 
    return key;
 }
@@ -2279,7 +2784,7 @@ int Database::insertBrewNote(BrewNote* ins, Recipe* parent)
 {
    int key;
    TableSchema* tbl = dbDefn->table(Brewtarget::BREWNOTETABLE);
-   sqlDatabase().transaction();
+   beginTransaction();
 
    try {
       key = insertElement(ins);
@@ -2292,15 +2797,17 @@ int Database::insertBrewNote(BrewNote* ins, Recipe* parent)
    }
    catch (QString e) {
       qCritical() << QString("%1 %2").arg(Q_FUNC_INFO).arg(e);
-      sqlDatabase().rollback();
+      rollbackTransaction();
       throw;
    }
 
-   sqlDatabase().commit();
+   commitTransaction();
 
    allBrewNotes.insert(key,ins);
-   emit changed( metaProperty("brewNotes"), QVariant() );
-   emit newBrewNoteSignal(ins);
+   if ( ! holdNewElement(ins, "brewNotes") ) {
+      emit changed( metaProperty("brewNotes"), QVariant() );
+      emit newBrewNoteSignal(ins);
+   }
 
    return key;
 }
@@ -2348,7 +2855,7 @@ template<class T> T* Database::addIngredientToRecipe(
 
    // TRANSACTION BEGIN, but only if requested. Yeah. Had to go there.
    if ( transact ) {
-      sqlDatabase().transaction();
+      beginTransaction();
    }
 
    // Queries have to be created inside transactional boundaries
@@ -2424,6 +2931,7 @@ template<class T> T* Database::addIngredientToRecipe(
       if ( ! q.exec() ) {
          throw QString("%2 : %1.").arg(q.lastQuery()).arg(q.lastError().text());
       }
+      indexInRecipe( inrec->dbTable(), rec->_key, newIng );
 
       emit rec->changed( rec->metaProperty(propName), QVariant() );
 
@@ -2475,13 +2983,15 @@ template<class T> T* Database::addIngredientToRecipe(
    catch (QString e) {
       qCritical() << QString("%1 %2").arg(QString("Q_FUNC_INFO")).arg(e);
       q.finish();
+      if ( newIng )
+         unindexInRecipe( inrec->dbTable(), rec->_key, newIng );
       if ( transact )
-         sqlDatabase().rollback();
+         rollbackTransaction();
       throw;
    }
    q.finish();
    if ( transact )
-      sqlDatabase().commit();
+      commitTransaction();
 
    return newIng;
 }
@@ -2494,20 +3004,14 @@ template<class T> T* Database::addIngredientToRecipe(
 void Database::duplicateMashSteps(Mash *oldMash, Mash *newMash)
 {
    QList<MashStep*> tmpMS = mashSteps(oldMash);
-   QList<MashStep*>::iterator ms;
+   TableSchema* tbl = dbDefn->table(Brewtarget::MASHSTEPTABLE);
+   QVariantMap inNewMash;
+   inNewMash.insert( tbl->foreignKeyToColumn(), newMash->key() );
 
    try {
-      for( ms=tmpMS.begin(); ms != tmpMS.end(); ++ms)
+      // Copy the old mash steps straight into the new mash.
+      foreach( MashStep* newStep, copyAll<MashStep>(tmpMS, &allMashSteps, true, inNewMash) )
       {
-         // Copy the old mash step.
-         MashStep* newStep = copy<MashStep>(*ms,&allMashSteps);
-         TableSchema* tbl = dbDefn->table(Brewtarget::MASHSTEPTABLE);
-
-         // Put it in the new mash.
-         sqlUpdate( Brewtarget::MASHSTEPTABLE,
-                      QString("%1=%2").arg(tbl->foreignKeyToColumn()).arg(newMash->key()),
-                      QString("%1=%2").arg(tbl->keyName()).arg(newStep->key())
-                  );
          // Make the new mash pay attention to the new step.
          connect( newStep, &Ingredient::changed,
                   newMash, &Mash::acceptMashStepChange );
@@ -2539,6 +3043,7 @@ int Database::getInventoryId(TableSchema* tbl, int key )
          .arg(tbl->keyName())
          .arg(key);
 
+   readBarrier(tbl->dbTable());
    QSqlQuery q( query, sqlDatabase());
    q.first();
 
@@ -2572,24 +3077,24 @@ void Database::setInventory(Ingredient* ins, QVariant value, int invKey, bool no
    }
 
    try {
-      QSqlQuery update( sqlDatabase() );
-      // update hop_in_inventory set amount = [value] where hop_in_inventory.id = [invKey]
-      QString command = QString("UPDATE %1 set %2=%3 where %4=%5")
-                           .arg(inv->tableName())
-                           .arg(inv->propertyToColumn(kpropInventory))
-                           .arg(value.toString())
-                           .arg(inv->keyName())
-                           .arg(invKey);
-
+      // update hop_in_inventory set amount = :value where hop_in_inventory.id = :id
+      QSqlQuery update = preparedStatement( UpdateInventory, inv, QString(), [inv]() {
+         return QString("UPDATE %1 set %2=:value where %3=:id")
+                   .arg(inv->tableName())
+                   .arg(inv->propertyToColumn(kpropInventory))
+                   .arg(inv->keyName());
+      });
+      update.bindValue(":value", value);
+      update.bindValue(":id", invKey);
 
-      if ( ! update.exec(command) )
+      if ( ! update.exec() )
          throw QString("Could not update %1.%2 to %3: %4 %5")
                   .arg(inv->tableName())
                   .arg(inv->propertyToColumn(kpropInventory))
                   .arg( value.toString() )
                   .arg( update.lastQuery() )
                   .arg( update.lastError().text() );
-
+      update.finish();
    }
    catch (QString e) {
       qCritical() << QString("%1 %2").arg(Q_FUNC_INFO).arg(e);
@@ -2604,75 +3109,264 @@ void Database::setInventory(Ingredient* ins, QVariant value, int invKey, bool no
 
 void Database::updateEntry( Ingredient* object, QString propName, QVariant value, bool notify, bool transact )
 {
-   TableSchema* schema =dbDefn->table( object->table() );
-   int idx = object->metaObject()->indexOfProperty(propName.toUtf8().data());
-   QMetaProperty mProp = object->metaObject()->property(idx);
-   QString colName = schema->propertyToColumn(propName);
+   updateEntry( object, propName.toUtf8().constData(), value, notify, transact );
+}
 
-   if ( colName.isEmpty() ) {
-      colName = schema->foreignKeyToColumn(propName);
+Database::ResolvedColumn Database::resolveColumn( TableSchema* schema, QMetaObject const* meta, char const* propName )
+{
+   ResolvedColumn ret;
+   ret.metaIndex = meta->indexOfProperty(propName);
+
+   // The common case is an array lookup. Anything that isn't a Q_PROPERTY
+   // still has to be found by name.
+   ret.prop = schema->metaProperty(meta, ret.metaIndex);
+   if ( ! ret.prop ) {
+      ret.prop = schema->property(propName);
+   }
+   if ( ! ret.prop ) {
+      ret.prop = schema->foreignKey(propName);
    }
 
-   if ( colName.isEmpty() ) {
+   if ( ! ret.prop ) {
       qCritical() << QString("Could not translate %1 to a column name").arg(propName);
       throw  QString("Could not translate %1 to a column name").arg(propName);
    }
-   if ( transact )
-      sqlDatabase().transaction();
 
-   try {
-      QSqlQuery update( sqlDatabase() );
-      QString command = QString("UPDATE %1 set %2=:value where id=%3")
-                           .arg(schema->tableName())
-                           .arg(colName)
-                           .arg(object->key());
+   ret.column = ret.prop->colName(schema->defType());
+   return ret;
+}
 
-      update.prepare( command );
-      update.bindValue(":value", value);
+void Database::updateEntry( Ingredient* object, char const* propName, QVariant value, bool notify, bool transact )
+{
+   TableSchema* schema =dbDefn->table( object->table() );
+   QMetaObject const* meta = object->metaObject();
+   ResolvedColumn resolved;
+
+   if ( QThread::currentThread() == thread() ) {
+      // fromRawData() so that a hit neither copies nor allocates
+      QHash< QPair<QMetaObject const*,QByteArray>, ResolvedColumn >::const_iterator i =
+         m_resolvedColumns.constFind( qMakePair(meta, QByteArray::fromRawData(propName, qstrlen(propName))) );
+      if ( i != m_resolvedColumns.constEnd() ) {
+         resolved = i.value();
+      }
+      else {
+         resolved = resolveColumn(schema, meta, propName);
+         m_resolvedColumns.insert( qMakePair(meta, QByteArray(propName)), resolved );
+      }
+   }
+   else {
+      resolved = resolveColumn(schema, meta, propName);
+   }
 
-      if ( ! update.exec() )
-         throw QString("Could not update %1.%2 to %3: %4 %5")
-                  .arg( schema->tableName() )
-                  .arg( colName )
-                  .arg( value.toString() )
-                  .arg( update.lastQuery() )
-                  .arg( update.lastError().text() );
+   QMetaProperty mProp = meta->property(resolved.metaIndex);
+   PropertySchema const* prop = resolved.prop;
+   QString const& colName = resolved.column;
 
+   if ( QThread::currentThread() == thread() ) {
+      queueWrite( schema, prop, colName, object->key(), value );
+      if ( transact )
+         flush();
    }
-   catch (QString e) {
-      qCritical() << QString("%1 %2").arg(Q_FUNC_INFO).arg(e);
+   else {
+      // Some other thread. It has its own connection, so just do it.
       if ( transact )
-         sqlDatabase().rollback();
-      throw;
+         beginTransaction();
+
+      try {
+         QSqlQuery update = preparedStatement( UpdateColumn, schema, colName, [schema, &colName]() {
+            return QString("UPDATE %1 SET %2=:value WHERE %3=:id")
+                      .arg(schema->tableName())
+                      .arg(colName)
+                      .arg(schema->keyName(Brewtarget::dbType()));
+         });
+         update.bindValue(":value", value);
+         update.bindValue(":id", object->key());
+
+         if ( ! update.exec() )
+            throw QString("Could not update %1.%2 to %3: %4 %5")
+                     .arg( schema->tableName() )
+                     .arg( colName )
+                     .arg( value.toString() )
+                     .arg( update.lastQuery() )
+                     .arg( update.lastError().text() );
+         update.finish();
+      }
+      catch (QString e) {
+         qCritical() << QString("%1 %2").arg(Q_FUNC_INFO).arg(e);
+         if ( transact )
+            rollbackTransaction();
+         throw;
+      }
+
+      if ( transact )
+         commitTransaction();
    }
 
-   if ( transact )
-      sqlDatabase().commit();
+   // Renames and (un)deletes move the row in the name index
+   if ( qstrcmp(propName, PropertyNames::Ingredient::name) == 0 ) {
+      if ( ! object->deleted() )
+         indexName( object->table(), object->key(), value.toString() );
+   }
+   else if ( qstrcmp(propName, PropertyNames::Ingredient::deleted) == 0 ) {
+      if ( value.toBool() )
+         unindexName( object->table(), object->key() );
+      else
+         indexName( object->table(), object->key(), object->name() );
+   }
 
    if ( notify )
       emit object->changed(mProp,value);
 
 }
 
+void Database::updateEntries( Ingredient* object, QVariantMap const& values )
+{
+   // These all land in the write-behind queue, and so go out in the same
+   // transaction.
+   for ( QVariantMap::const_iterator i = values.constBegin(); i != values.constEnd(); ++i ) {
+      updateEntry(object, i.key(), i.value(), false, false);
+   }
+}
 
-QVariant Database::get( Brewtarget::DBTable table, int key, QString col_name )
+void Database::queueWrite( TableSchema* table, PropertySchema const* prop, QString const& column, int key,
+                           QVariant const& value )
 {
-   QSqlQuery q;
-   TableSchema* tbl = dbDefn->table(table);
+   PendingWrite& write = m_pendingWrites[qMakePair(prop, key)];
+
+   if ( write.table != table ) {
+      write.table = table;
+      write.key = key;
+      write.column = column;
+   }
+   write.value = value;
 
-   QString index = QString("%1_%2").arg(tbl->tableName()).arg(col_name);
+   if ( ! m_writeBehindTimer.isActive() )
+      m_writeBehindTimer.start();
+}
 
-   if ( ! selectSome.contains(index) ) {
-      QString query = QString("SELECT %1 from %2 WHERE %3=:id")
-                        .arg(col_name)
-                        .arg(tbl->tableName())
-                        .arg(tbl->keyName());
-      q = QSqlQuery( sqlDatabase() );
-      q.prepare(query);
-      selectSome.insert(index,q);
+void Database::flush()
+{
+   // Don't go round again if something below calls back in while we are writing
+   if ( m_flushingWrites || m_pendingWrites.isEmpty() )
+      return;
+
+   m_flushingWrites = true;
+   m_writeBehindTimer.stop();
+
+   QHash< QPair<PropertySchema const*,int>, PendingWrite > writes;
+   writes.swap(m_pendingWrites);
+
+   QSqlDatabase sqldb = sqlDatabase();
+   // If somebody upstream already has a transaction open, we are part of it.
+   bool ownTransaction = sqldb.transaction();
+
+   try {
+      foreach( PendingWrite const& write, writes ) {
+         QSqlQuery update = preparedStatement( UpdateColumn, write.table, write.column, [&write]() {
+            return QString("UPDATE %1 SET %2=:value WHERE %3=:id")
+                      .arg(write.table->tableName())
+                      .arg(write.column)
+                      .arg(write.table->keyName(Brewtarget::dbType()));
+         });
+         update.bindValue(":value", write.value);
+         update.bindValue(":id", write.key);
+
+         if ( ! update.exec() )
+            throw QString("Could not update %1.%2 to %3: %4 %5")
+                     .arg( write.table->tableName() )
+                     .arg( write.column )
+                     .arg( write.value.toString() )
+                     .arg( update.lastQuery() )
+                     .arg( update.lastError().text() );
+         update.finish();
+      }
+   }
+   catch (QString e) {
+      qCritical() << QString("%1 %2").arg(Q_FUNC_INFO).arg(e);
+      if ( ownTransaction )
+         sqldb.rollback();
+
+      // None of it is known to have stuck, so it all goes back on the queue
+      // for the next flush. Anything queued since is newer and wins.
+      for ( QHash< QPair<PropertySchema const*,int>, PendingWrite >::const_iterator i = writes.constBegin();
+            i != writes.constEnd(); ++i ) {
+         if ( ! m_pendingWrites.contains(i.key()) )
+            m_pendingWrites.insert(i.key(), i.value());
+      }
+      m_flushingWrites = false;
+      throw;
    }
 
-   q = selectSome.value(index);
+   if ( ownTransaction ) {
+      sqldb.commit();
+      noteWrite();
+   }
+
+   m_flushingWrites = false;
+}
+
+void Database::readBarrier( Brewtarget::DBTable table )
+{
+   // The queue only ever fills on the thread that owns the Database
+   if ( m_pendingWrites.isEmpty() || QThread::currentThread() != thread() )
+      return;
+
+   foreach( PendingWrite const& write, m_pendingWrites ) {
+      if ( write.table->dbTable() != table )
+         continue;
+
+      // A read shouldn't throw at callers that never expected it. If the
+      // writes could not go out, flush() has already said so.
+      try {
+         flush();
+      }
+      catch (QString e) {
+         qCritical() << QString("%1 %2").arg(Q_FUNC_INFO).arg(e);
+      }
+      return;
+   }
+}
+
+void Database::noteWrite()
+{
+   if ( dbWal && QThread::currentThread() == thread() )
+      m_checkpointTimer.start();
+}
+
+void Database::checkpoint(bool truncate)
+{
+   if ( ! dbWal || Brewtarget::dbType() != Brewtarget::SQLITE )
+      return;
+
+   // Not half way through an import; the timer comes round again afterwards
+   if ( importing() ) {
+      noteWrite();
+      return;
+   }
+
+   QString mode = truncate ? "TRUNCATE" : "PASSIVE";
+   QSqlQuery q(sqlDatabase());
+   if ( ! q.exec(QString("PRAGMA wal_checkpoint(%1)").arg(mode)) )
+      qWarning() << QString("%1 %2 checkpoint failed: %3").arg(Q_FUNC_INFO).arg(mode).arg(q.lastError().text());
+   else if ( q.next() )
+      qDebug() << QString("%1 %2 checkpoint: %3 of %4 frames")
+                  .arg(Q_FUNC_INFO).arg(mode).arg(q.value(2).toInt()).arg(q.value(1).toInt());
+   q.finish();
+}
+
+
+QVariant Database::get( Brewtarget::DBTable table, int key, QString col_name )
+{
+   TableSchema* tbl = dbDefn->table(table);
+
+   readBarrier(table);
+
+   QSqlQuery q = preparedStatement( SelectColumn, tbl, col_name, [tbl, &col_name]() {
+      return QString("SELECT %1 from %2 WHERE %3=:id")
+                .arg(col_name)
+                .arg(tbl->tableName())
+                .arg(tbl->keyName());
+   });
    q.bindValue(":id", key);
 
    q.exec();
@@ -2681,11 +3375,55 @@ QVariant Database::get( Brewtarget::DBTable table, int key, QString col_name )
       return QVariant();
    }
 
-   QVariant ret( q.record().value(col_name) );
+   QVariant ret( q.value(0) );
    q.finish();
    return ret;
 }
 
+uint qHash(Database::StatementKey const& key, uint seed)
+{
+   return qHash(key.column, seed) ^ qHash(key.table, seed) ^ static_cast<uint>(key.kind);
+}
+
+QSqlQuery Database::preparedStatement( StatementKind kind, TableSchema const* table, QString const& column,
+                                       std::function<QString()> makeSql )
+{
+   QSqlDatabase sqldb = sqlDatabase();
+   StatementKey stmtKey = { kind, table, column };
+
+   QMutexLocker locker(&m_statementsMutex);
+   QHash<StatementKey,QSqlQuery>& cache = m_statements[sqldb.connectionName()];
+
+   QHash<StatementKey,QSqlQuery>::const_iterator i = cache.constFind(stmtKey);
+   if ( i != cache.constEnd() ) {
+      ++m_statementHits;
+      return i.value();
+   }
+
+   ++m_statementMisses;
+   QString sql = makeSql();
+   QSqlQuery q(sqldb);
+   if ( ! q.prepare(sql) ) {
+      // Don't cache it, so the caller gets the same error next time round
+      qCritical() << QString("%1 could not prepare %2: %3").arg(Q_FUNC_INFO).arg(sql).arg(q.lastError().text());
+      return q;
+   }
+   cache.insert(stmtKey, q);
+   return q;
+}
+
+quint64 Database::statementCacheHits() const
+{
+   QMutexLocker locker(&m_statementsMutex);
+   return m_statementHits;
+}
+
+quint64 Database::statementCacheMisses() const
+{
+   QMutexLocker locker(&m_statementsMutex);
+   return m_statementMisses;
+}
+
 
 QVariant Database::get( TableSchema* tbl, int key, QString col_name )
 {
@@ -2799,22 +3537,25 @@ QVariant Database::getInventoryAmt(QString col_name, Brewtarget::DBTable table,
    TableSchema* tbl = dbDefn->table(table);
    TableSchema* inv = dbDefn->table(tbl->invTable());
 
-   // select hop_in_inventory.amount from hop_in_inventory,hop where hop.id = key and hop_in_inventory.id = hop.inventory_id
-   QString query = QString("select %1.%2 from %1,%3 where %3.%4 = %5 and %1.%6 = %3.%7")
-         .arg(inv->tableName())
-         .arg(inv->propertyToColumn(kpropInventory))
-         .arg(tbl->tableName())
-         .arg(tbl->keyName())
-         .arg(key)
-         .arg(inv->keyName())
-         .arg(tbl->foreignKeyToColumn(kpropInventoryId));
-
+   readBarrier(table);
+   readBarrier(tbl->invTable());
 
-   QSqlQuery q( query, sqlDatabase() );
+   // select hop_in_inventory.amount from hop_in_inventory,hop where hop.id = :id and hop_in_inventory.id = hop.inventory_id
+   QSqlQuery q = preparedStatement( SelectInventory, tbl, QString(), [tbl, inv]() {
+      return QString("select %1.%2 from %1,%3 where %3.%4 = :id and %1.%5 = %3.%6")
+                .arg(inv->tableName())
+                .arg(inv->propertyToColumn(kpropInventory))
+                .arg(tbl->tableName())
+                .arg(tbl->keyName())
+                .arg(inv->keyName())
+                .arg(tbl->foreignKeyToColumn(kpropInventoryId));
+   });
+   q.bindValue(":id", key);
 
-   if ( q.first() ) {
+   if ( q.exec() && q.first() ) {
       val = q.record().value(inv->propertyToColumn(col_name));
    }
+   q.finish();
    return val;
 }
 
@@ -2833,7 +3574,7 @@ int Database::newInventory(TableSchema* schema) {
    return newKey;
 }
 
-QMap<int, double> Database::getInventory(const Brewtarget::DBTable table) const
+QMap<int, double> Database::getInventory(const Brewtarget::DBTable table)
 {
    QMap<int, double> result;
    TableSchema* tbl = dbDefn->table(table);
@@ -2853,6 +3594,8 @@ QMap<int, double> Database::getInventory(const Brewtarget::DBTable table) const
          .arg(tbl->propertyToColumn(PropertyNames::Ingredient::deleted))
          .arg(Brewtarget::dbFalse());
 
+   readBarrier(table);
+   readBarrier(tbl->invTable());
    QSqlQuery sql(query, sqlDatabase());
    if (! sql.isActive()) {
       throw QString("Failed to get the inventory.\nQuery:\n%1\nError:\n%2")
@@ -2877,7 +3620,7 @@ void Database::addToRecipe( Recipe* rec, Equipment* e, bool noCopy, bool transac
       return;
 
    if ( transact )
-      sqlDatabase().transaction();
+      beginTransaction();
 
    try {
       // Make a copy of equipment.
@@ -2893,14 +3636,14 @@ void Database::addToRecipe( Recipe* rec, Equipment* e, bool noCopy, bool transac
    }
    catch (QString e ) {
       if ( transact )
-         sqlDatabase().rollback();
+         rollbackTransaction();
       throw;
    }
 
    // This is likely illadvised. But if you are telling me to not transact it,
    // it is up to you to commit the changes
    if ( transact ) {
-      sqlDatabase().commit();
+      commitTransaction();
    }
    // NOTE: need to disconnect the recipe's old equipment?
    connect( newEquip, &Ingredient::changed, rec, &Recipe::acceptEquipChange );
@@ -2912,11 +3655,126 @@ void Database::addToRecipe( Recipe* rec, Equipment* e, bool noCopy, bool transac
    // Emit a changed signal.
    emit rec->changed( rec->metaProperty("equipment"), Ingredient::qVariantFromPtr(newEquip) );
 
-   // If we are already wrapped in a transaction boundary, do not call
-   // recaclAll(). Weirdness ensues. But I want this after all the signals are
-   // attached, etc.
-   if ( transact )
-      rec->recalcAll();
+   // After all the signals are attached, so the recalculation hears them
+   rec->markDirty(Recipe::InputEquipment);
+}
+
+template<class T> QList<T*> Database::addIngredientsToRecipe(
+   Recipe* rec,
+   QList<T*> const& ings,
+   QHash<int,T*>* keyHash
+)
+{
+   QList<T*> newIngs;
+   QString propName;
+   QStringList srcKeys, links, children;
+   const QMetaObject* meta = &T::staticMetaObject;
+   int ndx = meta->indexOfClassInfo("signal");
+
+   if( rec == nullptr || ings.isEmpty() )
+      return newIngs;
+
+   TableSchema* table = dbDefn->table( dbDefn->classNameToTable(meta->className()) );
+   TableSchema* child = dbDefn->table( table->childTable() );
+   TableSchema* inrec = dbDefn->table( table->inRecTable() );
+
+   QSqlQuery q(sqlDatabase());
+   try {
+      if ( ndx != -1 ) {
+         propName  = meta->classInfo(ndx).value();
+      }
+      else {
+         throw QString("could not locate classInfo for signal on %2").arg(meta->className());
+      }
+
+      foreach( T* ing, ings )
+         srcKeys.append( QString::number(ing->_key) );
+
+      // Ensure none of these are already in the recipe.
+      QString select = QString("SELECT %1 FROM %2 WHERE %3=%4 AND %5 IN (%6)")
+                           .arg(inrec->recipeIndexName())
+                           .arg(inrec->tableName())
+                           .arg(inrec->recipeIndexName())
+                           .arg(rec->_key)
+                           .arg(inrec->inRecIndexName())
+                           .arg(srcKeys.join(","));
+      if (! q.exec(select) ) {
+         throw QString("Couldn't execute ingredient in recipe search: Query: %1 error: %2")
+            .arg(q.lastQuery()).arg(q.lastError().text());
+      }
+      if ( q.next() ) {
+         throw QString("Ingredient already exists in recipe." );
+      }
+      q.finish();
+
+      newIngs = copyAll<T>(ings, keyHash, false);
+      for ( int i = 0; i < ings.size(); ++i ) {
+         newIngs.at(i)->setParent(*ings.at(i));
+         links.append( QString("(%1,%2)").arg(newIngs.at(i)->key()).arg(rec->_key) );
+      }
+
+      // INSERT INTO hop_in_recipe (hop_id, recipe_id) VALUES (41,7),(42,7),...
+      QString insert = QString("INSERT INTO %1 (%2, %3) VALUES %4")
+               .arg(inrec->tableName())
+               .arg(inrec->inRecIndexName(Brewtarget::dbType()))
+               .arg(inrec->recipeIndexName())
+               .arg(links.join(","));
+      if ( ! q.exec(insert) ) {
+         throw QString("%2 : %1.").arg(q.lastQuery()).arg(q.lastError().text());
+      }
+      foreach( T* newIng, newIngs )
+         indexInRecipe( inrec->dbTable(), rec->_key, newIng );
+
+      // The same parents addIngredientToRecipe() would find: whatever the
+      // source was copied from, or the source itself.
+      if( inrec->dbTable() != Brewtarget::INSTINRECTABLE && inrec->dbTable() != Brewtarget::SALTINRECTABLE ) {
+         QHash<int,int> parents;
+         QString parentChildSql = QString("SELECT %1, %2 FROM %3 WHERE %1 IN (%4)")
+               .arg(child->childIndexName())
+               .arg(child->parentIndexName())
+               .arg(child->tableName())
+               .arg(srcKeys.join(","));
+         if ( ! q.exec(parentChildSql) ) {
+            throw QString("%1 %2.").arg(q.lastQuery()).arg(q.lastError().text());
+         }
+         while( q.next() )
+            parents.insert( q.value(0).toInt(), q.value(1).toInt() );
+         q.finish();
+
+         for ( int i = 0; i < ings.size(); ++i ) {
+            int key = ings.at(i)->_key;
+            children.append( QString("(%1,%2)").arg(parents.value(key, key)).arg(newIngs.at(i)->key()) );
+         }
+
+         insert = QString("INSERT INTO %1 (%2, %3) VALUES %4")
+               .arg(child->tableName())
+               .arg(child->parentIndexName())
+               .arg(child->childIndexName())
+               .arg(children.join(","));
+         if ( ! q.exec(insert) ) {
+            throw QString("%1 %2.").arg(q.lastQuery()).arg(q.lastError().text());
+         }
+      }
+   }
+   catch (QString e) {
+      qCritical() << QString("%1 %2").arg(Q_FUNC_INFO).arg(e);
+      q.finish();
+
+      // The caller rolls the rows back, so the copies go from memory too.
+      // An import session mustn't forget them a second time.
+      QList<Ingredient*> copies;
+      foreach( T* newIng, newIngs ) {
+         unindexInRecipe( inrec->dbTable(), rec->_key, newIng );
+         m_importInserted.removeOne(newIng);
+         copies.append(newIng);
+      }
+      forgetElements(copies);
+      throw;
+   }
+   q.finish();
+
+   emit rec->changed( rec->metaProperty(propName), QVariant() );
+   return newIngs;
 }
 
 Fermentable * Database::addToRecipe( Recipe* rec, Fermentable* ferm, bool noCopy, bool transact )
@@ -2928,9 +3786,7 @@ Fermentable * Database::addToRecipe( Recipe* rec, Fermentable* ferm, bool noCopy
       Fermentable* newFerm = addIngredientToRecipe<Fermentable>(rec,ferm,noCopy,&allFermentables,true,transact );
       connect( newFerm, SIGNAL(changed(QMetaProperty,QVariant)), rec, SLOT(acceptFermChange(QMetaProperty,QVariant)) );
 
-      // If somebody upstream is doing the transaction, let them call recalcAll
-      if ( transact && ! noCopy )
-         rec->recalcAll();
+      rec->markDirty(Recipe::InputFermentables);
 
       return newFerm;
    }
@@ -2945,27 +3801,26 @@ void Database::addToRecipe( Recipe* rec, QList<Fermentable*>ferms, bool transact
       return;
 
    if ( transact ) {
-      sqlDatabase().transaction();
+      beginTransaction();
    }
 
    try {
-      foreach (Fermentable* ferm, ferms )
+      foreach (Fermentable* newFerm, addIngredientsToRecipe<Fermentable>(rec, ferms, &allFermentables) )
       {
-         Fermentable* newFerm = addIngredientToRecipe<Fermentable>(rec,ferm,false,&allFermentables,true,false);
          connect( newFerm, SIGNAL(changed(QMetaProperty,QVariant)), rec, SLOT(acceptFermChange(QMetaProperty,QVariant)) );
       }
    }
    catch ( QString e  ) {
       if ( transact ) {
-         sqlDatabase().rollback();
+         rollbackTransaction();
       }
       throw;
    }
 
    if ( transact ) {
-      sqlDatabase().commit();
-      rec->recalcAll();
+      commitTransaction();
    }
+   rec->markDirty(Recipe::InputFermentables);
 }
 
 Hop * Database::addToRecipe( Recipe* rec, Hop* hop, bool noCopy, bool transact )
@@ -2974,9 +3829,7 @@ Hop * Database::addToRecipe( Recipe* rec, Hop* hop, bool noCopy, bool transact )
       Hop* newHop = addIngredientToRecipe<Hop>( rec, hop, noCopy, &allHops, true, transact );
       // it's slightly dirty pool to put this all in the try block. Sue me.
       connect( newHop, SIGNAL(changed(QMetaProperty,QVariant)), rec, SLOT(acceptHopChange(QMetaProperty,QVariant)));
-      if ( transact ) {
-         rec->recalcIBU();
-      }
+      rec->markDirty(Recipe::InputHops);
       return newHop;
    }
    catch (QString e) {
@@ -2990,27 +3843,26 @@ void Database::addToRecipe( Recipe* rec, QList<Hop*>hops, bool transact )
       return;
 
    if ( transact ) {
-      sqlDatabase().transaction();
+      beginTransaction();
    }
 
    try {
-      foreach (Hop* hop, hops ) {
-         Hop* newHop = addIngredientToRecipe<Hop>( rec, hop, false, &allHops, true, false );
+      foreach (Hop* newHop, addIngredientsToRecipe<Hop>( rec, hops, &allHops ) ) {
          connect( newHop, SIGNAL(changed(QMetaProperty,QVariant)), rec, SLOT(acceptHopChange(QMetaProperty,QVariant)));
       }
    }
    catch (QString e) {
       qCritical() << QString("%1 %2").arg(Q_FUNC_INFO).arg(e);
       if ( transact ) {
-         sqlDatabase().rollback();
+         rollbackTransaction();
       }
       throw;
    }
 
    if ( transact ) {
-      sqlDatabase().commit();
-      rec->recalcIBU();
+      commitTransaction();
    }
+   rec->markDirty(Recipe::InputHops);
 }
 
 Mash * Database::addToRecipe( Recipe* rec, Mash* m, bool noCopy, bool transact )
@@ -3019,7 +3871,7 @@ Mash * Database::addToRecipe( Recipe* rec, Mash* m, bool noCopy, bool transact )
    TableSchema* tbl = dbDefn->table(Brewtarget::RECTABLE);
 
    if ( transact )
-      sqlDatabase().transaction();
+      beginTransaction();
    // Make a copy of mash.
    // Making a copy of the mash isn't enough. We need a copy of the mashsteps
    // too.
@@ -3037,18 +3889,16 @@ Mash * Database::addToRecipe( Recipe* rec, Mash* m, bool noCopy, bool transact )
    catch (QString e) {
       qCritical() << QString("%1 %2").arg(Q_FUNC_INFO).arg(e);
       if ( transact )
-         sqlDatabase().rollback();
+         rollbackTransaction();
       throw;
    }
 
    if ( transact ) {
-      sqlDatabase().commit();
+      commitTransaction();
    }
    connect( newMash, SIGNAL(changed(QMetaProperty,QVariant)), rec, SLOT(acceptMashChange(QMetaProperty,QVariant)));
    emit rec->changed( rec->metaProperty("mash"), Ingredient::qVariantFromPtr(newMash) );
-   // And let the recipe recalc all?
-   if ( !noCopy && transact )
-      rec->recalcAll();
+   rec->markDirty(Recipe::InputMash);
 
    return newMash;
 }
@@ -3057,9 +3907,8 @@ Misc * Database::addToRecipe( Recipe* rec, Misc* m, bool noCopy, bool transact )
 {
 
    try {
+      // Miscs feed none of the calculations, so there is nothing to mark dirty
       Misc * newMisc = addIngredientToRecipe( rec, m, noCopy, &allMiscs, true, transact );
-      if ( transact && ! noCopy )
-         rec->recalcAll();
       return newMisc;
    }
    catch (QString e) {
@@ -3073,23 +3922,20 @@ void Database::addToRecipe( Recipe* rec, QList<Misc*>miscs, bool transact )
       return;
 
    if ( transact )
-      sqlDatabase().transaction();
+      beginTransaction();
 
    try {
-      foreach (Misc* misc, miscs ) {
-         addIngredientToRecipe( rec, misc, false, &allMiscs,true,false );
-      }
+      addIngredientsToRecipe<Misc>( rec, miscs, &allMiscs );
    }
    catch (QString e) {
       qCritical() << QString("%1 %2").arg(Q_FUNC_INFO).arg(e);
       if ( transact ) {
-         sqlDatabase().rollback();
+         rollbackTransaction();
       }
       throw;
    }
    if ( transact ) {
-      sqlDatabase().commit();
-      rec->recalcAll();
+      commitTransaction();
    }
 }
 
@@ -3124,7 +3970,7 @@ Style * Database::addToRecipe( Recipe* rec, Style* s, bool noCopy, bool transact
       return nullptr;
 
    if ( transact )
-      sqlDatabase().transaction();
+      beginTransaction();
 
    try {
       if ( ! noCopy )
@@ -3137,12 +3983,12 @@ Style * Database::addToRecipe( Recipe* rec, Style* s, bool noCopy, bool transact
    catch (QString e) {
       qCritical() << QString("%1 %2").arg(Q_FUNC_INFO).arg(e);
       if ( transact )
-         sqlDatabase().rollback();
+         rollbackTransaction();
       throw;
    }
 
    if ( transact ) {
-      sqlDatabase().commit();
+      commitTransaction();
    }
    // Emit a changed signal.
    rec->m_style_id = newStyle->key();
@@ -3155,11 +4001,7 @@ Yeast * Database::addToRecipe( Recipe* rec, Yeast* y, bool noCopy, bool transact
    try {
       Yeast* newYeast = addIngredientToRecipe<Yeast>( rec, y, noCopy, &allYeasts, true, transact );
       connect( newYeast, SIGNAL(changed(QMetaProperty,QVariant)), rec, SLOT(acceptYeastChange(QMetaProperty,QVariant)));
-      if ( transact && ! noCopy )
-      {
-         rec->recalcOgFg();
-         rec->recalcABV_pct();
-      }
+      rec->markDirty(Recipe::InputYeasts);
       return newYeast;
    }
    catch (QString e) {
@@ -3173,27 +4015,25 @@ void Database::addToRecipe( Recipe* rec, QList<Yeast*>yeasts, bool transact )
       return;
 
    if ( transact )
-      sqlDatabase().transaction();
+      beginTransaction();
 
    try {
-      foreach (Yeast* yeast, yeasts )
+      foreach (Yeast* newYeast, addIngredientsToRecipe<Yeast>( rec, yeasts, &allYeasts ) )
       {
-         Yeast* newYeast = addIngredientToRecipe( rec, yeast, false, &allYeasts,true,false );
          connect( newYeast, SIGNAL(changed(QMetaProperty,QVariant)), rec, SLOT(acceptYeastChange(QMetaProperty,QVariant)));
       }
    }
    catch (QString e) {
       qCritical() << QString("%1 %2").arg(Q_FUNC_INFO).arg(e);
       if ( transact )
-         sqlDatabase().rollback();
+         rollbackTransaction();
       throw;
    }
 
    if ( transact ) {
-      sqlDatabase().commit();
-      rec->recalcOgFg();
-      rec->recalcABV_pct();
+      commitTransaction();
    }
+   rec->markDirty(Recipe::InputYeasts);
 }
 
 
@@ -3209,15 +4049,17 @@ template<class T> T* Database::copy( Ingredient const* object, QHash<int,T*>* ke
 
    QString tName = tbl->tableName();
 
-   QSqlQuery q(sqlDatabase());
+   // Copy what the user sees, not what was last written
+   readBarrier(t);
 
-   try {
-      QString select = QString("SELECT * FROM %1 WHERE id = %2").arg(tName).arg(object->_key);
+   QSqlQuery q = preparedStatement( SelectRow, tbl, QString(), [tbl]() {
+      return QString("SELECT * FROM %1 WHERE %2 = :id").arg(tbl->tableName()).arg(tbl->keyName());
+   });
 
-      ///qDebug() << Q_FUNC_INFO << "SELECT SQL:" << select;
-      qDebug() << QString("%1 SELECT SQL: %2").arg(Q_FUNC_INFO).arg(select);
+   try {
+      q.bindValue(":id", object->_key);
 
-      if( !q.exec(select) )
+      if( !q.exec() )
          throw QString("%1 %2").arg(q.lastQuery()).arg(q.lastError().text());
       else
          q.next();
@@ -3225,27 +4067,24 @@ template<class T> T* Database::copy( Ingredient const* object, QHash<int,T*>* ke
       QSqlRecord oldRecord = q.record();
       q.finish();
 
-      // Get the field names from the oldRecord. But skip ID, because it
-      // won't work to copy it
-      for (i=0; i< oldRecord.count(); ++i) {
-         QString name = oldRecord.fieldName(i);
-         if ( name != tbl->keyName() ) {
-            fields += fields.isEmpty() ? name : QString(",%1").arg(name);
-            holder += holder.isEmpty() ? QString(":%1").arg(name) : QString(",:%1").arg(name);
+      // The columns of a table don't change, so neither does the INSERT
+      QSqlQuery insert = preparedStatement( InsertCopy, tbl, QString(), [tbl, &tName, &oldRecord, &fields, &holder]() {
+         // Get the field names from the oldRecord. But skip ID, because it
+         // won't work to copy it
+         for (int j=0; j< oldRecord.count(); ++j) {
+            QString name = oldRecord.fieldName(j);
+            if ( name != tbl->keyName() ) {
+               fields += fields.isEmpty() ? name : QString(",%1").arg(name);
+               holder += holder.isEmpty() ? QString(":%1").arg(name) : QString(",:%1").arg(name);
+            }
          }
-      }
 
-      // Create a new row.
-      QString prepString = QString("INSERT INTO %1 (%2) VALUES(%3)")
-                           .arg(tName)
-                           .arg(fields)
-                           .arg(holder);
-
-      ///qDebug() << Q_FUNC_INFO << "INSERT SQL:" << prepString;
-      qDebug() << QString("%1 INSERT SQL: %2").arg(Q_FUNC_INFO).arg(prepString);
-
-      QSqlQuery insert = QSqlQuery( sqlDatabase() );
-      insert.prepare(prepString);
+         // Create a new row.
+         return QString("INSERT INTO %1 (%2) VALUES(%3)")
+                   .arg(tName)
+                   .arg(fields)
+                   .arg(holder);
+      });
 
       // Bind, bind like the wind! Or at least like mueslix
       for (i=0; i< oldRecord.count(); ++i)
@@ -3267,8 +4106,12 @@ template<class T> T* Database::copy( Ingredient const* object, QHash<int,T*>* ke
          throw QString("could not execute %1 : %2").arg(insert.lastQuery()).arg(insert.lastError().text());
 
       newKey = insert.lastInsertId().toInt();
+      insert.finish();
       newOne = new T(t, newKey, oldRecord);
       keyHash->insert( newKey, newOne );
+      if ( ! newOne->deleted() )
+         indexName( t, newKey, newOne->name() );
+      noteImportInsert(newOne);
    }
    catch (QString e) {
       qCritical() << QString("%1 %2").arg(Q_FUNC_INFO).arg(e);
@@ -3280,6 +4123,157 @@ template<class T> T* Database::copy( Ingredient const* object, QHash<int,T*>* ke
    return newOne;
 }
 
+QList<int> Database::copyRows( Brewtarget::DBTable table, QList<int> const& keys, bool displayed,
+                               QVariantMap const& columns )
+{
+   QList<int> ret;
+   TableSchema* tbl = dbDefn->table(table);
+   QString keyName = tbl->keyName();
+   QString displayCol = tbl->propertyToColumn(PropertyNames::Ingredient::display);
+   QStringList names, values, sources;
+
+   if ( keys.isEmpty() )
+      return ret;
+
+   // Everything but the key is copied, foreign keys included, so the copies
+   // share their inventory with the originals just like copy() does.
+   foreach( QString const& col, tbl->allColumnNames() + tbl->allForeignKeyColumnNames() ) {
+      names.append(col);
+      if ( columns.contains(col) )
+         values.append( QString(":set_%1").arg(col) );
+      else if ( col == displayCol )
+         values.append( displayed ? Brewtarget::dbTrue() : Brewtarget::dbFalse() );
+      else
+         values.append( QString("o.%1").arg(col) );
+   }
+
+   // Number the copies 1, 2, ... so their keys are known up front. A
+   // VALUES list rather than IN (...), so a key can be copied twice.
+   for ( int i = 0; i < keys.size(); ++i )
+      sources.append( QString("(%1,%2)").arg(i + 1).arg(keys.at(i)) );
+
+   // The copies have to pick up what is still queued for the originals
+   readBarrier(table);
+   QSqlQuery q(sqlDatabase());
+   try {
+      int lastKey = reserveKeys(q, tbl, keys.size());
+
+      // INSERT INTO hop (id, name, ...) SELECT 41 + v.column1, o.name, ...
+      //    FROM hop o JOIN (VALUES (1,12),(2,12),(3,40)) v ON o.id = v.column2
+      QString queryString = QString("INSERT INTO %1 (%2, %3) SELECT %4 + v.column1, %5 FROM %1 o "
+                                    "JOIN (VALUES %6) v ON o.%2 = v.column2")
+                               .arg(tbl->tableName())
+                               .arg(keyName)
+                               .arg(names.join(", "))
+                               .arg(lastKey)
+                               .arg(values.join(", "))
+                               .arg(sources.join(","));
+      q.prepare(queryString);
+      for ( QVariantMap::const_iterator i = columns.constBegin(); i != columns.constEnd(); ++i )
+         q.bindValue( QString(":set_%1").arg(i.key()), i.value() );
+      if ( ! q.exec() )
+         throw QString("%1 %2").arg(queryString).arg(q.lastError().text());
+      if ( q.numRowsAffected() != keys.size() )
+         throw QString("copied %1 of %2 rows from %3").arg(q.numRowsAffected()).arg(keys.size()).arg(tbl->tableName());
+
+      for ( int i = 0; i < keys.size(); ++i )
+         ret.append( lastKey + i + 1 );
+   }
+   catch (QString e) {
+      qCritical() << QString("%1 %2").arg(Q_FUNC_INFO).arg(e);
+      q.finish();
+      throw;
+   }
+
+   q.finish();
+   return ret;
+}
+
+int Database::reserveKeys( QSqlQuery& q, TableSchema* tbl, int count )
+{
+   QString queryString;
+   QString keyName = tbl->keyName();
+
+   // Nothing to set aside. On PostgreSQL, a fresh sequence and an empty
+   // table would have us setval() it to 0, which it won't take.
+   if ( count <= 0 )
+      return 0;
+
+   if ( Brewtarget::dbType() == Brewtarget::PGSQL ) {
+      // Move the sequence on past the block, so nothing else gets it either
+      queryString = QString("SELECT setval(pg_get_serial_sequence('%1', '%2'), "
+                            "GREATEST(nextval(pg_get_serial_sequence('%1', '%2')), "
+                            "(SELECT COALESCE(MAX(%2), 0) + 1 FROM %1)) + %3 - 1) - %3")
+                       .arg(tbl->tableName()).arg(keyName).arg(count);
+   }
+   else {
+      // sqlite_sequence remembers the keys of rows since deleted, which
+      // MAX() does not. It catches itself up with whatever we insert.
+      queryString = QString("SELECT MAX(IFNULL((SELECT MAX(%1) FROM %2), 0), "
+                            "IFNULL((SELECT seq FROM sqlite_sequence WHERE name = '%2'), 0))")
+                       .arg(keyName).arg(tbl->tableName());
+   }
+
+   if ( ! q.exec(queryString) )
+      throw QString("%1 %2").arg(queryString).arg(q.lastError().text());
+   return q.next() ? q.value(0).toInt() : 0;
+}
+
+template<class T> QList<T*> Database::copyAll( QList<T*> const& objects, QHash<int,T*>* keyHash, bool displayed,
+                                                QVariantMap const& columns )
+{
+   QList<T*> ret;
+   QList<int> keys;
+   QStringList newKeys;
+   QHash<int,T*> copies;
+
+   if ( objects.isEmpty() )
+      return ret;
+
+   Brewtarget::DBTable t = dbDefn->classNameToTable(T::staticMetaObject.className());
+   TableSchema* tbl = dbDefn->table(t);
+
+   foreach( T* object, objects )
+      keys.append(object->_key);
+
+   QList<int> copied = copyRows(t, keys, displayed, columns);
+   foreach( int key, copied )
+      newKeys.append( QString::number(key) );
+
+   QSqlQuery q(sqlDatabase());
+   q.setForwardOnly(true);
+   QString queryString = QString("SELECT * FROM %1 WHERE %2 IN (%3)")
+                            .arg(tbl->tableName())
+                            .arg(tbl->keyName())
+                            .arg(newKeys.join(","));
+   try {
+      if ( ! q.exec(queryString) )
+         throw QString("%1 %2").arg(q.lastQuery()).arg(q.lastError().text());
+   }
+   catch (QString e) {
+      qCritical() << QString("%1 %2").arg(Q_FUNC_INFO).arg(e);
+      q.finish();
+      throw;
+   }
+
+   while( q.next() ) {
+      int key = q.record().value(tbl->keyName()).toInt();
+      T* newOne = new T(t, key, q.record());
+      copies.insert(key, newOne);
+      if ( keyHash )
+         keyHash->insert(key, newOne);
+      if ( ! newOne->deleted() )
+         indexName( t, key, newOne->name() );
+      noteImportInsert(newOne);
+   }
+   q.finish();
+
+   foreach( int key, copied )
+      ret.append( copies.value(key) );
+
+   return ret;
+}
+
 
 //+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 void Database::sqlUpdate( Brewtarget::DBTable table, QString const& setClause, QString const& whereClause )
@@ -3289,6 +4283,8 @@ void Database::sqlUpdate( Brewtarget::DBTable table, QString const& setClause, Q
                 .arg(setClause)
                 .arg(whereClause);
 
+   // Or a queued write would land on top of this one afterwards
+   readBarrier(table);
    QSqlQuery q(sqlDatabase());
    try {
       if ( ! q.exec(update) )
@@ -3309,6 +4305,7 @@ void Database::sqlDelete( Brewtarget::DBTable table, QString const& whereClause
                 .arg(dbDefn->tableName(table))
                 .arg(whereClause);
 
+   readBarrier(table);
    QSqlQuery q(sqlDatabase());
    try {
       if ( ! q.exec(del) )
@@ -3463,7 +4460,7 @@ bool Database::updateSchema(bool* err)
       }
    }
 
-   sqlDatabase().transaction();
+   beginTransaction();
 
    try {
       //populate ingredient links
@@ -3485,27 +4482,63 @@ bool Database::updateSchema(bool* err)
    }
    catch (QString e ) {
       qCritical() << QString("%1 %2").arg(Q_FUNC_INFO).arg(e);
-      sqlDatabase().rollback();
+      rollbackTransaction();
       throw;
    }
 
-   sqlDatabase().commit();
+   commitTransaction();
 
    return doUpdate;
 }
 
+namespace {
+   //! One record on its way through importFromXML().
+   struct ImportRecord {
+      QDomDocument doc;
+      QDomElement element;
+      BeerXML::ParsedRecord parsed;
+   };
+
+   //! Records that are read, parsed and written together.
+   struct ImportBatch {
+      QVector<ImportRecord> records;
+      //! Released once for each record that has been parsed
+      QSemaphore parsed;
+   };
+
+   //! Parses one record of a batch on the thread pool.
+   class ParseRunner : public QRunnable
+   {
+   public:
+      ParseRunner(BeerXML* beerxml, ImportBatch* batch, ImportRecord* record)
+         : m_beerxml(beerxml), m_batch(batch), m_record(record)
+      {
+      }
+
+      void run() override
+      {
+         // Nothing else touches this record's document until the batch is written
+         m_record->parsed = m_beerxml->parseRecord(m_record->element);
+         m_batch->parsed.release();
+      }
+
+   private:
+      BeerXML* m_beerxml;
+      ImportBatch* m_batch;
+      ImportRecord* m_record;
+   };
+}
+
 bool Database::importFromXML(const QString& filename)
 {
-   int count;
-   int line, col;
-   QDomDocument xmlDoc;
-   QDomElement root;
-   QDomNodeList list;
-   QString err;
    QFile inFile;
-   QStringList tags = QStringList() << "EQUIPMENT" << "FERMENTABLE" << "HOP" << "MISC" << "STYLE" << "YEAST" << "WATER" << "MASHS";
+   QXmlStreamReader xml;
+   QStringList tags = QStringList() << "RECIPE" << "EQUIPMENT" << "FERMENTABLE" << "HOP" << "MISC" << "STYLE" << "YEAST" << "WATER" << "MASHS";
    inFile.setFileName(filename);
    bool ret = true;
+   qint64 total;
+   int lastPercent = -1;
+   int const batchSize = 4 * qMax(1, QThread::idealThreadCount());
 
    if( ! inFile.open(QIODevice::ReadOnly) )
    {
@@ -3513,113 +4546,316 @@ bool Database::importFromXML(const QString& filename)
       return false;
    }
 
-   if( ! xmlDoc.setContent(&inFile, false, &err, &line, &col) )
-      qWarning() << QString("Database::importFromXML: Bad document formatting in %1 %2:%3. %4").arg(filename).arg(line).arg(col).arg(err);
+   // Reading the file has to happen in order, and so does writing to the
+   // database, but turning the text of each record into numbers and dates
+   // does not. So records are read in batches, and while one batch is
+   // being parsed on the pool, the next is read and the one before is
+   // written, in the order they were in the file.
+   std::unique_ptr<ImportBatch> reading(new ImportBatch), parsing, writing;
+   // After the batches, so that however we leave, the pool is done with
+   // them before they go.
+   QThreadPool pool;
+
+   auto startParsing = [&]() {
+      writing = std::move(parsing);
+      parsing = std::move(reading);
+      for ( int i = 0; i < parsing->records.size(); ++i )
+         pool.start(new ParseRunner(m_beerxml, parsing.get(), parsing->records.data() + i));
+   };
+
+   auto write = [&]() {
+      if ( ! writing )
+         return;
 
-   list = xmlDoc.elementsByTagName("RECIPE");
-   if ( list.count() )
-   {
-      for(int i = 0; i < list.count(); ++i )
-      {
-         Recipe* temp = m_beerxml->recipeFromXml( list.at(i) );
-         if ( ! temp || ! temp->isValid() )
+      writing->parsed.acquire(writing->records.size());
+      for ( ImportRecord const& record : writing->records ) {
+         Ingredient* temp = m_beerxml->importRecord(record.element, &record.parsed);
+         // An empty MASHS has nothing to import, and nothing wrong with it
+         if ( temp ? ! temp->isValid() : record.element.tagName() != "MASHS" )
             ret = false;
       }
-   }
-   else
-   {
-      foreach (QString tag, tags)
+      writing.reset();
+   };
+
+   // Read a record at a time, so we only ever hold a few batches of them in
+   // memory however big the file is. The containers (RECIPES, HOPS, ...)
+   // are just walked through, except for MASHS, which BeerXML::importRecord()
+   // takes as one record. A record's children are read along with it,
+   // so the hops in a recipe are not imported again on their own.
+   xml.setDevice(&inFile);
+   total = inFile.size();
+   emit importProgress(0, total);
+   beginImport();
+
+   try {
+      while( ! xml.atEnd() )
       {
-         list = xmlDoc.elementsByTagName(tag);
-         count = list.size();
+         xml.readNext();
+         if ( ! xml.isStartElement() )
+            continue;
 
-         if ( count > 0 )
-         {
-            // Tell how many there were in the status bar.
-            //statusBar()->showMessage( tr("Found %1 %2.").arg(count).arg(tag.toLower()), 5000 );
+         QString tag = xml.name().toString();
+         if ( ! tags.contains(tag) )
+            continue;
 
-            if (tag == "RECIPE")
-            {
-            }
-            else if ( tag == "EQUIPMENT" )
-            {
-               for(int i = 0; i < list.count(); ++i )
-               {
-                  Equipment* temp = m_beerxml->equipmentFromXml( list.at(i) );
-                  if ( ! temp->isValid() )
-                     ret = false;
-               }
-            }
-            else if( tag == "FERMENTABLE" )
-            {
-               for( int i = 0; i < list.count(); ++i )
-               {
-                  Fermentable* temp = m_beerxml->fermentableFromXml( list.at(i) );
-                  if ( ! temp->isValid() )
-                     ret = false;
-               }
+         ImportRecord record;
+         record.element = m_beerxml->readRecord(xml, record.doc);
+         reading->records.append(record);
 
-            }
-            else if (tag == "HOP")
-            {
-               for(int i = 0; i < list.count(); ++i )
-               {
-                  Hop* temp = m_beerxml->hopFromXml( list.at(i) );
-                  if ( ! temp->isValid() )
-                     ret = false;
-               }
-            }
-            else if (tag == "MISC")
-            {
-               for(int i = 0; i < list.count(); ++i )
-               {
-                  Misc* temp = m_beerxml->miscFromXml( list.at(i) );
-                  if ( ! temp->isValid() )
-                     ret = false;
-               }
-            }
-            else if( tag == "STYLE" )
-            {
-               for( int i = 0; i < list.count(); ++i )
-               {
-                  Style* temp = m_beerxml->styleFromXml( list.at(i) );
-                  if ( ! temp->isValid() )
-                     ret = false;
-               }
-            }
-            else if (tag == "YEAST")
-            {
-               for(int i = 0; i < list.count(); ++i )
-               {
-                  Yeast* temp = m_beerxml->yeastFromXml( list.at(i) );
-                  if ( ! temp->isValid() )
-                     ret = false;
-               }
-            }
-            else if( tag == "WATER" )
-            {
-               for( int i = 0; i < list.count(); ++i )
-               {
-                  Water* temp = m_beerxml->waterFromXml( list.at(i) );
-                  if ( ! temp->isValid() )
-                     ret = false;
-               }
-            }
-            else if( tag == "MASHS" )
-            {
-               for( int i = 0; i < list.count(); ++i )
-               {
-                  Mash* temp = m_beerxml->mashFromXml( list.at(i) );
-                  if ( ! temp->isValid() )
-                     ret = false;
-               }
-            }
+         if ( reading->records.size() == batchSize ) {
+            startParsing();
+            reading.reset(new ImportBatch);
+            write();
+         }
+
+         // Don't flood the receivers; once per percent is plenty.
+         int percent = total > 0 ? static_cast<int>(100 * inFile.pos() / total) : 100;
+         if ( percent != lastPercent ) {
+            lastPercent = percent;
+            emit importProgress(inFile.pos(), total);
+         }
+      }
+
+      // Whatever is left
+      startParsing();
+      write();
+      writing = std::move(parsing);
+      write();
+   }
+   catch (QString e) {
+      // Nothing of the file survives, so there is no point going on
+      qCritical() << Q_FUNC_INFO << e;
+      endImport(false);
+      emit importProgress(total, total);
+      throw;
+   }
+
+   if ( xml.hasError() ) {
+      qWarning() << QString("Database::importFromXML: Bad document formatting in %1 %2:%3. %4")
+                    .arg(filename).arg(xml.lineNumber()).arg(xml.columnNumber()).arg(xml.errorString());
+      ret = false;
+   }
+
+   if ( ! endImport() )
+      ret = false;
+
+   emit importProgress(total, total);
+   return ret;
+}
+
+void Database::beginImport()
+{
+   if ( m_importDepth++ > 0 )
+      return;
+
+   // Anything already queued is not part of the import
+   flush();
+   m_importFailed = false;
+   m_importInserted.clear();
+   sqlDatabase().transaction();
+}
+
+bool Database::endImport(bool commit)
+{
+   if ( m_importDepth == 0 ) {
+      qWarning() << Q_FUNC_INFO << "no import session to end";
+      return false;
+   }
+   if ( --m_importDepth > 0 )
+      return true;
+
+   // The queue's writes belong in the session too
+   flush();
+
+   QList<Ingredient*> added, inserted;
+   QStringList lists;
+   added.swap(m_importAdded);
+   inserted.swap(m_importInserted);
+   lists.swap(m_importLists);
+   m_importHeld.clear();
+
+   // Whatever was held back should have been noted as it was inserted, but
+   // make sure nothing of the session outlives a rollback
+   QSet<Ingredient*> noted = inserted.toSet();
+   foreach( Ingredient* element, added ) {
+      if ( ! noted.contains(element) )
+         inserted.append(element);
+   }
+
+   if ( ! commit || m_importFailed ) {
+      qWarning() << Q_FUNC_INFO << "rolling back the import";
+      sqlDatabase().rollback();
+      m_importFailed = false;
+      forgetElements(inserted);
+      return false;
+   }
+
+   if ( ! sqlDatabase().commit() ) {
+      qCritical() << Q_FUNC_INFO << "could not commit the import:" << sqlDatabase().lastError().text();
+      sqlDatabase().rollback();
+      forgetElements(inserted);
+      return false;
+   }
+   noteWrite();
+
+   foreach( QString const& list, lists )
+      emit changed( metaProperty(list.toLatin1().constData()), QVariant() );
+   if ( ! added.isEmpty() )
+      emit elementsAdded(added);
+
+   return true;
+}
+
+namespace {
+   //! Takes anything in \b gone out of the lists of a recipe index.
+   template <class T> void dropFromRecipeIndex( QHash< int, QList<T*> >& index, QSet<Ingredient*> const& gone )
+   {
+      for ( typename QHash< int, QList<T*> >::iterator i = index.begin(); i != index.end(); ++i ) {
+         QMutableListIterator<T*> j(i.value());
+         while ( j.hasNext() ) {
+            if ( gone.contains(j.next()) )
+               j.remove();
          }
       }
    }
+}
+
+void Database::noteImportInsert( Ingredient* element )
+{
+   if ( m_importDepth > 0 && QThread::currentThread() == thread() )
+      m_importInserted.append(element);
+}
+
+void Database::forgetElements( QList<Ingredient*> const& elements )
+{
+   QSet<Ingredient*> gone;
+
+   foreach( Ingredient* element, elements ) {
+      int key = element->_key;
+
+      switch( element->table() ) {
+         case Brewtarget::BREWNOTETABLE:    allBrewNotes.remove(key); break;
+         case Brewtarget::EQUIPTABLE:       allEquipments.remove(key); break;
+         case Brewtarget::FERMTABLE:        allFermentables.remove(key); break;
+         case Brewtarget::HOPTABLE:         allHops.remove(key); break;
+         case Brewtarget::INSTRUCTIONTABLE: allInstructions.remove(key); break;
+         case Brewtarget::MASHTABLE:        allMashs.remove(key); break;
+         case Brewtarget::MASHSTEPTABLE:    allMashSteps.remove(key); break;
+         case Brewtarget::MISCTABLE:        allMiscs.remove(key); break;
+         case Brewtarget::STYLETABLE:       allStyles.remove(key); break;
+         case Brewtarget::WATERTABLE:       allWaters.remove(key); break;
+         case Brewtarget::SALTTABLE:        allSalts.remove(key); break;
+         case Brewtarget::YEASTTABLE:       allYeasts.remove(key); break;
+         case Brewtarget::RECTABLE:
+            allRecipes.remove(key);
+            m_recipeFermentables.remove(key);
+            m_recipeHops.remove(key);
+            m_recipeMiscs.remove(key);
+            m_recipeYeasts.remove(key);
+            m_recipeWaters.remove(key);
+            m_recipeSalts.remove(key);
+            break;
+         default: break;
+      }
+      unindexName( element->table(), key );
+      if ( element->table() != Brewtarget::RECTABLE )
+         gone.insert(element);
+   }
+
+   // Copies made by addToRecipe() can be listed under a recipe that stays
+   if ( ! gone.isEmpty() ) {
+      dropFromRecipeIndex(m_recipeFermentables, gone);
+      dropFromRecipeIndex(m_recipeHops, gone);
+      dropFromRecipeIndex(m_recipeMiscs, gone);
+      dropFromRecipeIndex(m_recipeYeasts, gone);
+      dropFromRecipeIndex(m_recipeWaters, gone);
+      dropFromRecipeIndex(m_recipeSalts, gone);
+   }
+
+   // Only once nothing can find them any more
+   qDeleteAll(elements);
+}
+
+bool Database::importing() const
+{
+   return m_importDepth > 0;
+}
+
+bool Database::holdNewElement( Ingredient* element, char const* listProperty )
+{
+   if ( m_importDepth == 0 || QThread::currentThread() != thread() )
+      return false;
+
+   // BeerXML holds the things it creates as well as insertElement() does
+   if ( ! m_importHeld.contains(element) ) {
+      m_importHeld.insert(element);
+      m_importAdded.append(element);
+   }
+   if ( ! m_importLists.contains(QLatin1String(listProperty)) )
+      m_importLists.append(QLatin1String(listProperty));
+   return true;
+}
+
+bool Database::beginTransaction()
+{
+   if ( m_importDepth > 0 && QThread::currentThread() == thread() )
+      return true;
+
+   bool ret = sqlDatabase().transaction();
+   // Remember the queue, so a rollback can put it back as it was
+   if ( ret && QThread::currentThread() == thread() ) {
+      m_transactionWrites = m_pendingWrites;
+      m_transactionOpen = true;
+   }
+   return ret;
+}
+
+bool Database::commitTransaction()
+{
+   if ( m_importDepth > 0 && QThread::currentThread() == thread() )
+      return true;
+
+   // What is queued goes out with the rest of the transaction
+   if ( QThread::currentThread() == thread() ) {
+      try {
+         flush();
+      }
+      catch (QString e) {
+         qCritical() << QString("%1 %2").arg(Q_FUNC_INFO).arg(e);
+         rollbackTransaction();
+         return false;
+      }
+   }
+   bool ret = sqlDatabase().commit();
+   noteWrite();
+   if ( QThread::currentThread() == thread() ) {
+      m_transactionWrites.clear();
+      m_transactionOpen = false;
+   }
    return ret;
 }
 
+bool Database::rollbackTransaction()
+{
+   if ( m_importDepth > 0 && QThread::currentThread() == thread() ) {
+      m_importFailed = true;
+      return true;
+   }
+
+   // What was queued inside the transaction goes with it. Whatever was
+   // queued before it began, flushed into it or not, is queued again.
+   if ( m_transactionOpen && QThread::currentThread() == thread() ) {
+      m_pendingWrites.swap(m_transactionWrites);
+      m_transactionWrites.clear();
+      m_transactionOpen = false;
+      if ( m_pendingWrites.isEmpty() )
+         m_writeBehindTimer.stop();
+      else if ( ! m_writeBehindTimer.isActive() )
+         m_writeBehindTimer.start();
+   }
+   return sqlDatabase().rollback();
+}
+
 //+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 
 QMap<QString, std::function<Ingredient*(QString name)> > Database::makeTableParams()
@@ -3639,12 +4875,229 @@ QMap<QString, std::function<Ingredient*(QString name)> > Database::makeTablePara
    return tmp;
 }
 
-void Database::updateDatabase(QString const& filename)
+Database::MergeCounts Database::updateDatabase(QString const& filename)
+{
+   MergeCounts counts;
+   bool bySet = false;
+
+   // Both merges read and rewrite whole tables
+   flush();
+
+   // The set based merge needs UPDATE ... FROM, which SQLite has had since 3.33
+   if ( Brewtarget::dbType() == Brewtarget::SQLITE ) {
+      QSqlQuery q( "SELECT sqlite_version()", sqlDatabase() );
+      if ( q.next() )
+         bySet = QVersionNumber::fromString(q.value(0).toString()) >= QVersionNumber(3, 33);
+      q.finish();
+   }
+
+   try {
+      if ( bySet )
+         mergeBySet(filename, counts);
+      else
+         mergeByRow(filename, counts);
+   }
+   catch (QString e) {
+      qCritical() << QString("%1 %2").arg(Q_FUNC_INFO).arg(e);
+      abort();
+   }
+
+   qInfo() << QString("%1 merged %2, updated %3 and skipped %4 ingredients from %5")
+              .arg(Q_FUNC_INFO).arg(counts.merged).arg(counts.updated).arg(counts.skipped).arg(filename);
+   return counts;
+}
+
+void Database::mergeBySet(QString const& filename, MergeCounts& counts)
+{
+   // In the naming here "main" is our local database, and "merge" is the
+   // one coming from 'filename'.
+   QSqlQuery q( sqlDatabase() );
+
+   // ATTACH doesn't work inside a transaction, so it goes around the session
+   q.prepare("ATTACH DATABASE :file AS merge");
+   q.bindValue(":file", filename);
+   if ( ! q.exec() ) {
+      if ( Brewtarget::isInteractive() )
+         QMessageBox::critical(nullptr,
+                               QObject::tr("Database Failure"),
+                               QString(QObject::tr("Failed to open the database '%1'.").arg(filename)));
+      throw QString("Could not attach %1: %2").arg(filename).arg(q.lastError().text());
+   }
+
+   // Everything from here on goes in or nothing does
+   beginImport();
+
+   auto run = [&q](QString const& statement) {
+      if ( ! q.exec(statement) )
+         throw QString("%1 %2").arg(statement).arg(q.lastError().text());
+   };
+
+   try {
+      foreach( TableSchema* tbl, dbDefn->baseTables() )
+      {
+         TableSchema* btTbl = dbDefn->btTable(tbl->dbTable());
+         // not all tables have bt* tables
+         if ( btTbl == nullptr ) {
+            continue;
+         }
+
+         QString table = tbl->tableName();
+         QString key = tbl->keyName();
+         QString btTable = btTbl->tableName();
+         QString btKey = btTbl->keyName();
+         QString child = btTbl->childIndexName();
+
+         // Only the columns both databases have. Anything they are missing
+         // is left alone on an update, and gets its default on an insert.
+         QStringList theirs;
+         run( QString("PRAGMA merge.table_info(%1)").arg(table) );
+         while( q.next() )
+            theirs.append( q.value(1).toString() );
+
+         QStringList columns;
+         foreach( QString const& col, tbl->allColumnNames() ) {
+            if ( theirs.contains(col, Qt::CaseInsensitive) )
+               columns.append(col);
+         }
+         if ( columns.isEmpty() )
+            continue;
+
+         // UPDATE hop SET name = n.name, ... FROM bt_hop ob
+         //    JOIN merge.bt_hop nb ON nb.id = ob.id JOIN merge.hop n ON n.id = nb.hop_id
+         //    WHERE hop.id = ob.hop_id
+         QStringList sets, newColumns;
+         foreach( QString const& col, columns ) {
+            sets.append( QString("%1 = n.%1").arg(col) );
+            newColumns.append( QString("n.%1").arg(col) );
+         }
+         run( QString("UPDATE main.%1 SET %2 FROM main.%3 ob "
+                      "JOIN merge.%3 nb ON nb.%4 = ob.%4 JOIN merge.%1 n ON n.%5 = nb.%6 "
+                      "WHERE %1.%5 = ob.%6")
+              .arg(table).arg(sets.join(", ")).arg(btTable).arg(btKey).arg(key).arg(child) );
+         counts.updated += q.numRowsAffected();
+
+         // Whatever they have that we don't is new, unless the user already
+         // has an ingredient by that name that did not come from there.
+         QSet<int> linked;
+         run( QString("SELECT %1 FROM main.%2").arg(child).arg(btTable) );
+         while( q.next() )
+            linked.insert( q.value(0).toInt() );
+
+         // Only what the user sees in the trees counts as having it. The
+         // hidden copies recipes hold of their ingredients do not.
+         QSet<int> parents;
+         run( QString("SELECT %1 FROM main.%2 WHERE %3 = %4 AND %5 = %6")
+              .arg(key).arg(table)
+              .arg(tbl->propertyToColumn(PropertyNames::Ingredient::display)).arg(Brewtarget::dbTrue())
+              .arg(tbl->propertyToColumn(PropertyNames::Ingredient::deleted)).arg(Brewtarget::dbFalse()) );
+         while( q.next() )
+            parents.insert( q.value(0).toInt() );
+
+         QStringList skip;
+         run( QString("SELECT nb.%1, n.%2 FROM merge.%3 nb JOIN merge.%4 n ON n.%5 = nb.%6 "
+                      "WHERE nb.%1 NOT IN (SELECT %1 FROM main.%3)")
+              .arg(btKey).arg(tbl->propertyToColumn(PropertyNames::Ingredient::name))
+              .arg(btTable).arg(table).arg(key).arg(child) );
+         QList< QPair<int,QString> > candidates;
+         while( q.next() )
+            candidates.append( qMakePair(q.value(0).toInt(), q.value(1).toString()) );
+         for ( auto const& candidate : candidates ) {
+            foreach( int local, keysByName(tbl->dbTable(), candidate.second) ) {
+               if ( parents.contains(local) && ! linked.contains(local) ) {
+                  skip.append( QString::number(candidate.first) );
+                  break;
+               }
+            }
+         }
+         counts.skipped += skip.size();
+
+         // Number the new ones 1, 2, ... in a scratch table, so their keys
+         // here are known before they are inserted.
+         run( "DROP TABLE IF EXISTS temp.merge_map" );
+         run( "CREATE TEMP TABLE merge_map (seq INTEGER PRIMARY KEY, bt_id INTEGER, child_id INTEGER)" );
+         run( QString("INSERT INTO temp.merge_map (bt_id, child_id) SELECT nb.%1, nb.%2 "
+                      "FROM merge.%3 nb JOIN merge.%4 n ON n.%5 = nb.%2 "
+                      "WHERE nb.%1 NOT IN (SELECT %1 FROM main.%3)%6 ORDER BY nb.%1")
+              .arg(btKey).arg(child).arg(btTable).arg(table).arg(key)
+              .arg(skip.isEmpty() ? QString() : QString(" AND nb.%1 NOT IN (%2)").arg(btKey).arg(skip.join(","))) );
+
+         // Past the keys of deleted rows too, which undo may still know
+         run( "SELECT COUNT(*) FROM temp.merge_map" );
+         int count = q.next() ? q.value(0).toInt() : 0;
+         int lastKey = reserveKeys(q, tbl, count);
+
+         // The inventory rows, if this kind of thing has them
+         QString invColumn, invValue;
+         if ( tbl->invTable() != Brewtarget::NOTABLE ) {
+            TableSchema* inv = dbDefn->table(tbl->invTable());
+            int lastInv = reserveKeys(q, inv, count);
+            run( QString("INSERT INTO main.%1 (%2) SELECT %3 + seq FROM temp.merge_map")
+                 .arg(inv->tableName()).arg(inv->keyName()).arg(lastInv) );
+            invColumn = QString(", %1").arg(tbl->foreignKeyToColumn(kpropInventoryId));
+            invValue = QString(", %1 + m.seq").arg(lastInv);
+         }
+
+         run( QString("INSERT INTO main.%1 (%2, %3%4) SELECT %5 + m.seq, %6%7 "
+                      "FROM temp.merge_map m JOIN merge.%1 n ON n.%2 = m.child_id ORDER BY m.seq")
+              .arg(table).arg(key).arg(columns.join(", ")).arg(invColumn)
+              .arg(lastKey).arg(newColumns.join(", ")).arg(invValue) );
+         counts.merged += q.numRowsAffected();
+
+         run( QString("INSERT INTO main.%1 (%2, %3) SELECT bt_id, %4 + seq FROM temp.merge_map")
+              .arg(btTable).arg(btKey).arg(child).arg(lastKey) );
+
+         // The names have moved about; rebuild the index when it's next asked for
+         m_nameIndex.remove(tbl->dbTable());
+
+         switch( tbl->dbTable() ) {
+            case Brewtarget::EQUIPTABLE:
+               populateNewElements(allEquipments, tbl->dbTable(), lastKey, "equipments");
+               break;
+            case Brewtarget::FERMTABLE:
+               populateNewElements(allFermentables, tbl->dbTable(), lastKey, "fermentables");
+               break;
+            case Brewtarget::HOPTABLE:
+               populateNewElements(allHops, tbl->dbTable(), lastKey, "hops");
+               break;
+            case Brewtarget::MISCTABLE:
+               populateNewElements(allMiscs, tbl->dbTable(), lastKey, "miscs");
+               break;
+            case Brewtarget::STYLETABLE:
+               populateNewElements(allStyles, tbl->dbTable(), lastKey, "styles");
+               break;
+            case Brewtarget::YEASTTABLE:
+               populateNewElements(allYeasts, tbl->dbTable(), lastKey, "yeasts");
+               break;
+            case Brewtarget::WATERTABLE:
+               populateNewElements(allWaters, tbl->dbTable(), lastKey, "waters");
+               break;
+            default:
+               break;
+         }
+      }
+      run( "DROP TABLE IF EXISTS temp.merge_map" );
+   }
+   catch (QString e) {
+      q.finish();
+      endImport(false);
+      q.exec("DETACH DATABASE merge");
+      throw;
+   }
+
+   q.finish();
+   bool committed = endImport();
+   q.exec("DETACH DATABASE merge");
+   if ( ! committed )
+      throw QString("Could not commit the merge from %1").arg(filename);
+}
+
+void Database::mergeByRow(QString const& filename, MergeCounts& counts)
 {
    // In the naming here "old" means our local database, and
    // "new" means the database coming from 'filename'.
 
    QVariant btid, newid, oldid;
+   QString newName;
    QMap<QString, std::function<Ingredient*(QString name)> >  makeObject = makeTableParams();
 
    try {
@@ -3697,6 +5150,25 @@ void Database::updateDatabase(QString const& filename)
                                   .arg(btTbl->keyName())
                                   .arg(btTbl->childIndexName()));
 
+         // Local ingredients that already came from the default db
+         QSet<int> linked;
+         QSqlQuery qOldLinks( QString("SELECT %1 FROM %2").arg(btTbl->childIndexName()).arg(btTbl->tableName()), sqlDatabase() );
+         while( qOldLinks.next() )
+            linked.insert( qOldLinks.value(0).toInt() );
+         qOldLinks.finish();
+
+         // Only what the user sees in the trees counts as having it. The
+         // hidden copies recipes hold of their ingredients do not.
+         QSet<int> parents;
+         QSqlQuery qParents( QString("SELECT %1 FROM %2 WHERE %3 = %4 AND %5 = %6")
+                                .arg(tbl->keyName()).arg(tbl->tableName())
+                                .arg(tbl->propertyToColumn(PropertyNames::Ingredient::display)).arg(Brewtarget::dbTrue())
+                                .arg(tbl->propertyToColumn(PropertyNames::Ingredient::deleted)).arg(Brewtarget::dbFalse()),
+                             sqlDatabase() );
+         while( qParents.next() )
+            parents.insert( qParents.value(0).toInt() );
+         qParents.finish();
+
          while( qNewBtIng.next() ) {
             btid = qNewBtIng.record().value(btTbl->keyName());
             newid = qNewBtIng.record().value(btTbl->childIndexName());
@@ -3717,6 +5189,7 @@ void Database::updateDatabase(QString const& filename)
                }
                qUpdateOldIng.bindValue( QString(":%1").arg(pn), qNewIng.record().value(pn));
             }
+            newName = qNewIng.record().value(tbl->propertyToColumn(PropertyNames::Ingredient::name)).toString();
 
             // Done retrieving new ingredient data.
             qNewIng.finish();
@@ -3732,7 +5205,7 @@ void Database::updateDatabase(QString const& filename)
 
             // If the btid exists in the old bt_hop table, do an update.
             if( qOldBtIng.next() ) {
-               oldid = qOldBtIng.record().value( btTbl->keyName() );
+               oldid = qOldBtIng.record().value( btTbl->childIndexName() );
                qOldBtIng.finish();
 
                qUpdateOldIng.bindValue( ":id", oldid );
@@ -3743,12 +5216,30 @@ void Database::updateDatabase(QString const& filename)
                            .arg(qUpdateOldIng.lastQuery())
                            .arg(qUpdateOldIng.lastError().text());
 
+               indexName( tbl->dbTable(), oldid.toInt(), newName );
+               ++counts.updated;
             }
             // If the btid doesn't exist in the old bt_ table, do an insert into
             // the new table, then into the new bt_ table.
             else {
+               qOldBtIng.finish();
+
+               // If the user already has an ingredient by that name that did
+               // not come from here, leave it alone rather than add a twin.
+               bool haveIt = false;
+               foreach( int key, keysByName(tbl->dbTable(), newName) ) {
+                  if ( parents.contains(key) && ! linked.contains(key) ) {
+                     haveIt = true;
+                     break;
+                  }
+               }
+               if ( haveIt ) {
+                  ++counts.skipped;
+                  continue;
+               }
+
                // Create a new ingredient.
-               oldid = makeObject.value(tbl->tableName())(qNewBtIng.record().value(PropertyNames::Ingredient::name).toString())->_key;
+               oldid = makeObject.value(tbl->tableName())(newName)->_key;
 
                // Copy in the new data.
                qUpdateOldIng.bindValue( ":id", oldid );
@@ -3758,7 +5249,9 @@ void Database::updateDatabase(QString const& filename)
                            .arg(oldid.toInt())
                            .arg(qUpdateOldIng.lastQuery())
                            .arg(qUpdateOldIng.lastError().text());
-
+               indexName( tbl->dbTable(), oldid.toInt(), newName );
+               linked.insert( oldid.toInt() );
+               ++counts.merged;
 
                // Insert an entry into our bt_<ingredient> table.
                qOldBtIngInsert.bindValue( ":id", btid );
@@ -3773,13 +5266,11 @@ void Database::updateDatabase(QString const& filename)
          }
       }
       // If we, by some miracle, get here, commit
-      sqlDatabase().commit();
-      // I think
+      commitTransaction();
    }
    catch (QString e) {
-      qCritical() << QString("%1 %2").arg(Q_FUNC_INFO).arg(e);
-      sqlDatabase().rollback();
-      abort();
+      rollbackTransaction();
+      throw;
    }
 }
 
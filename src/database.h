@@ -35,6 +35,7 @@ class Database;
 #include <QHash>
 #include <QFile>
 #include <QString>
+#include <QStringList>
 #include <QSqlRecord>
 #include <QSqlQuery>
 #include <QVariant>
@@ -42,11 +43,16 @@ class Database;
 #include <QUndoStack>
 #include <QObject>
 #include <QPair>
+#include <QSet>
 #include <QTableView>
 #include <QSqlError>
 #include <QDebug>
 #include <QRegExp>
 #include <QMap>
+#include <QTimer>
+#include <QAtomicInt>
+#include <QSemaphore>
+#include <QThreadStorage>
 #include "ingredient.h"
 #include "brewtarget.h"
 #include "recipe.h"
@@ -119,7 +125,70 @@ public:
                                    QString const& password="brewtarget");
    bool loadSuccessful();
 
+   /*!
+    * \brief Sets \b propName of \b object to \b value.
+    *
+    * On the thread that owns the Database, the write goes into the
+    * write-behind queue rather than straight to the database. Repeated
+    * writes to the same cell are coalesced, and the queue is written out in
+    * one transaction a little later, or as soon as anything else needs the
+    * database. \b transact forces the queue out before returning.
+    */
    void updateEntry( Ingredient* object, QString propName, QVariant value, bool notify = true, bool transact = false );
+   //! \brief Same as above, but skips converting \b propName. The PropertyNames constants land here.
+   void updateEntry( Ingredient* object, char const* propName, QVariant value, bool notify = true, bool transact = false );
+   //! \brief Writes several properties of \b object together, without notifying.
+   void updateEntries( Ingredient* object, QVariantMap const& values );
+
+   /*!
+    * \brief Writes out everything in the write-behind queue.
+    *
+    * Called automatically before anything here reads a table with queued
+    * writes, and on commit and unload. Should be called explicitly before
+    * anything that reads the database file behind our back (backups,
+    * exports, shutdown).
+    */
+   void flush();
+
+   /*!
+    * \brief Folds the write-ahead log back into the database file. Does
+    *        nothing unless the SQLite database is in WAL mode.
+    *
+    * The idle timer does a passive checkpoint by itself. \b truncate waits
+    * for readers and empties the log, which is what anything copying the
+    * database file needs.
+    */
+   void checkpoint(bool truncate = false);
+
+   /*!
+    * \brief A connection for threads that only read, eg reports, exports and
+    *        batch calculations.
+    *
+    * In WAL mode this is a read-only connection of the calling thread's own,
+    * which sees the last commit and never holds up the writer. Otherwise,
+    * and on the thread that owns the Database, it is just sqlDatabase().
+    */
+   static QSqlDatabase readOnlyDatabase();
+
+   //! \brief How sqlDatabase() and readOnlyDatabase() have been getting on.
+   struct ConnectionStats {
+      //! Connections opened
+      int created = 0;
+      //! Calls that got a connection the thread already had
+      int reused = 0;
+      //! Worker connections closed because their thread finished
+      int released = 0;
+      //! Times a worker thread had to wait for a free connection
+      int waits = 0;
+      //! Connections open right now
+      int open = 0;
+   };
+   static ConnectionStats connectionStats();
+
+   //! \returns how many times a prepared statement was found in the statement cache.
+   quint64 statementCacheHits() const;
+   //! \returns how many times a statement had to be prepared because it was not in the cache.
+   quint64 statementCacheMisses() const;
 
    //! \brief Get the contents of the cell specified by table/key/col_name
    QVariant get( Brewtarget::DBTable table, int key, QString col_name );
@@ -156,6 +225,8 @@ public:
 
       T* tmp = new T(table, key);
       all->insert(tmp->_key,tmp);
+      indexName(table, key, tmp->name());
+      noteImportInsert(tmp);
 
       return tmp;
    }
@@ -189,6 +260,8 @@ public:
 
       T* tmp = new T(tbl->dbTable(), key);
       all->insert(tmp->_key,tmp);
+      indexName(tbl->dbTable(), key, name);
+      noteImportInsert(tmp);
 
       return tmp;
    }
@@ -263,7 +336,7 @@ public:
    void setInventory(Ingredient* ins, QVariant value, int invKey = 0, bool notify=true );
 
    //! \returns The entire inventory for a table.
-   QMap<int, double> getInventory(const Brewtarget::DBTable table) const;
+   QMap<int, double> getInventory(const Brewtarget::DBTable table);
 
    QVariant getInventoryAmt(QString col_name, Brewtarget::DBTable table, int key);
 
@@ -271,9 +344,48 @@ public:
 
    //! \brief Copies all of the mashsteps from \c oldMash to \c newMash
    void duplicateMashSteps(Mash *oldMash, Mash *newMash);
-   //! Import ingredients from BeerXML documents.
+   /*!
+    * \brief Import ingredients from BeerXML documents.
+    *
+    * The file is streamed a record at a time, so memory use does not grow
+    * with the size of the file. importProgress() is emitted as it goes.
+    * The whole file is one import session.
+    */
    bool importFromXML(const QString& filename);
 
+   /*!
+    * \brief Starts an import session.
+    *
+    * Until the matching endImport(), everything runs in a single transaction
+    * and the new*Signal()s are held back. Sessions nest; only the outermost
+    * one does anything.
+    */
+   void beginImport();
+   /*!
+    * \brief Ends an import session.
+    *
+    * Commits if \b commit is true and nothing asked for a rollback during
+    * the session; otherwise the whole session is rolled back. On commit,
+    * everything the session created is announced with one elementsAdded().
+    * On rollback, it is forgotten and deleted.
+    * \returns true if the session was committed
+    */
+   bool endImport(bool commit = true);
+   //! \brief True between beginImport() and endImport().
+   bool importing() const;
+
+   //! \brief The members of \b elements that are \b T s. Handy in elementsAdded() receivers.
+   template<class T> static QList<T*> elementsOfType( QList<Ingredient*> const& elements )
+   {
+      QList<T*> ret;
+      foreach( Ingredient* element, elements ) {
+         T* t = qobject_cast<T*>(element);
+         if ( t )
+            ret.append(t);
+      }
+      return ret;
+   }
+
    //! Get anything by key value.
    Recipe* recipe(int key);
    Equipment* equipment(int key);
@@ -457,11 +569,21 @@ public:
    //! Get the file where this database was loaded from.
    static QString getDbFileName();
 
+   //! \brief What updateDatabase() did.
+   struct MergeCounts {
+      //! Ingredients that were new to us and were added
+      int merged = 0;
+      //! Ingredients we already had from there, brought up to date
+      int updated = 0;
+      //! New ingredients left out, because the user already has one by that name
+      int skipped = 0;
+   };
+
    /*!
     * Updates the brewtarget-provided ingredients from the given sqlite
     * database file.
     */
-   void updateDatabase(QString const& filename);
+   MergeCounts updateDatabase(QString const& filename);
    void convertFromXml();
 
    bool isConverted();
@@ -508,6 +630,17 @@ signals:
    // Sigh
    void changedInventory(Brewtarget::DBTable,int,QVariant);
 
+   //! \brief importFromXML() has read \b bytesRead of the \b bytesTotal in its file.
+   void importProgress(qint64 bytesRead, qint64 bytesTotal);
+
+   /*!
+    * \brief An import session committed, having created \b added.
+    *
+    * Sent instead of the new*Signal()s for those elements, so that views can
+    * take them all in at once.
+    */
+   void elementsAdded(QList<Ingredient*> const& added);
+
 private slots:
    //! Load database from file.
    bool load();
@@ -523,6 +656,8 @@ private:
    static QFile dataDbFile;
    static QString dataDbFileName;
    static QString dbConName;
+   //! The SQLite database is in WAL mode, rather than exclusively locked.
+   static bool dbWal;
 
    // And these are for Postgres databases -- are these really required? Are
    // the sqlite ones really required?
@@ -535,8 +670,46 @@ private:
 
    // Each thread should have its own connection to QSqlDatabase.
    static QHash< QThread*, QString > _threadToConnection;
+   //! The same for readOnlyDatabase(). Also guarded by _threadToConnectionMutex.
+   static QHash< QThread*, QString > _threadToReadConnection;
    static QMutex _threadToConnectionMutex;
 
+   /*!
+    * \brief A worker thread's connection, kept in thread local storage so
+    *        the thread finds it again without the mutex. It is closed, and
+    *        its pool slot given back, when the thread finishes.
+    */
+   struct ThreadConnection {
+      ThreadConnection(QString const& name, bool readOnly, QSqlDatabase const& db);
+      ~ThreadConnection();
+
+      QString name;
+      bool readOnly;
+      QSqlDatabase db;
+      //! Which load of the database it belongs to
+      int generation;
+   };
+   static QThreadStorage<ThreadConnection*> _threadConnection;
+   static QThreadStorage<ThreadConnection*> _threadReadConnection;
+   //! Bounds how many connections worker threads can have open at once.
+   static QSemaphore _connectionSlots;
+   static QAtomicInt _connectionsCreated;
+   static QAtomicInt _connectionsReused;
+   static QAtomicInt _connectionsReleased;
+   static QAtomicInt _connectionWaits;
+   //! Bumped by unload(), which leaves every worker's connection stale.
+   static QAtomicInt _connectionGeneration;
+   //! Worker connections holding a slot in _connectionSlots.
+   static int _workerConnections;
+
+   //! \brief Takes a slot in the pool for a worker's connection, waiting if need be.
+   static void acquireConnectionSlot();
+   //! \brief Opens a connection called \b conName to whichever database we use.
+   static QSqlDatabase openConnection( QString const& conName, bool readOnly );
+
+   //! The owning thread's connection, which it gets without the mutex.
+   QSqlDatabase m_ownerConnection;
+
    // Instance variables.
    bool loadWasSuccessful;
    bool converted;
@@ -561,27 +734,222 @@ private:
    QHash< int, Water* > allWaters;
    QHash< int, Salt* > allSalts;
    QHash< int, Yeast* > allYeasts;
-   QHash<QString,QSqlQuery> selectSome;
+   /*!
+    * \brief What a cached statement is for.
+    *
+    * Together with the table, and the column for the kinds that need one,
+    * this is enough to know the SQL without building it.
+    */
+   enum StatementKind {
+      SelectColumn,     //!< SELECT col FROM tbl WHERE id=:id
+      UpdateColumn,     //!< UPDATE tbl SET col=:value WHERE id=:id
+      SelectRow,        //!< SELECT * FROM tbl WHERE id=:id
+      InsertCopy,       //!< INSERT INTO tbl (every column but id) VALUES (...)
+      InsertProperties, //!< TableSchema::generateInsertProperties()
+      SelectInventory,  //!< col of the inventory row of ingredient :id
+      UpdateInventory   //!< UPDATE inventory tbl SET amount=:value WHERE id=:id
+   };
+
+   //! \brief Identifies a statement in the cache.
+   struct StatementKey {
+      StatementKind kind;
+      TableSchema const* table;
+      QString column;
+
+      bool operator==(StatementKey const& other) const {
+         return kind == other.kind && table == other.table && column == other.column;
+      }
+   };
+   friend uint qHash(StatementKey const& key, uint seed);
+
+   //! Prepared statements, per connection (and so per thread).
+   QHash< QString, QHash<StatementKey,QSqlQuery> > m_statements;
+   mutable QMutex m_statementsMutex;
+   quint64 m_statementHits;
+   quint64 m_statementMisses;
+
+   /*!
+    * \brief Returns the prepared statement for \b kind on \b table and
+    *        \b column, on the calling thread's connection.
+    *
+    * \b makeSql is only called, and the statement only prepared, the first
+    * time this key is asked for on the connection. The returned query shares
+    * its state with the cached one, so bind, exec and finish() it.
+    */
+   QSqlQuery preparedStatement( StatementKind kind, TableSchema const* table, QString const& column,
+                                std::function<QString()> makeSql );
+
+   //! \brief What updateEntry() turns a property name into.
+   struct ResolvedColumn {
+      int metaIndex;
+      PropertySchema const* prop;
+      QString column;
+   };
+   //! Keyed by class and property name. Only used on the thread that owns the Database.
+   QHash< QPair<QMetaObject const*,QByteArray>, ResolvedColumn > m_resolvedColumns;
+   //! \brief Looks \b propName up in the schema, throwing if it has no column.
+   ResolvedColumn resolveColumn( TableSchema* schema, QMetaObject const* meta, char const* propName );
+
+   //! A property write waiting in the write-behind queue.
+   struct PendingWrite {
+      TableSchema* table = nullptr;
+      int key = 0;
+      QString column;
+      QVariant value;
+   };
+   //! Keyed by column and row so repeated writes to a cell coalesce.
+   QHash< QPair<PropertySchema const*,int>, PendingWrite > m_pendingWrites;
+   QTimer m_writeBehindTimer;
+   bool m_flushingWrites;
+   //! The queue as it was when beginTransaction() opened a transaction.
+   QHash< QPair<PropertySchema const*,int>, PendingWrite > m_transactionWrites;
+   bool m_transactionOpen;
+
+   //! Runs checkpoint() once nothing has been written for a while.
+   QTimer m_checkpointTimer;
+   //! \brief Something was committed; put the checkpoint off again.
+   void noteWrite();
+
+   //! \brief Flushes the queue if any of it is for \b table, so a read of \b table sees it. Never throws.
+   void readBarrier( Brewtarget::DBTable table );
+   //! \brief Adds a write to the queue and makes sure a flush is coming.
+   void queueWrite( TableSchema* table, PropertySchema const* prop, QString const& column, int key,
+                    QVariant const& value );
+
+   //! Nesting depth of beginImport() calls.
+   int m_importDepth;
+   //! Something asked for a rollback during the import session.
+   bool m_importFailed;
+   //! What the import session created, in the order it was created.
+   QList<Ingredient*> m_importAdded;
+   //! The same, for telling whether something is already in there.
+   QSet<Ingredient*> m_importHeld;
+   //! The list properties to signal changed() for once the session ends.
+   QStringList m_importLists;
+   //! Every row the session inserted, through insertElement(), newIngredient(), copy() or copyAll().
+   QList<Ingredient*> m_importInserted;
+
+   /*!
+    * \brief Takes \b elements, whose rows a rollback has just undone, out of
+    *        the all* hashes, the name index and the recipe indexes, and
+    *        deletes them.
+    */
+   void forgetElements( QList<Ingredient*> const& elements );
+   //! \brief Adds \b element to m_importInserted if an import session is running.
+   void noteImportInsert( Ingredient* element );
+
+   /*!
+    * \brief Holds back the announcement of \b element, which belongs to
+    * \b listProperty, if an import session is running.
+    * \returns true if it was held back, false if the caller should signal as usual
+    */
+   bool holdNewElement( Ingredient* element, char const* listProperty );
+
+   /*!
+    * Transaction calls go through these rather than straight to
+    * sqlDatabase(). During an import session on our own thread they leave
+    * the session's transaction alone, and a rollback fails the session.
+    */
+   bool beginTransaction();
+   bool commitTransaction();
+   bool rollbackTransaction();
+
+   /*!
+    * In-memory index of which ingredients belong to which recipe, keyed by
+    * recipe key. Built by load() and kept current by addIngredientToRecipe()
+    * and removeIngredientFromRecipe(), so fermentables(Recipe*) and friends
+    * never need to ask the database. Instructions are not indexed as their
+    * order lives in the database.
+    */
+   QHash< int, QList<Fermentable*> > m_recipeFermentables;
+   QHash< int, QList<Hop*> > m_recipeHops;
+   QHash< int, QList<Misc*> > m_recipeMiscs;
+   QHash< int, QList<Yeast*> > m_recipeYeasts;
+   QHash< int, QList<Water*> > m_recipeWaters;
+   QHash< int, QList<Salt*> > m_recipeSalts;
+
+   /*!
+    * Case-normalised name index of each table, so duplicate checks do not
+    * need a query per record. A table's index is read from the database the
+    * first time keysByName() asks for it; after that the paths that create,
+    * copy, rename and delete rows keep it current. Deleted rows are left out.
+    */
+   struct NameIndex {
+      QHash< QString, QList<int> > keys;
+      QHash< int, QString > names;
+   };
+   QMap< Brewtarget::DBTable, NameIndex > m_nameIndex;
+
+   //! \brief The form of \b name that the name index is keyed on.
+   static QString nameIndexKey( QString const& name );
+   //! \brief Keys of the undeleted rows of \b table called \b name, ignoring case.
+   QList<int> keysByName( Brewtarget::DBTable table, QString const& name );
+   //! \brief Records that row \b key of \b table is now called \b name.
+   void indexName( Brewtarget::DBTable table, int key, QString const& name );
+   //! \brief Drops row \b key of \b table from the name index.
+   void unindexName( Brewtarget::DBTable table, int key );
 
    //! Get the right database connection for the calling thread.
    static QSqlDatabase sqlDatabase();
 
    //! Helper to populate all* hashes. T should be a Ingredient subclass.
    template <class T> void populateElements( QHash<int,T*>& hash, Brewtarget::DBTable table );
+   /*!
+    * \brief Puts the rows of \b table with keys above \b lastKey into \b hash
+    *        and announces them as new things in \b listProperty.
+    */
+   template <class T> void populateNewElements( QHash<int,T*>& hash, Brewtarget::DBTable table,
+                                                int lastKey, char const* listProperty );
+
+   /*!
+    * \brief The updateDatabase() workhorse for SQLite. Attaches \b filename
+    *        and merges each table with a handful of statements, rather than
+    *        a few per row.
+    */
+   void mergeBySet( QString const& filename, MergeCounts& counts );
+   //! \brief The updateDatabase() workhorse for everything else, a row at a time.
+   void mergeByRow( QString const& filename, MergeCounts& counts );
+
+   /*!
+    * \brief Reads a whole relationship table in one query.
+    *
+    * Returns a map from each \b parentCol value to the \b childCol values
+    * that reference it, optionally restricted by \b filter. Used to avoid
+    * asking the database about each parent in turn.
+    */
+   QHash< int, QList<int> > relationMap( Brewtarget::DBTable table, QString const& parentCol,
+                                         QString const& childCol, QString const& filter = QString() );
+
+   //! \brief (Re)builds one of the recipe indexes from the \b inrecTable relationship table.
+   template <class T> void buildRecipeIndex( QHash< int, QList<T*> >& index, Brewtarget::DBTable inrecTable,
+                                             QHash<int,T*> const& allElements );
+   //! \brief Records that \b ing was linked to recipe \b recKey through \b inrecTable.
+   void indexInRecipe( Brewtarget::DBTable inrecTable, int recKey, Ingredient* ing );
+   //! \brief Records that \b ing was unlinked from recipe \b recKey.
+   void unindexInRecipe( Brewtarget::DBTable inrecTable, int recKey, Ingredient* ing );
 
    //! we search by name enough that this is actually not a bad idea
    // Although this is private, it needs to be defined in the header as it's called from BeerXML
-   template <class T> bool getElementsByName( QList<T*>& list, Brewtarget::DBTable table, QString name, QHash<int,T*> allElements, QString id=QString("") )
+   template <class T> bool getElementsByName( QList<T*>& list, Brewtarget::DBTable table, QString name, QHash<int,T*> const& allElements, QString id=QString("") )
    {
+      // Matching on the name itself is what the name index is for
+      if ( id.isEmpty() ) {
+         foreach( int key, keysByName(table, name) ) {
+            T* element = allElements.value(key, nullptr);
+            if ( element )
+               list.append(element);
+         }
+         return true;
+      }
+
+      readBarrier(table);
+
       QSqlQuery q(sqlDatabase());
       TableSchema* tbl = dbDefn->table( table );
       q.setForwardOnly(true);
       QString queryString;
 
-      if ( id.isEmpty() )
-         id = tbl->keyName(Brewtarget::dbType());
-      else
-         id = tbl->propertyToColumn(id);
+      id = tbl->propertyToColumn(id);
 
       queryString = QString("SELECT %1 as id FROM %2 WHERE %3=:name")
             .arg(id)
@@ -658,6 +1026,21 @@ private:
       bool transact = true
    );
 
+   /*!
+    * \brief addIngredientToRecipe() for a whole list of ingredients.
+    *
+    * The copies are made by copyAll(), and the *_in_recipe and *_children
+    * rows are each written with one INSERT. The recipe hears about it once.
+    * It does no recalculation and leaves connecting the copies to the
+    * caller.
+    * \returns the copies, in the same order as \b ings.
+    */
+   template<class T> QList<T*> addIngredientsToRecipe(
+      Recipe* rec,
+      QList<T*> const& ings,
+      QHash<int,T*>* keyHash
+   );
+
    /*!
     * \brief Create a deep copy of the \b object.
     * \em T must be a subclass of \em Ingredient.
@@ -671,6 +1054,37 @@ private:
     */
    template<class T> T* copy( Ingredient const* object, QHash<int,T*>* keyHash, bool displayed = true );
 
+   /*!
+    * \brief Copies the rows of \b table with \b keys, with one
+    *        INSERT ... SELECT however many there are.
+    *
+    * A key that is in \b keys more than once gets a copy each time.
+    * \param columns are set to the same value in every copy, rather than
+    *        copied, eg to move them all under a new parent.
+    * \returns the keys of the copies, in the same order as \b keys.
+    */
+   QList<int> copyRows( Brewtarget::DBTable table, QList<int> const& keys, bool displayed = true,
+                        QVariantMap const& columns = QVariantMap() );
+
+   /*!
+    * \brief Sets aside \b count keys of \b tbl for rows we are about to
+    *        insert with their keys given, rather than leaving them to the
+    *        database.
+    *
+    * The keys start above any the table has ever handed out, deleted rows
+    * included, so nothing an undo or isStored() still knows of gets reused.
+    * \returns the key before the first one set aside, or 0 if \b count is 0.
+    */
+   int reserveKeys( QSqlQuery& q, TableSchema* tbl, int count );
+
+   /*!
+    * \brief copy() for a lot of things of the same class at once. The rows
+    *        are copied by copyRows() and read back with one SELECT.
+    * \returns the copies, in the same order as \b objects.
+    */
+   template<class T> QList<T*> copyAll( QList<T*> const& objects, QHash<int,T*>* keyHash, bool displayed = true,
+                                        QVariantMap const& columns = QVariantMap() );
+
    // Do an sql update.
    void sqlUpdate( Brewtarget::DBTable table, QString const& setClause, QString const& whereClause );
 
@@ -39,7 +39,9 @@ Ingredient::Ingredient(Brewtarget::DBTable table, int key, QString t_name, bool
      _folder(folder),
      _name(t_name),
      _display(t_display),
-     _deleted(QVariant())
+     _deleted(QVariant()),
+     m_changeBatchDepth(0),
+     m_flushingChangeBatch(false)
 {
 }
 
@@ -52,7 +54,9 @@ Ingredient::Ingredient(Ingredient const& other)
      _folder(other._folder),
      _name(QString()),
      _display(other._display),
-     _deleted(other._deleted)
+     _deleted(other._deleted),
+     m_changeBatchDepth(0),
+     m_flushingChangeBatch(false)
 {
 }
 
@@ -257,9 +261,82 @@ QString Ingredient::text(QDate const& val)
 
 void Ingredient::setEasy(QString prop_name, QVariant value, bool notify)
 {
+   if ( m_changeBatchDepth > 0 ) {
+      m_batchedWrites.insert(prop_name, value);
+      if ( notify )
+         notifyChanged(metaProperty(prop_name), value);
+      return;
+   }
+
+   Database::instance().updateEntry(this,prop_name,value,notify);
+}
+
+void Ingredient::setEasy(char const* prop_name, QVariant value, bool notify)
+{
+   if ( m_changeBatchDepth > 0 ) {
+      setEasy(QString::fromLatin1(prop_name), value, notify);
+      return;
+   }
+
    Database::instance().updateEntry(this,prop_name,value,notify);
 }
 
+void Ingredient::notifyChanged(QMetaProperty prop, QVariant value)
+{
+   if ( m_changeBatchDepth == 0 ) {
+      emit changed(prop, value);
+      return;
+   }
+
+   // Only the last value of each property is interesting
+   for ( QPair<QMetaProperty,QVariant>& change : m_batchedChanges ) {
+      if ( change.first.propertyIndex() == prop.propertyIndex() ) {
+         change.second = value;
+         return;
+      }
+   }
+   m_batchedChanges.append(qMakePair(prop, value));
+}
+
+void Ingredient::beginChangeBatch()
+{
+   ++m_changeBatchDepth;
+}
+
+void Ingredient::endChangeBatch()
+{
+   if ( m_changeBatchDepth == 0 || --m_changeBatchDepth > 0 )
+      return;
+
+   if ( ! m_batchedWrites.isEmpty() ) {
+      QVariantMap writes;
+      writes.swap(m_batchedWrites);
+      Database::instance().updateEntries(this, writes);
+   }
+
+   if ( m_batchedChanges.isEmpty() )
+      return;
+
+   // Swap out first, in case a slot starts a new batch on us
+   QList< QPair<QMetaProperty,QVariant> > changes;
+   changes.swap(m_batchedChanges);
+
+   QStringList names;
+   m_flushingChangeBatch = true;
+   for ( QPair<QMetaProperty,QVariant> const& change : changes ) {
+      names.append(change.first.name());
+      emit changed(change.first, change.second);
+   }
+   m_flushingChangeBatch = false;
+
+   emit changedProperties(names);
+}
+
+bool Ingredient::flushingChangeBatch() const
+{
+   return m_flushingChangeBatch;
+}
+
 
 QVariant Ingredient::get( const QString& col_name ) const
 {
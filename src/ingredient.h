@@ -33,6 +33,9 @@
 #include <QVariant>
 #include <QDateTime>
 #include <QSqlRecord>
+#include <QList>
+#include <QPair>
+#include <QStringList>
 #include "brewtarget.h"
 namespace PropertyNames::Ingredient { static char const * const folder = "folder"; /* previously kpropFolder */ }
 namespace PropertyNames::Ingredient { static char const * const display = "display"; /* previously kpropDisplay */ }
@@ -154,6 +157,20 @@ public:
     */
    virtual int insertInDatabase() = 0;
 
+   /*!
+    * \brief Starts collecting changed() notifications and setEasy() writes
+    *        instead of acting on them straight away.
+    *
+    * Batches nest. When the outermost one ends, the collected writes go to
+    * the database in one transaction, each property that changed is emitted
+    * once with its latest value, and then changedProperties() is emitted.
+    */
+   void beginChangeBatch();
+   //! \brief Ends a batch started with beginChangeBatch().
+   void endChangeBatch();
+   //! \returns true while endChangeBatch() is emitting the collected changed() signals.
+   bool flushingChangeBatch() const;
+
 signals:
    /*!
     * Passes the meta property that has changed about this object.
@@ -163,6 +180,8 @@ signals:
    void changed(QMetaProperty, QVariant value = QVariant());
    void changedFolder(QString);
    void changedName(QString);
+   //! Emitted once at the end of a change batch, naming every property that changed in it.
+   void changedProperties(QStringList propNames);
 
 protected:
 
@@ -187,6 +206,11 @@ protected:
    void set( const QString& prop_name, const QString& col_name, const QVariant& value, bool notify = true );
    */
    void setEasy( QString prop_name, QVariant value, bool notify = true );
+   //! \brief As above. The PropertyNames constants take this one, which needs no conversion.
+   void setEasy( char const* prop_name, QVariant value, bool notify = true );
+
+   //! \brief Emits changed(), or holds on to it if a change batch is open.
+   void notifyChanged( QMetaProperty prop, QVariant value = QVariant() );
 
    /*!
     * \param col_name - The database column of the attribute we want to get.
@@ -210,6 +234,12 @@ private:
   mutable QVariant _display;
   mutable QVariant _deleted;
 
+  // Change batching. See beginChangeBatch().
+  int m_changeBatchDepth;
+  bool m_flushingChangeBatch;
+  QList< QPair<QMetaProperty,QVariant> > m_batchedChanges;
+  QVariantMap m_batchedWrites;
+
 };
 
 
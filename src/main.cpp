@@ -28,6 +28,7 @@
 #include "config.h"
 #include "brewtarget.h"
 #include "database.h"
+#include "OptionsCache.h"
 
 void importFromXml(const QString & filename);
 void createBlankDb(const QString & filename);
@@ -49,6 +50,10 @@ int main(int argc, char **argv)
 
    app.setApplicationVersion(VERSIONSTRING);
 
+   // Has to come after the names, which say where QSettings are, and be gone
+   // again before app is. Brewtarget::cleanup() sees to that.
+   OptionsCache::create();
+
    //
    // Check whether another instance of Brewtarget is running.  We want to avoid two instances running at the same time
    // because, at best, one of them will be locked out of the database (if using SQLite) and, at worst, race conditions
@@ -95,17 +100,35 @@ int main(int argc, char **argv)
     */
    const QCommandLineOption userDirectoryOption("user-dir", "Overwrite the directory used by the application with <directory>", "directory", QString());
 
+   //! \brief Recalculates every recipe and writes a report, without opening any windows.
+   const QCommandLineOption recalcAllOption("recalc-all", "Recalculates every recipe, writes the results to the --report file and exits");
+   const QCommandLineOption jobsOption("jobs", "Number of threads --recalc-all uses. Defaults to one per core", "N", "0");
+   const QCommandLineOption reportOption("report", "CSV file --recalc-all writes its results to", "file", "recalc.csv");
+   //! \brief Turns write-ahead logging for the SQLite database on or off, from this run on.
+   const QCommandLineOption sqliteWalOption("sqlite-wal", "Puts the SQLite database in write-ahead logging mode (on) or back to an exclusive lock (off). Remembered for later runs", "on|off");
+
    parser.addOption(importFromXmlOption);
    parser.addOption(createBlankDBOption);
    parser.addOption(userDirectoryOption);
+   parser.addOption(recalcAllOption);
+   parser.addOption(jobsOption);
+   parser.addOption(reportOption);
+   parser.addOption(sqliteWalOption);
 
    parser.process(app);
 
+   if (parser.isSet(sqliteWalOption)) Brewtarget::setOption("sqliteWal", parser.value(sqliteWalOption) == "on");
+
    if (parser.isSet(importFromXmlOption)) importFromXml(parser.value(importFromXmlOption));
    if (parser.isSet(createBlankDBOption)) createBlankDb(parser.value(createBlankDBOption));
 
    try
    {
+      if (parser.isSet(recalcAllOption))
+         return Brewtarget::runRecalcAll(parser.value(reportOption),
+                                         parser.value(jobsOption).toInt(),
+                                         parser.value(userDirectoryOption));
+
       return Brewtarget::run(parser.value(userDirectoryOption));
    }
    catch (const QString &error)
@@ -126,6 +149,7 @@ int main(int argc, char **argv)
             QApplication::tr("Application terminates"),
             QApplication::tr("The application encountered a fatal error."));
    }
+   OptionsCache::destroy();
    return EXIT_FAILURE;
 }
 
@@ -138,6 +162,7 @@ void importFromXml(const QString & filename) {
     Database::instance().importFromXML(filename);
     Database::dropInstance();
     Brewtarget::setOption("converted", QDate().currentDate().toString());
+    OptionsCache::destroy();
     exit(0);
 }
 
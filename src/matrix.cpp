@@ -42,6 +42,7 @@ Matrix::Matrix( const QVector<Matrix> &colVec )
    if( _cols == 0 )
    {
       _rows = 0;
+      _data = nullptr;
       return;
    }
    
@@ -99,8 +100,7 @@ Matrix& Matrix::operator=( const Matrix &rhs )
    unsigned int numElts = _rows*_cols;
    unsigned int i;
    
-   if( ! _data )
-      delete [] _data;
+   delete [] _data;
    _data = new double[ _rows*_cols ];
    for( i = 0; i < numElts; ++i )
       _data[i] = rhs._data[i];
@@ -242,30 +242,6 @@ Matrix Matrix::getCol( unsigned int col ) const
    return ret;
 }
 
-inline double Matrix::getVal( unsigned int row, unsigned int col ) const
-{
-   if( _cols*row + col < _rows*_cols )
-      return _data[ _cols*row + col ];
-   else
-   {
-      std::cerr << "Matrix: invalid access at _data[" << row << "][" << col << "]\n";
-      throw DimensionException( _rows, _cols, true, true );
-   }
-}
-
-inline void Matrix::setVal( unsigned int row, unsigned int col, double val )
-{
-   if( _cols*row + col < _rows*_cols )
-      _data[ _cols*row + col ] = val;
-   else
-   {
-      std::cerr << "Matrix: invalid access at _data[" << row << "][" << col << "]\n";
-      throw DimensionException( _rows, _cols, true, true );
-   }
-
-   return;
-}
-
 void Matrix::swapRows( unsigned int row1, unsigned int row2 )
 {
    unsigned int j;
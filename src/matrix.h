@@ -114,5 +114,31 @@ class IncomputableException: public std::exception
    }
 };
 
+//======================Matrix inlines=============================
+// Here rather than in matrix.cpp, so that code outside it can call them.
+inline double Matrix::getVal( unsigned int row, unsigned int col ) const
+{
+   if( _cols*row + col < _rows*_cols )
+      return _data[ _cols*row + col ];
+   else
+   {
+      std::cerr << "Matrix: invalid access at _data[" << row << "][" << col << "]\n";
+      throw DimensionException( _rows, _cols, true, true );
+   }
+}
+
+inline void Matrix::setVal( unsigned int row, unsigned int col, double val )
+{
+   if( _cols*row + col < _rows*_cols )
+      _data[ _cols*row + col ] = val;
+   else
+   {
+      std::cerr << "Matrix: invalid access at _data[" << row << "][" << col << "]\n";
+      throw DimensionException( _rows, _cols, true, true );
+   }
+
+   return;
+}
+
 #endif
 
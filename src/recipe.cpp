@@ -32,6 +32,10 @@
 #include <QObject>
 #include <QDebug>
 #include <QSharedPointer>
+#include <QTimer>
+#include <QReadWriteLock>
+#include <QMutex>
+#include <QAtomicInt>
 
 #include "recipe.h"
 #include "style.h"
@@ -51,6 +55,7 @@
 #include "HeatCalculations.h"
 #include "PhysicalConstants.h"
 #include "QueuedMethod.h"
+#include "OptionsCache.h"
 
 #include "TableSchemaConst.h"
 #include "RecipeSchema.h"
@@ -62,6 +67,124 @@ static const QString kHopTableSection("hopTable");
 static const QString kSaltTableSection("saltTable");
 static const QString kTabRecipeSection("tab_recipe");
 
+static const QString kFirstWortHopAdjustment("firstWortHopAdjustment");
+static const QString kMashHopAdjustment("mashHopAdjustment");
+
+namespace {
+   /*!
+    * QMutexLocker, but for a mutex already taken with tryLock(), which
+    * QMutexLocker can't do in Qt5. Unlocks however the scope is left.
+    */
+   class TryLockGuard {
+   public:
+      explicit TryLockGuard(QMutex& mutex) : m_mutex(mutex), m_locked(mutex.tryLock()) {}
+      ~TryLockGuard() { if ( m_locked ) m_mutex.unlock(); }
+      bool locked() const { return m_locked; }
+
+   private:
+      TryLockGuard(TryLockGuard const&) = delete;
+      TryLockGuard& operator=(TryLockGuard const&) = delete;
+
+      QMutex& m_mutex;
+      bool const m_locked;
+   };
+
+   struct HopAdjustments {
+      double firstWort;
+      double mash;
+   };
+
+   /*!
+    * ibuFromHop() wants both of these for every hop on every IBU
+    * calculation. Keep our own copy and only read them again when the options
+    * change. Recalculations run on worker threads too, hence the lock.
+    *
+    * The OptionsCache can be destroyed and made again (the tests do), and
+    * the connection goes with the old one, so get() connects again whenever
+    * OptionsCache::generation() has moved on.
+    */
+   class HopAdjustmentsCache {
+   public:
+      HopAdjustmentsCache() : m_generation(0) {}
+
+      HopAdjustments get() {
+         if ( m_generation.loadAcquire() != OptionsCache::generation() )
+            attach();
+
+         QReadLocker locker(&m_lock);
+         return m_adjustments;
+      }
+
+   private:
+      void attach() {
+         QMutexLocker locker(&m_attachMutex);
+
+         // instance() may be what makes the new cache, so ask it first
+         OptionsCache& options = OptionsCache::instance();
+         int const generation = OptionsCache::generation();
+         if ( m_generation.loadAcquire() == generation )
+            return;
+
+         // Direct, as before, so a change made on a worker thread is seen straight away
+         QObject::connect( &options, &OptionsCache::optionChanged, &options,
+                           [this](QString const& name) {
+            if ( name == kFirstWortHopAdjustment || name == kMashHopAdjustment )
+               reload();
+         }, Qt::DirectConnection);
+         reload();
+         m_generation.storeRelease(generation);
+      }
+
+      void reload() {
+         HopAdjustments fresh;
+         fresh.firstWort = Brewtarget::toDouble(Brewtarget::option(kFirstWortHopAdjustment, 1.1).toString(), "Recipe::ibmFromHop()");
+         fresh.mash = Brewtarget::toDouble(Brewtarget::option(kMashHopAdjustment, 0).toString(), "Recipe::ibmFromHop()");
+
+         QWriteLocker locker(&m_lock);
+         m_adjustments = fresh;
+      }
+
+      mutable QReadWriteLock m_lock;
+      HopAdjustments m_adjustments;
+      //! The OptionsCache::generation() we are connected to
+      QAtomicInt m_generation;
+      QMutex m_attachMutex;
+   };
+
+   HopAdjustments hopAdjustments()
+   {
+      static HopAdjustmentsCache cache;
+      return cache.get();
+   }
+
+   /*!
+    * What IbuMethods needs to know about the wort the hops go into.
+    *
+    * NOTE: we used to carefully calculate the average boil gravity and use it in the
+    * IBU calculations. However, due to John Palmer
+    * (http://homebrew.stackexchange.com/questions/7343/does-wort-gravity-affect-hop-utilization),
+    * it seems more appropriate to just use the OG directly, since it is the total
+    * amount of break material that truly affects the IBUs.
+    */
+   IbuMethods::Wort ibuWort(Equipment* equip, double finalVolume_l, double og)
+   {
+      IbuMethods::Wort wort;
+
+      wort.finalVolume_l = finalVolume_l;
+      wort.gravity = og;
+      HopAdjustments const adjustments = hopAdjustments();
+      wort.firstWortAdjustment = adjustments.firstWort;
+      wort.mashHopAdjustment = adjustments.mash;
+      // Assume 100% utilization and a 60 min boil until further notice
+      if( equip ) {
+         wort.hopUtilization = equip->hopUtilization_pct() / 100.0;
+         wort.boilTime_min = static_cast<int>(equip->boilTime_min());
+      }
+
+      return wort;
+   }
+}
+
 
 
 bool operator<(Recipe &r1, Recipe &r2 )
@@ -122,7 +245,10 @@ Recipe::Recipe(Brewtarget::DBTable table, int key)
    m_style_id(0),
    m_og(1.0),
    m_fg(1.0),
-   m_cacheOnly(false)
+   m_cacheOnly(false),
+   m_uninitializedCalcs(true),
+   m_dirtyCalcs(CalcAll),
+   m_recalcQueued(false)
 {
 }
 
@@ -157,7 +283,10 @@ Recipe::Recipe(QString name, bool cache)
    m_style_id(0),
    m_og(1.0),
    m_fg(1.0),
-   m_cacheOnly(cache)
+   m_cacheOnly(cache),
+   m_uninitializedCalcs(true),
+   m_dirtyCalcs(CalcAll),
+   m_recalcQueued(false)
 {
 }
 
@@ -192,7 +321,10 @@ Recipe::Recipe(Brewtarget::DBTable table, int key, QSqlRecord rec)
    m_style_id(rec.value(kcolRecipeStyleId).toInt()),
    m_og(rec.value(kcolRecipeOG).toDouble()),
    m_fg(rec.value(kcolRecipeFG).toDouble()),
-   m_cacheOnly(false)
+   m_cacheOnly(false),
+   m_uninitializedCalcs(true),
+   m_dirtyCalcs(CalcAll),
+   m_recalcQueued(false)
 {
 }
 
@@ -226,7 +358,10 @@ Recipe::Recipe( Recipe const& other ) : Ingredient(other),
    m_style_id(other.m_style_id),
    m_og(other.m_og),
    m_fg(other.m_fg),
-   m_cacheOnly(other.m_cacheOnly)
+   m_cacheOnly(other.m_cacheOnly),
+   m_uninitializedCalcs(true),
+   m_dirtyCalcs(CalcAll),
+   m_recalcQueued(false)
 {
    setObjectName("Recipe");
 }
@@ -957,10 +1092,9 @@ void Recipe::setBatchSize_l( double var )
       setEasy(PropertyNames::Recipe::batchSize_l, tmp );
    }
 
-   // NOTE: this is bad, but we have to call recalcAll(), because the estimated
-   // boil/batch volumes depend on the target volumes when there are no mash
-   // steps to actually provide an estimate for the volumes.
-   recalcAll();
+   // The estimated boil/batch volumes depend on the target volumes when
+   // there are no mash steps to actually provide an estimate for them.
+   markDirty(InputBatchSize);
 }
 
 void Recipe::setBoilSize_l( double var )
@@ -981,10 +1115,9 @@ void Recipe::setBoilSize_l( double var )
       setEasy(PropertyNames::Recipe::boilSize_l, tmp );
    }
 
-   // NOTE: this is bad, but we have to call recalcAll(), because the estimated
-   // boil/batch volumes depend on the target volumes when there are no mash
-   // steps to actually provide an estimate for the volumes.
-   recalcAll();
+   // The estimated boil/batch volumes depend on the target volumes when
+   // there are no mash steps to actually provide an estimate for them.
+   markDirty(InputBoilSize);
 }
 
 void Recipe::setBoilTime_min( double var )
@@ -1024,10 +1157,9 @@ void Recipe::setEfficiency_pct( double var )
       setEasy(PropertyNames::Recipe::efficiency_pct, tmp );
    }
 
-   // If you change the efficency, you really should recalc. And I'm afraid it
-   // means recalc all, since og and fg will change, which means your ratios
-   // change
-   recalcAll();
+   // If you change the efficency, og and fg will change, which means your
+   // ratios change
+   markDirty(InputEfficiency);
 }
 
 void Recipe::setAsstBrewer( const QString &var )
@@ -1336,120 +1468,103 @@ void Recipe::setCacheOnly( bool cache ) { m_cacheOnly = cache; }
 
 double Recipe::og()
 {
-   if( m_uninitializedCalcs )
-      recalcAll();
+   ensureCalculated(CalcOgFg);
    return m_og;
 }
 
 double Recipe::fg()
 {
-   if( m_uninitializedCalcs )
-      recalcAll();
+   ensureCalculated(CalcOgFg);
    return m_fg;
 }
 
 double Recipe::color_srm()
 {
-   if( m_uninitializedCalcs )
-      recalcAll();
+   ensureCalculated(CalcColor);
    return m_color_srm;
 }
 
 double Recipe::ABV_pct()
 {
-   if( m_uninitializedCalcs )
-      recalcAll();
+   ensureCalculated(CalcABV);
    return m_ABV_pct;
 }
 
 double Recipe::IBU()
 {
-   if( m_uninitializedCalcs )
-      recalcAll();
+   ensureCalculated(CalcIBU);
    return m_IBU;
 }
 
 QList<double> Recipe::IBUs()
 {
-   if( m_uninitializedCalcs )
-      recalcAll();
+   ensureCalculated(CalcIBU);
    return m_ibus;
 }
 
 double Recipe::boilGrav()
 {
-   if( m_uninitializedCalcs )
-      recalcAll();
+   ensureCalculated(CalcBoilGrav);
    return m_boilGrav;
 }
 
 double Recipe::calories12oz()
 {
-   if( m_uninitializedCalcs )
-      recalcAll();
+   ensureCalculated(CalcCalories);
    return m_calories;
 }
 
 double Recipe::calories33cl()
 {
-   if( m_uninitializedCalcs )
-      recalcAll();
+   ensureCalculated(CalcCalories);
    return m_calories *3.3/3.55;
 }
 
 double Recipe::wortFromMash_l()
 {
-   if( m_uninitializedCalcs )
-      recalcAll();
+   ensureCalculated(CalcVolumes);
    return m_wortFromMash_l;
 }
 
 double Recipe::boilVolume_l()
 {
-   if( m_uninitializedCalcs )
-      recalcAll();
+   ensureCalculated(CalcVolumes);
    return m_boilVolume_l;
 }
 
 double Recipe::postBoilVolume_l()
 {
-   if( m_uninitializedCalcs )
-      recalcAll();
+   ensureCalculated(CalcVolumes);
    return m_postBoilVolume_l;
 }
 
 double Recipe::finalVolume_l()
 {
-   if( m_uninitializedCalcs )
-      recalcAll();
+   ensureCalculated(CalcVolumes);
    return m_finalVolume_l;
 }
 
 QColor Recipe::SRMColor()
 {
-   if( m_uninitializedCalcs )
-      recalcAll();
+   ensureCalculated(CalcSRMColor);
    return m_SRMColor;
 }
 
 double Recipe::grainsInMash_kg()
 {
-   if( m_uninitializedCalcs )
-      recalcAll();
+   ensureCalculated(CalcGrainsInMash);
    return m_grainsInMash_kg;
 }
 
 double Recipe::grains_kg()
 {
-   if( m_uninitializedCalcs )
-      recalcAll();
+   ensureCalculated(CalcGrains);
    return m_grains_kg;
 }
 
 double Recipe::points()
 {
-   if( m_uninitializedCalcs )
-      recalcAll();
+   ensureCalculated(CalcOgFg);
    return (m_og -1.0)*1e3;
 }
 
@@ -1549,6 +1664,24 @@ double Recipe::batchSizeNoLosses_l()
 
 //==============================Recalculators==================================
 
+// Listed in dependency order: a node only depends on inputs and on nodes
+// above it, so walking the list once brings everything up to date.
+Recipe::CalcNodeDefn const Recipe::calcGraph[] = {
+   { CalcGrainsInMash, InputFermentables,                                           &Recipe::recalcGrainsInMash_kg },
+   { CalcGrains,       InputFermentables,                                           &Recipe::recalcGrains_kg },
+   { CalcVolumes,      InputFermentables | InputMash | InputEquipment |
+                       InputBatchSize | InputBoilSize | CalcGrainsInMash,           &Recipe::recalcVolumeEstimates },
+   { CalcColor,        InputFermentables | CalcVolumes,                             &Recipe::recalcColor_srm },
+   { CalcSRMColor,     CalcColor,                                                   &Recipe::recalcSRMColor },
+   { CalcOgFg,         InputFermentables | InputYeasts | InputEquipment |
+                       InputEfficiency | CalcVolumes,                               &Recipe::recalcOgFg },
+   { CalcABV,          CalcOgFg,                                                    &Recipe::recalcABV_pct },
+   { CalcBoilGrav,     InputFermentables | InputEfficiency | InputBoilSize,         &Recipe::recalcBoilGrav },
+   { CalcIBU,          InputHops | InputFermentables | InputEquipment |
+                       InputBatchSize | CalcVolumes | CalcOgFg,                     &Recipe::recalcIBU },
+   { CalcCalories,     CalcOgFg,                                                    &Recipe::recalcCalories },
+};
+
 void Recipe::recalcAll()
 {
    // WARNING
@@ -1559,24 +1692,78 @@ void Recipe::recalcAll()
    // GSG: Now only emit when _uninitializedCalcs is true, which helps some.
 
    // Someone has already called this function back in the call stack, so return to avoid recursion.
-   if( ! m_recalcMutex.tryLock() )
+   // The guard lets go again even if writing the results out throws.
+   TryLockGuard guard(m_recalcMutex);
+   if( ! guard.locked() )
       return;
 
-   // Times are in seconds, and are cumulative.
-   recalcGrainsInMash_kg(); // 0.01
-   recalcGrains_kg(); // 0.03
-   recalcVolumeEstimates(); // 0.06
-   recalcColor_srm(); // 0.08
-   recalcSRMColor(); // 0.08
-   recalcOgFg(); // 0.11
-   recalcABV_pct(); // 0.12
-   recalcBoilGrav(); // 0.14
-   recalcIBU(); // 0.15
-   recalcCalories();
+   m_dirtyCalcs = CalcAll;
+   runDirtyCalcs(CalcAll);
 
    m_uninitializedCalcs = false;
+}
+
+void Recipe::recalcDirty( quint32 nodes )
+{
+   TryLockGuard guard(m_recalcMutex);
+   if( ! guard.locked() )
+      return;
+
+   runDirtyCalcs(nodes);
+}
+
+void Recipe::runDirtyCalcs( quint32 nodes )
+{
+   quint32 wanted = nodes;
+   int i;
+
+   // Walk back up the graph for everything the wanted nodes read
+   for( i = static_cast<int>(sizeof(calcGraph)/sizeof(calcGraph[0])) - 1; i >= 0; --i ) {
+      if( wanted & calcGraph[i].node )
+         wanted |= calcGraph[i].dependsOn;
+   }
+
+   // Collect everything this pass changes, so listeners hear about each
+   // property once and the og/fg writes share a transaction.
+   beginChangeBatch();
+
+   for( CalcNodeDefn const& defn : calcGraph ) {
+      if( m_dirtyCalcs & wanted & defn.node ) {
+         // Clear first, so a getter called from inside the recalc (or from a
+         // slot connected to its changed()) doesn't try to come back here.
+         m_dirtyCalcs &= ~static_cast<quint32>(defn.node);
+         (this->*defn.recalc)();
+      }
+   }
+
+   endChangeBatch();
+}
 
-   m_recalcMutex.unlock();
+void Recipe::markDirty( quint32 changed )
+{
+   quint32 dirty = changed;
+
+   for( CalcNodeDefn const& defn : calcGraph ) {
+      if( defn.dependsOn & dirty )
+         dirty |= defn.node;
+   }
+   m_dirtyCalcs |= dirty & CalcAll;
+
+   if( m_dirtyCalcs != 0 && ! m_recalcQueued ) {
+      m_recalcQueued = true;
+      QTimer::singleShot(0, this, [this]() {
+         m_recalcQueued = false;
+         recalcDirty();
+      });
+   }
+}
+
+void Recipe::ensureCalculated( quint32 nodes )
+{
+   if( m_uninitializedCalcs )
+      recalcAll();
+   else if( m_dirtyCalcs & nodes )
+      recalcDirty(nodes);
 }
 
 void Recipe::recalcABV_pct()
@@ -1591,7 +1778,7 @@ void Recipe::recalcABV_pct()
       m_ABV_pct = ret;
       if (!m_uninitializedCalcs)
       {
-        emit changed( metaProperty("ABV_pct"), m_ABV_pct );
+        notifyChanged( metaProperty("ABV_pct"), m_ABV_pct );
       }
    }
 }
@@ -1617,7 +1804,7 @@ void Recipe::recalcColor_srm()
       m_color_srm = ret;
       if (!m_uninitializedCalcs)
       {
-        emit changed( metaProperty("color_srm"), m_color_srm );
+        notifyChanged( metaProperty("color_srm"), m_color_srm );
       }
    }
 
@@ -1627,16 +1814,19 @@ void Recipe::recalcIBU()
 {
    int i;
    double ibus = 0.0;
-   double tmp = 0.0;
+   IbuMethods::HopBatch batch;
+
+   ensureCalculated(CalcOgFg | CalcVolumes);
 
    // Bitterness due to hops...
-   m_ibus.clear();
    QList<Hop*> hhops = hops();
-   for( i = 0; i < hhops.size(); ++i ) {
-      tmp = ibuFromHop(hhops[i]);
-      m_ibus.append(tmp);
-      ibus += tmp;
-   }
+   batch.reserve(hhops.size());
+   foreach( Hop* h, hhops )
+      batch.append( h->alpha_pct()/100.0, h->amount_kg()*1000.0, h->time_min(), h->use(), h->form() );
+
+   QVector<double> hopIbus(batch.size());
+   ibus = IbuMethods::getIbus( batch, ibuWort(equipment(), m_finalVolumeNoLosses_l, m_og), hopIbus.data() );
+   m_ibus = hopIbus.toList();
 
    // Bitterness due to hopped extracts...
    QList<Fermentable*> ferms = fermentables();
@@ -1651,7 +1841,7 @@ void Recipe::recalcIBU()
       m_IBU = ibus;
       if (!m_uninitializedCalcs)
       {
-        emit changed( metaProperty("IBU"), m_IBU );
+        notifyChanged( metaProperty("IBU"), m_IBU );
       }
    }
 }
@@ -1734,28 +1924,28 @@ void Recipe::recalcVolumeEstimates()
    if ( ! qFuzzyCompare(tmp_wfm, m_wortFromMash_l ) ) {
       m_wortFromMash_l = tmp_wfm;
       if (!m_uninitializedCalcs) {
-        emit changed( metaProperty("wortFromMash_l"), m_wortFromMash_l );
+        notifyChanged( metaProperty("wortFromMash_l"), m_wortFromMash_l );
       }
    }
 
    if ( ! qFuzzyCompare(tmp_bv, m_boilVolume_l ) ) {
         m_boilVolume_l = tmp_bv;
       if (!m_uninitializedCalcs) {
-        emit changed( metaProperty("boilVolume_l"), m_boilVolume_l );
+        notifyChanged( metaProperty("boilVolume_l"), m_boilVolume_l );
       }
    }
 
    if ( ! qFuzzyCompare(tmp_fv, m_finalVolume_l ) ) {
        m_finalVolume_l = tmp_fv;
       if (!m_uninitializedCalcs) {
-        emit changed( metaProperty("finalVolume_l"), m_finalVolume_l );
+        notifyChanged( metaProperty("finalVolume_l"), m_finalVolume_l );
       }
    }
 
    if ( ! qFuzzyCompare(tmp_pbv, m_postBoilVolume_l ) ) {
       m_postBoilVolume_l = tmp_pbv;
       if (!m_uninitializedCalcs) {
-        emit changed( metaProperty("postBoilVolume_l"), m_postBoilVolume_l );
+        notifyChanged( metaProperty("postBoilVolume_l"), m_postBoilVolume_l );
       }
    }
 }
@@ -1781,7 +1971,7 @@ void Recipe::recalcGrainsInMash_kg()
    if ( ! qFuzzyCompare(ret, m_grainsInMash_kg )  ) {
       m_grainsInMash_kg = ret;
       if (!m_uninitializedCalcs) {
-        emit changed( metaProperty("grainsInMash_kg"), m_grainsInMash_kg );
+        notifyChanged( metaProperty("grainsInMash_kg"), m_grainsInMash_kg );
       }
    }
 }
@@ -1799,7 +1989,7 @@ void Recipe::recalcGrains_kg()
    if ( ! qFuzzyCompare(ret, m_grains_kg ) ) {
       m_grains_kg = ret;
       if (!m_uninitializedCalcs) {
-        emit changed( metaProperty("grains_kg"), m_grains_kg );
+        notifyChanged( metaProperty("grains_kg"), m_grains_kg );
       }
    }
 }
@@ -1813,7 +2003,7 @@ void Recipe::recalcSRMColor()
       m_SRMColor = tmp;
       if (!m_uninitializedCalcs)
       {
-        emit changed( metaProperty("SRMColor"), m_SRMColor );
+        notifyChanged( metaProperty("SRMColor"), m_SRMColor );
       }
    }
 }
@@ -1851,7 +2041,7 @@ void Recipe::recalcCalories()
    if ( ! qFuzzyCompare(tmp, m_calories ) ) {
       m_calories = tmp;
       if (!m_uninitializedCalcs) {
-        emit changed( metaProperty("calories"), m_calories );
+        notifyChanged( metaProperty("calories"), m_calories );
       }
    }
 }
@@ -1932,7 +2122,7 @@ void Recipe::recalcBoilGrav()
       m_boilGrav = ret;
       if (!m_uninitializedCalcs)
       {
-        emit changed( metaProperty("boilGrav"), m_boilGrav );
+        notifyChanged( metaProperty("boilGrav"), m_boilGrav );
       }
    }
 }
@@ -2056,8 +2246,8 @@ void Recipe::recalcOgFg()
       if (!m_uninitializedCalcs)
       {
         setEasy(PropertyNames::Recipe::og, m_og, false );
-        emit changed( metaProperty(PropertyNames::Recipe::og), m_og );
-        emit changed( metaProperty(PropertyNames::Recipe::points), (m_og-1.0)*1e3 );
+        notifyChanged( metaProperty(PropertyNames::Recipe::og), m_og );
+        notifyChanged( metaProperty(PropertyNames::Recipe::points), (m_og-1.0)*1e3 );
       }
    }
 
@@ -2066,7 +2256,7 @@ void Recipe::recalcOgFg()
       if (!m_uninitializedCalcs)
       {
         setEasy(PropertyNames::Recipe::fg, m_fg, false );
-        emit changed( metaProperty(PropertyNames::Recipe::fg), m_fg );
+        notifyChanged( metaProperty(PropertyNames::Recipe::fg), m_fg );
       }
    }
 }
@@ -2075,62 +2265,17 @@ void Recipe::recalcOgFg()
 
 double Recipe::ibuFromHop(Hop const* hop)
 {
-   Equipment* equip = equipment();
-   double ibus = 0.0;
-   double fwhAdjust = Brewtarget::toDouble(Brewtarget::option("firstWortHopAdjustment", 1.1).toString(), "Recipe::ibmFromHop()");
-   double mashHopAdjust = Brewtarget::toDouble(Brewtarget::option("mashHopAdjustment", 0).toString(), "Recipe::ibmFromHop()");
+   // Called from outside recalcIBU() too, so make sure what we read is current
+   ensureCalculated(CalcOgFg | CalcVolumes);
+
+   IbuMethods::HopBatch batch;
 
    if( hop == nullptr )
       return 0.0;
 
-   double AArating = hop->alpha_pct()/100.0;
-   double grams = hop->amount_kg()*1000.0;
-   double minutes = hop->time_min();
-   // Assume 100% utilization until further notice
-   double hopUtilization = 1.0;
-   // Assume 60 min boil until further notice
-   int boilTime = 60;
-
-   // NOTE: we used to carefully calculate the average boil gravity and use it in the
-   // IBU calculations. However, due to John Palmer
-   // (http://homebrew.stackexchange.com/questions/7343/does-wort-gravity-affect-hop-utilization),
-   // it seems more appropriate to just use the OG directly, since it is the total
-   // amount of break material that truly affects the IBUs.
-
-   if( equip ) {
-      hopUtilization = equip->hopUtilization_pct() / 100.0;
-      boilTime = static_cast<int>(equip->boilTime_min());
-   }
-
-   if( hop->use() == Hop::Boil)
-      ibus = IbuMethods::getIbus( AArating, grams, m_finalVolumeNoLosses_l, m_og, minutes );
-   else if( hop->use() == Hop::First_Wort )
-      ibus = fwhAdjust * IbuMethods::getIbus( AArating, grams, m_finalVolumeNoLosses_l, m_og, boilTime );
-   else if( hop->use() == Hop::Mash && mashHopAdjust > 0.0 )
-      ibus = mashHopAdjust * IbuMethods::getIbus( AArating, grams, m_finalVolumeNoLosses_l, m_og, boilTime );
-
-   // Adjust for hop form. Tinseth's table was created from whole cone data,
-   // and it seems other formulae are optimized that way as well. So, the
-   // utilization is considered unadjusted for whole cones, and adjusted
-   // up for plugs and pellets.
-   //
-   // - http://www.realbeer.com/hops/FAQ.html
-   // - https://groups.google.com/forum/#!topic/brewtarget-help/mv2qvWBC4sU
-   switch( hop->form() ) {
-      case Hop::Plug:
-         hopUtilization *= 1.02;
-         break;
-      case Hop::Pellet:
-         hopUtilization *= 1.10;
-         break;
-      default:
-         break;
-   }
-
-   // Adjust for hop utilization.
-   ibus *= hopUtilization;
-
-   return ibus;
+   // The same sums as recalcIBU(), for a batch of one
+   batch.append( hop->alpha_pct()/100.0, hop->amount_kg()*1000.0, hop->time_min(), hop->use(), hop->form() );
+   return IbuMethods::getIbus( batch, ibuWort(equipment(), m_finalVolumeNoLosses_l, m_og) );
 }
 
 // this was fixed, but not with an at
@@ -2260,39 +2405,37 @@ QStringList Recipe::getReagents( QList<Salt*> salts, Salt::WhenToAdd wanted)
 //==========================Accept changes from ingredients====================
 
 void Recipe::acceptEquipChange(QMetaProperty prop, QVariant val) {
-   recalcAll();
+   markDirty(InputEquipment);
 }
 
 void Recipe::acceptFermChange(QMetaProperty prop, QVariant val)
 {
-   recalcAll();
+   markDirty(InputFermentables);
 }
 
 void Recipe::onFermentableChanged()
 {
-   recalcAll();
+   markDirty(InputFermentables);
 }
 
 void Recipe::acceptHopChange(QMetaProperty prop, QVariant val)
 {
-   recalcIBU();
+   markDirty(InputHops);
 }
 
 void Recipe::acceptHopChange(Hop* hop)
 {
-   recalcIBU();
+   markDirty(InputHops);
 }
 
 void Recipe::acceptYeastChange(QMetaProperty prop, QVariant val)
 {
-   recalcOgFg();
-   recalcABV_pct();
+   markDirty(InputYeasts);
 }
 
 void Recipe::acceptYeastChange(Yeast* yeast)
 {
-   recalcOgFg();
-   recalcABV_pct();
+   markDirty(InputYeasts);
 }
 
 void Recipe::acceptMashChange(QMetaProperty prop, QVariant val)
@@ -2302,13 +2445,13 @@ void Recipe::acceptMashChange(QMetaProperty prop, QVariant val)
    if ( mashSend == nullptr )
       return;
 
-   recalcAll();
+   markDirty(InputMash);
 }
 
 void Recipe::acceptMashChange(Mash* newMash)
 {
    if ( newMash == mash() )
-      recalcAll();
+      markDirty(InputMash);
 }
 
 double Recipe::targetCollectedWortVol_l()
@@ -532,6 +532,63 @@ private:
    QMutex m_uninitializedCalcsMutex;
    QMutex m_recalcMutex;
 
+   /*!
+    * \brief Nodes of the calculated property dependency graph.
+    *
+    * The Input* bits are things the calculations read but do not produce.
+    * The Calc* bits are one per recalc*() method. Which node depends on
+    * what is spelled out in \c calcGraph in recipe.cpp.
+    */
+   enum CalcNode {
+      InputFermentables = 0x00001,
+      InputHops         = 0x00002,
+      InputYeasts       = 0x00004,
+      InputMash         = 0x00008,
+      InputEquipment    = 0x00010,
+      InputBatchSize    = 0x00020,
+      InputBoilSize     = 0x00040,
+      InputEfficiency   = 0x00080,
+      CalcGrainsInMash  = 0x00100,
+      CalcGrains        = 0x00200,
+      CalcVolumes       = 0x00400,
+      CalcColor         = 0x00800,
+      CalcSRMColor      = 0x01000,
+      CalcOgFg          = 0x02000,
+      CalcABV           = 0x04000,
+      CalcBoilGrav      = 0x08000,
+      CalcIBU           = 0x10000,
+      CalcCalories      = 0x20000,
+      CalcAll           = 0x3FF00
+   };
+
+   //! \brief One node of the graph: what it depends on and how to recompute it.
+   struct CalcNodeDefn {
+      CalcNode node;
+      quint32 dependsOn;
+      void (Recipe::*recalc)();
+   };
+   static CalcNodeDefn const calcGraph[];
+
+   //! Calc* bits that are out of date.
+   quint32 m_dirtyCalcs;
+   //! True while a deferred recalcDirty() is waiting in the event loop.
+   bool m_recalcQueued;
+
+   /*!
+    * \brief Marks everything downstream of \b changed as out of date.
+    *
+    * Nothing is recomputed here. Getters recompute what they need on read,
+    * and a recalcDirty() is queued so listeners still get their changed()
+    * signals once the current event is done.
+    */
+   void markDirty( quint32 changed );
+   //! \brief Recomputes the dirty nodes among \b nodes and what they depend on, in dependency order.
+   void recalcDirty( quint32 nodes = CalcAll );
+   //! \brief Called with m_recalcMutex held. Does the work for recalcDirty() and recalcAll().
+   void runDirtyCalcs( quint32 nodes );
+   //! \brief Brings \b nodes up to date before they are read.
+   void ensureCalculated( quint32 nodes );
+
    // Batch size without losses.
    double batchSizeNoLosses_l();
 
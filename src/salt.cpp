@@ -188,72 +188,83 @@ double Salt::percentAcid() const { return m_percent_acid; }
 //
 // the magic 1000 is here because masses are stored as kg. We need it in grams
 // for this part
-double Salt::Ca() const
+Salt::Ions Salt::ionsPerGram(Salt::Types type)
 {
-   if ( m_add_to == Salt::NEVER ) {
-      return 0.0;
+   //                            Ca     Cl     CO3    HCO3   Mg    Na     SO4
+   switch (type) {
+      case Salt::CACL2:  return { 272.0, 483.0,   0.0,   0.0,  0.0,   0.0,   0.0 };
+      case Salt::CACO3:  return { 200.0,   0.0, 610.0,   0.0,  0.0,   0.0,   0.0 };
+      case Salt::CASO4:  return { 232.0,   0.0,   0.0,   0.0,  0.0,   0.0, 558.0 };
+      case Salt::MGSO4:  return {   0.0,   0.0,   0.0,   0.0, 99.0,   0.0, 389.0 };
+      case Salt::NACL:   return {   0.0, 607.0,   0.0,   0.0,  0.0, 393.0,   0.0 };
+      case Salt::NAHCO3: return {   0.0,   0.0,   0.0, 726.0,  0.0, 274.0,   0.0 };
+      default:           return {   0.0,   0.0,   0.0,   0.0,  0.0,   0.0,   0.0 };
    }
+}
+
+double Salt::acidPerLitre_g(Salt::Types type, double percentAcid)
+{
+   const double H3PO4_density = 1.685;
+   const double lactic_density = 1.2;
+   double density;
 
-   switch (m_type) {
-      case Salt::CACL2: return 272.0 * m_amount * 1000.0;
-      case Salt::CACO3: return 200.0 * m_amount * 1000.0;
-      case Salt::CASO4: return 232.0 * m_amount * 1000.0;
+   // The densities are for 88% lactic and 85% phosphoric, and anything
+   // weaker is watered down from those.
+   switch (type) {
+      case Salt::LACTIC: density = percentAcid/88.0 * (lactic_density - 1.0) + 1.0; break;
+      case Salt::H3PO4:  density = percentAcid/85.0 * (H3PO4_density - 1.0) + 1.0; break;
       default: return 0.0;
    }
+   return 1000.0 * density * percentAcid/100.0;
+}
+
+double Salt::Ca() const
+{
+   if ( m_add_to == Salt::NEVER )
+      return 0.0;
+   return ionsPerGram(m_type).Ca * m_amount * 1000.0;
 }
 
 double Salt::Cl() const
 {
    if ( m_add_to == Salt::NEVER )
       return 0.0;
-   switch (m_type) {
-      case Salt::CACL2: return 483 * m_amount * 1000.0;
-      case Salt::NACL: return 607 * m_amount * 1000.0;
-      default: return 0.0;
-   }
+   return ionsPerGram(m_type).Cl * m_amount * 1000.0;
 }
 
 double Salt::CO3() const
 {
    if ( m_add_to == Salt::NEVER )
       return 0.0;
-   return m_type == Salt::CACO3 ? 610.0  * m_amount * 1000.0: 0.0;
+   return ionsPerGram(m_type).CO3 * m_amount * 1000.0;
 }
 
 double Salt::HCO3() const
 {
    if ( m_add_to == Salt::NEVER )
       return 0.0;
-   return m_type == Salt::NAHCO3 ? 726.0 * m_amount * 1000.0: 0.0;
+   return ionsPerGram(m_type).HCO3 * m_amount * 1000.0;
 }
 
 double Salt::Mg() const
 {
    if ( m_add_to == Salt::NEVER )
       return 0.0;
-   return m_type == Salt::MGSO4 ? 99.0 * m_amount * 1000.0: 0.0;
+   return ionsPerGram(m_type).Mg * m_amount * 1000.0;
 }
 
 double Salt::Na() const
 {
    if ( m_add_to == Salt::NEVER )
       return 0.0;
-   switch (m_type) {
-      case Salt::NACL: return 393.0 * m_amount * 1000.0;
-      case Salt::NAHCO3: return 274.0 * m_amount * 1000.0;
-      default: return 0.0;
-   }
+   return ionsPerGram(m_type).Na * m_amount * 1000.0;
 }
 
 double Salt::SO4() const
 {
    if ( m_add_to == Salt::NEVER )
       return 0.0;
-   switch (m_type) {
-      case Salt::CASO4: return 558.0 * m_amount * 1000.0;
-      case Salt::MGSO4: return 389.0 * m_amount * 1000.0;
-      default: return 0.0;
-   }
+   return ionsPerGram(m_type).SO4 * m_amount * 1000.0;
 }
 
 int Salt::insertInDatabase() {
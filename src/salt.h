@@ -117,6 +117,22 @@ public:
 
    static QString classNameStr();
 
+   //! \brief mg of each ion in a gram of salt
+   struct Ions {
+      double Ca;
+      double Cl;
+      double CO3;
+      double HCO3;
+      double Mg;
+      double Na;
+      double SO4;
+   };
+
+   //! \brief What a gram of a \b type salt adds. All zero for the acids.
+   static Ions ionsPerGram(Salt::Types type);
+   //! \brief Grams of acid in a litre of a \b type acid that is \b percentAcid percent acid
+   static double acidPerLitre_g(Salt::Types type, double percentAcid);
+
    double Ca() const;
    double Cl() const;
    double CO3() const;